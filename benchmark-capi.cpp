@@ -0,0 +1,59 @@
+/*
+ * C interface benchmark.
+ *
+ * Inverts batches of random matrices of small integers through mm_invert_batch_f64(), in place
+ * in a plain array of doubles, against invert_batch() on a vector of matrices of the same size,
+ * for sizes with compiled kernels and for sizes without.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3 benchmark-capi.cpp matrix_capi.cpp
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "matrix_capi.h"
+#include "matrix_math.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+template <index_t Size>
+void run(std::mt19937_64& generator, const index_t count)
+{
+	std::uniform_int_distribution<> distribution(-10, 10);
+	std::vector<square_matrix<Size>> batch(count);
+	std::vector<double> elements(count * Size * Size);
+	for (index_t i = 0; i < count; ++i)
+		for (index_t r = 0; r < Size; ++r)
+			for (index_t c = 0; c < Size; ++c)
+				elements[(i * Size + r) * Size + c] = batch[i][r][c] = distribution(generator);
+	std::vector<unsigned char> status(count);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	const size_t inverted = mm_invert_batch_f64(Size, count, elements.data(), Size * Size, elements.data(), status.data());
+	auto middle = std::chrono::high_resolution_clock::now();
+	invert_batch(batch.begin(), batch.end(), status.begin());
+	auto end = std::chrono::high_resolution_clock::now();
+
+	std::cout << Size << "x" << Size << ": " << (count / timer(middle - start).count()) <<
+		" matrices/s through the C interface, " << (count / timer(end - middle).count()) <<
+		" matrices/s through invert_batch() (" << inverted << " inverted).\n";
+}
+
+int main ()
+{
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	run<4>(generator, 1 << 20);
+	run<8>(generator, 1 << 18);
+	run<10>(generator, 1 << 17);
+	run<12>(generator, 1 << 16);
+	run<16>(generator, 1 << 15);
+	run<64>(generator, 1 << 9);
+	return 0;
+}
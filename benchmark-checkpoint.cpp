@@ -0,0 +1,79 @@
+/*
+ * Checkpoint benchmark.
+ *
+ * Inverts a batch file of random 4x4 matrices of small integers to another, without checkpoints
+ * and with them at several intervals, and reports the throughput of each. A run with checkpoints
+ * leaves its output on storage, where one without leaves much of it in the page cache, so the
+ * cost of the checkpoints is given against a run without them that flushes its output at the end.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "matrix_io.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+int main ()
+{
+	constexpr index_t size = 4;
+	constexpr index_t count = 1 << 21;
+	constexpr unsigned repeat_count = 3;
+	const char* input = "benchmark-checkpoint-input.bin";
+	const char* output = "benchmark-checkpoint-output.bin";
+	const char* log = "benchmark-checkpoint.log";
+
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	std::uniform_int_distribution<> distribution(-10, 10);
+	std::vector<square_matrix<size>> batch(count);
+	for (auto& mtx : batch)
+		for (auto& row : mtx)
+			for (auto& element : row)
+				element = distribution(generator);
+	write_batch_file(input, batch.data(), batch.size());
+
+	double baseline = 0;
+	const index_t flushed = ~index_t(0);
+	for (const index_t interval : {index_t(0), flushed, index_t(16), index_t(64), index_t(256)})
+	{
+		timer elapsed{0};
+		index_t inverted = 0;
+		for (unsigned repeat = 0; repeat < repeat_count; ++repeat)
+		{
+			std::remove(log);
+			batch_checkpoint checkpoint(log);
+			batch_io_options options;
+			options.checkpoint = interval && interval != flushed ? &checkpoint : nullptr;
+			options.checkpoint_interval = interval;
+			const auto start = std::chrono::high_resolution_clock::now();
+			inverted = invert_batch_file<size>(input, output, nullptr, options);
+			if (interval == flushed)
+				detail::flush(detail::open_file(output, O_WRONLY, false).get());
+			elapsed += std::chrono::high_resolution_clock::now() - start;
+		}
+		const double rate = count * repeat_count / elapsed.count();
+		if (interval == flushed)
+			baseline = rate;
+		std::cout << (interval == 0 ? std::string("No checkpoints") : interval == flushed ? std::string("No checkpoints, flushed") :
+			"Checkpoint every " + std::to_string(interval) + " chunks") << ": " << rate << " matrices/s (" << inverted << " inverted)";
+		if (interval && interval != flushed)
+			std::cout << ", costing " << (100 * (baseline / rate - 1)) << "% against the flushed run";
+		std::cout << ".\n";
+	}
+
+	std::remove(input);
+	std::remove(output);
+	std::remove(log);
+	return 0;
+}
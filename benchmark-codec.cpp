@@ -0,0 +1,92 @@
+/*
+ * Batch compression benchmark.
+ *
+ * Codes a batch of random 8x8 matrices of small integers, as the other benchmarks use, with the
+ * shuffle_codec, and reports the compression ratio and the rates of coding and decoding, against
+ * the rate of a plain copy of the same data. Then inverts the batch file to file, raw and coded.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "matrix_codec.hpp"
+#include "matrix_io.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+int main ()
+{
+	constexpr index_t size = 8;
+	constexpr index_t count = 1 << 18;
+	constexpr unsigned repeat_count = 5;
+	const char* input = "benchmark-codec-input.bin";
+	const char* output = "benchmark-codec-output.bin";
+
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	std::uniform_int_distribution<> distribution(-10, 10);
+	std::vector<square_matrix<size>> batch(count), decoded(count), copied(count);
+	for (auto& mtx : batch)
+		for (auto& row : mtx)
+			for (auto& element : row)
+				element = distribution(generator);
+	const std::size_t bytes = count * sizeof(batch[0]);
+	const double mebibytes = double(bytes) / (1 << 20);
+
+	// Frames of the size write_batch_file() uses.
+	const std::size_t frame_bytes = batch_frame_size;
+	const char* const first = reinterpret_cast<const char*>(batch.data());
+	shuffle_codec codec;
+	std::vector<std::vector<char>> frames((bytes + frame_bytes - 1) / frame_bytes);
+	timer encode_time{0}, decode_time{0}, copy_time{0};
+	std::size_t coded_bytes = 0;
+	for (unsigned repeat = 0; repeat < repeat_count; ++repeat)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (std::size_t f = 0; f < frames.size(); ++f)
+			codec.encode(first + f * frame_bytes, std::min(frame_bytes, bytes - f * frame_bytes), sizeof(double), frames[f]);
+		auto middle = std::chrono::high_resolution_clock::now();
+		for (std::size_t f = 0; f < frames.size(); ++f)
+			codec.decode(frames[f].data(), frames[f].size(), sizeof(double),
+				reinterpret_cast<char*>(decoded.data()) + f * frame_bytes, std::min(frame_bytes, bytes - f * frame_bytes));
+		auto end = std::chrono::high_resolution_clock::now();
+		std::memcpy(copied.data(), batch.data(), bytes);
+		auto copy_end = std::chrono::high_resolution_clock::now();
+		encode_time += middle - start;
+		decode_time += end - middle;
+		copy_time += copy_end - end;
+	}
+	for (const auto& frame : frames)
+		coded_bytes += frame.size();
+	std::cout << mebibytes << " MiB of 8x8 matrices coded to " << (double(coded_bytes) / (1 << 20)) << " MiB (ratio " <<
+		(double(bytes) / coded_bytes) << "); " << (decoded == batch ? "decoded correctly" : "DECODED WRONGLY") << ".\n" <<
+		"Coding " << (mebibytes * repeat_count / encode_time.count()) << " MiB/s; decoding " <<
+		(mebibytes * repeat_count / decode_time.count()) << " MiB/s; copying " <<
+		(mebibytes * repeat_count / copy_time.count()) << " MiB/s.\n";
+
+	for (const auto encoding : {batch_encoding::raw, batch_encoding::shuffled_lz})
+	{
+		write_batch_file(input, batch.data(), batch.size(), encoding);
+		batch_io_options options;
+		options.encoding = encoding;
+		auto start = std::chrono::high_resolution_clock::now();
+		const index_t inverted = invert_batch_file<size>(input, output, nullptr, options);
+		auto end = std::chrono::high_resolution_clock::now();
+		std::cout << (encoding == batch_encoding::raw ? "Raw" : "Coded") << " files: " <<
+			(count / timer(end - start).count()) << " matrices/s inverted (" << inverted << " inverted).\n";
+	}
+
+	std::remove(input);
+	std::remove(output);
+	return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Fused multiply-add benchmark.
+ *
+ * Compares the throughput and accuracy of the dot product and row update kernels when evaluated
+ * with and without std::fma. Accuracy is measured against a long double reference.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3 -mfma
+ *
+ */
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "matrix_math.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+constexpr index_t width = 64;
+using test_row = row<width>;
+
+//
+// time_dot_products<>().
+//
+// Computes the dot product of each consecutive pair of rows, repeat_count times over. The 
+// total time elapsed is returned, and the mean relative error of the products is accumulated
+// in relative_error.
+//
+template <bool Fused>
+timer time_dot_products(const std::vector<test_row>& rows, unsigned repeat_count, double& relative_error)
+{
+	double sink = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned repeat = 0; repeat < repeat_count; ++repeat)
+		for (std::size_t i = 1; i < rows.size(); ++i)
+			sink += dot<Fused>(rows[i-1], rows[i]);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	relative_error = 0;
+	for (std::size_t i = 1; i < rows.size(); ++i)
+	{
+		long double reference = 0;
+		for (index_t c = 0; c < width; ++c)
+			reference += static_cast<long double>(rows[i-1][c]) * rows[i][c];
+		const double product = dot<Fused>(rows[i-1], rows[i]);
+		relative_error += static_cast<double>(std::abs((product - reference) / reference));
+	}
+	relative_error /= rows.size() - 1;
+
+	// Stop the optimizer discarding the loop.
+	if (sink == 0.5)
+		std::cout << ' ';
+	return end - start;
+}
+
+//
+// time_row_updates<>().
+//
+// Applies the axpy row update used by row reduction across all rows, repeat_count times over.
+//
+template <bool Fused>
+timer time_row_updates(std::vector<test_row> rows, unsigned repeat_count)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned repeat = 0; repeat < repeat_count; ++repeat)
+		for (std::size_t i = 1; i < rows.size(); ++i)
+			rows[i].add_scaled<Fused>(rows[i-1], -0.5);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	if (rows.back()[0] == 0.5)
+		std::cout << ' ';
+	return end - start;
+}
+
+int main ()
+{
+	// How many rows to use, and how many times to pass over them.
+	const std::size_t row_count = 4'096;
+	const unsigned repeat_count = 2'000;
+
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	std::uniform_real_distribution<> distribution(-1, 1);
+
+	std::vector<test_row> rows(row_count);
+	for (auto& row : rows)
+		for (auto& element : row)
+			element = distribution(generator);
+
+	double unfused_error, fused_error;
+	const timer unfused_dot = time_dot_products<false>(rows, repeat_count, unfused_error);
+	const timer fused_dot = time_dot_products<true>(rows, repeat_count, fused_error);
+	const timer unfused_update = time_row_updates<false>(rows, repeat_count);
+	const timer fused_update = time_row_updates<true>(rows, repeat_count);
+
+	const double operations = double(row_count - 1) * repeat_count * width;
+	std::cout << "Dot product, unfused: " << operations / unfused_dot.count() / 1e9 << " G multiply-adds/s; " <<
+		"mean relative error " << unfused_error << ".\n" <<
+		"Dot product, fused: " << operations / fused_dot.count() / 1e9 << " G multiply-adds/s; " <<
+		"mean relative error " << fused_error << ".\n" <<
+		"Row update, unfused: " << operations / unfused_update.count() / 1e9 << " G multiply-adds/s.\n" <<
+		"Row update, fused: " << operations / fused_update.count() / 1e9 << " G multiply-adds/s.\n";
+
+	return 0;
+}
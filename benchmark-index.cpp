@@ -0,0 +1,87 @@
+/*
+ * Indexed batch file benchmark.
+ *
+ * Writes a batch of random 8x8 matrices, a few of them with large elements, to indexed batch
+ * files, raw and coded, and reports the time to find the large matrices by reading every chunk
+ * against that of reading only the chunks the index's statistics admit, and the time to look up
+ * matrices at random.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "matrix_io.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+int main ()
+{
+	constexpr index_t size = 8;
+	constexpr index_t count = 1 << 18;
+	constexpr index_t outlier_count = 16;
+	constexpr unsigned lookup_count = 100000;
+	const char* path = "benchmark-index.bin";
+
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	std::uniform_int_distribution<> distribution(-10, 10);
+	std::uniform_int_distribution<index_t> position(0, count - 1);
+	std::vector<square_matrix<size>> batch(count);
+	for (auto& mtx : batch)
+		for (auto& row : mtx)
+			for (auto& element : row)
+				element = distribution(generator);
+	for (index_t outlier = 0; outlier < outlier_count; ++outlier)
+		batch[position(generator)][0][0] = 1000;
+
+	for (const auto encoding : {batch_encoding::raw, batch_encoding::shuffled_lz})
+	{
+		write_indexed_batch_file(path, batch.data(), batch.size(), encoding);
+		const indexed_batch_reader<size, size> reader(path);
+		const auto is_outlier = [](const const_matrix_view<size, size>& mtx) { return mtx[0][0] > 100; };
+
+		// Every chunk.
+		index_t scanned = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		reader.for_each_chunk([](const batch_chunk_statistics&) { return true; },
+			[&](index_t, const const_batch_view<size, size> chunk)
+			{
+				for (index_t i = 0; i < chunk.size(); ++i)
+					scanned += is_outlier(chunk[i]);
+			});
+		auto middle = std::chrono::high_resolution_clock::now();
+		// Only the chunks that can hold an outlier.
+		index_t skipped = 0;
+		const index_t visited = reader.for_each_chunk([](const batch_chunk_statistics& chunk) { return chunk.max > 100; },
+			[&](index_t, const const_batch_view<size, size> chunk)
+			{
+				for (index_t i = 0; i < chunk.size(); ++i)
+					skipped += is_outlier(chunk[i]);
+			});
+		auto end = std::chrono::high_resolution_clock::now();
+		std::cout << (encoding == batch_encoding::raw ? "Raw" : "Coded") << " file: scanning " <<
+			reader.chunk_count() << " chunks found " << scanned << " outliers in " <<
+			(timer(middle - start).count() * 1e3) << " ms; the index admitted " << visited <<
+			" chunks and found " << skipped << " in " << (timer(end - middle).count() * 1e3) << " ms.\n";
+
+		double checksum = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned lookup = 0; lookup < lookup_count; ++lookup)
+			checksum += reader[position(generator)][1][1];
+		end = std::chrono::high_resolution_clock::now();
+		std::cout << "Random access: " << (timer(end - start).count() / lookup_count * 1e9) << " ns per matrix (" <<
+			(checksum != 0) << ").\n";
+	}
+
+	std::remove(path);
+	return 0;
+}
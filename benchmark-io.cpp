@@ -0,0 +1,66 @@
+/*
+ * Batch file I/O benchmark.
+ *
+ * Writes a batch file of random 8x8 matrices, then inverts it file to file, with blocking I/O
+ * and with io_uring, each through the page cache and with O_DIRECT. Reports the rate at which
+ * matrices pass through, and the I/O bandwidth that corresponds to. For a fair comparison of
+ * direct and buffered I/O, drop the page cache between runs (or use a file larger than memory).
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "matrix_io.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+int main ()
+{
+	constexpr index_t size = 8;
+	constexpr index_t count = 1 << 18;
+	const char* input = "benchmark-io-input.bin";
+	const char* output = "benchmark-io-output.bin";
+
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	std::uniform_int_distribution<> distribution(-10, 10);
+	std::vector<square_matrix<size>> batch(count);
+	for (auto& mtx : batch)
+		for (auto& row : mtx)
+			for (auto& element : row)
+				element = distribution(generator);
+	write_batch_file(input, batch.data(), batch.size());
+	batch.clear();
+
+	io_ring probe;
+	std::cout << "io_uring is " << (probe.asynchronous() ? "available" : "unavailable") << ".\n";
+
+	for (const bool asynchronous : {false, true})
+		for (const bool direct : {false, true})
+		{
+			batch_io_options options;
+			options.asynchronous = asynchronous;
+			options.direct = direct;
+			auto start = std::chrono::high_resolution_clock::now();
+			const index_t inverted = invert_batch_file<size>(input, output, nullptr, options);
+			auto end = std::chrono::high_resolution_clock::now();
+			const double seconds = timer(end - start).count();
+			std::cout << (asynchronous ? "io_uring" : "blocking") << (direct ? ", direct: " : ", buffered: ") <<
+				(count / seconds) << " matrices/s, " <<
+				(2.0 * count * sizeof(square_matrix<size>) / seconds / (1 << 20)) << " MiB/s (" <<
+				inverted << " inverted).\n";
+		}
+
+	std::remove(input);
+	std::remove(output);
+	return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * LU factorization benchmark.
+ *
+ * Times standard right-looking blocked LU against communication-avoiding LU (tournament pivoting)
+ * on random matrices, at each thread count from one to the number of hardware threads. The
+ * difference lies in the panels, so it grows with the number of threads, and on multi-socket
+ * machines with the cost of sharing the column searched at each step of partial pivoting.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3 -pthread
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "matrix_lu.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+//
+// time_lu<>().
+//
+// Factorizes test_count random Size x Size matrices both ways, on thread_count threads, and
+// reports the rate of each in GFLOP/s (counting 2/3 Size^3 operations per factorization).
+//
+template <index_t Size, index_t BlockSize, typename Generator>
+void time_lu(unsigned test_count, unsigned thread_count, Generator& generator)
+{
+	std::uniform_real_distribution<> distribution(-1, 1);
+	auto source = std::make_unique<square_matrix<Size>>();
+	auto blocked = std::make_unique<square_matrix<Size>>();
+	auto tournament = std::make_unique<square_matrix<Size>>();
+	row_permutation<Size> permutation;
+
+	timer blocked_time{0}, tournament_time{0};
+	for (unsigned test = 0; test < test_count; ++test)
+	{
+		for (auto& row : *source)
+			for (auto& element : row)
+				element = distribution(generator);
+		*blocked = *source;
+		*tournament = *source;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		lu_blocked<BlockSize>(*blocked, permutation, thread_count);
+		auto middle = std::chrono::high_resolution_clock::now();
+		calu<BlockSize>(*tournament, permutation, thread_count);
+		auto end = std::chrono::high_resolution_clock::now();
+		blocked_time += middle - start;
+		tournament_time += end - middle;
+	}
+
+	const double operations = 2.0 / 3.0 * double(Size) * Size * Size * test_count * 1e-9;
+	std::cout << "LU, " << Size << "x" << Size << ", " << thread_count << " thread(s): blocked " <<
+		(operations / blocked_time.count()) << " GFLOP/s; CALU " <<
+		(operations / tournament_time.count()) << " GFLOP/s.\n";
+}
+
+int main ()
+{
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+
+	const unsigned max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+	{
+		time_lu<256, 32>(10, threads, generator);
+		time_lu<1024, 64>(2, threads, generator);
+		time_lu<2048, 64>(1, threads, generator);
+	}
+
+	return 0;
+}
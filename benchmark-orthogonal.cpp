@@ -0,0 +1,101 @@
+/*
+ * Orthogonal transformation benchmark.
+ *
+ * Times the orthogonal primitives separately: Givens rotation of row pairs, and Householder QR 
+ * factorization one reflector at a time against the blocked (compact WY) form.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "matrix_orthogonal.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+//
+// time_givens<>().
+//
+// Rotates each consecutive pair of a set of rows of width Width, repeat_count times over.
+//
+template <index_t Width, typename Generator>
+void time_givens(unsigned repeat_count, Generator& generator)
+{
+	std::uniform_real_distribution<> distribution(-1, 1);
+	std::vector<row<Width>> rows(64);
+	for (auto& row : rows)
+		for (auto& element : row)
+			element = distribution(generator);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned repeat = 0; repeat < repeat_count; ++repeat)
+		for (std::size_t i = 1; i < rows.size(); ++i)
+		{
+			const auto rotation = givens_rotation<>::make(rows[i-1][0], rows[i][0]);
+			rotation.apply(rows[i-1], rows[i]);
+		}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	const double rotations = double(repeat_count) * (rows.size() - 1);
+	std::cout << "Givens, width " << Width << ": " << 
+		(timer(end - start).count() / rotations) << " s per row pair.\n";
+}
+
+//
+// time_qr<>().
+//
+// Factorizes test_count random Height x Width matrices, unblocked and blocked.
+//
+template <index_t Height, index_t Width, index_t BlockSize, typename Generator>
+void time_qr(unsigned test_count, Generator& generator)
+{
+	std::uniform_real_distribution<> distribution(-1, 1);
+	auto source = std::make_unique<matrix<Height, Width>>();
+	auto unblocked = std::make_unique<matrix<Height, Width>>();
+	auto blocked = std::make_unique<matrix<Height, Width>>();
+	std::array<double, Width> tau;
+
+	timer unblocked_time{0}, blocked_time{0};
+	for (unsigned test = 0; test < test_count; ++test)
+	{
+		for (auto& row : *source)
+			for (auto& element : row)
+				element = distribution(generator);
+		*unblocked = *source;
+		*blocked = *source;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		householder_qr_unblocked(unblocked->view(), tau);
+		auto middle = std::chrono::high_resolution_clock::now();
+		householder_qr<BlockSize>(*blocked, tau);
+		auto end = std::chrono::high_resolution_clock::now();
+		unblocked_time += middle - start;
+		blocked_time += end - middle;
+	}
+
+	std::cout << "QR, " << Height << "x" << Width << ": unblocked " << 
+		(unblocked_time.count() / test_count) << " s; blocked (" << BlockSize << " columns) " <<
+		(blocked_time.count() / test_count) << " s per matrix.\n";
+}
+
+int main ()
+{
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+
+	time_givens<8>(200'000, generator);
+	time_givens<256>(20'000, generator);
+	time_qr<64, 16, 8>(5'000, generator);
+	time_qr<512, 128, 32>(20, generator);
+	time_qr<1024, 256, 32>(4, generator);
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Matrix inversion benchmark on inputs that need a row interchange at every other step.
+ *
+ * Compares inversion by row reduction of the physically augmented matrix, in which each 
+ * interchange moves two rows of the augmented matrix, with invert(), which interchanges rows by
+ * permuting an index.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "matrix_math.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+//
+// make_pivoting_matrix<>().
+//
+// Produces a random block upper triangular matrix whose diagonal blocks are [0 a; b c]. The zero
+// on the diagonal is never filled in by elimination, so every other step must interchange rows.
+//
+template <index_t Size, typename Generator>
+square_matrix<Size> make_pivoting_matrix(Generator& generator)
+{
+	static_assert(Size % 2 == 0, "Size must be even.");
+	std::uniform_int_distribution<> distribution(1, 10);
+	square_matrix<Size> mtx;
+	for (index_t r = 0; r < Size; ++r)
+		for (index_t c = r / 2 * 2 + 2; c < Size; ++c)
+			mtx[r][c] = distribution(generator);
+	for (index_t k = 0; k < Size; k += 2)
+	{
+		mtx[k][k+1] = distribution(generator);
+		mtx[k+1][k] = distribution(generator);
+		mtx[k+1][k+1] = distribution(generator);
+	}
+	return mtx;
+}
+
+//
+// time_inversions<>().
+//
+// Inverts test_count pivot-heavy matrices of dimension Size by each method, and reports the time
+// spent in each.
+//
+template <index_t Size>
+void time_inversions(unsigned test_count)
+{
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+
+	timer augmented_time{0}, permuted_time{0};
+	auto mtx = std::make_unique<square_matrix<Size>>();
+	auto check = std::make_unique<square_matrix<Size>>();
+	for (unsigned test = 0; test < test_count; ++test)
+	{
+		*mtx = make_pivoting_matrix<Size>(generator);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		auto augmented = horizontal_concat(*mtx, square_matrix<Size>::get_identity_matrix());
+		augmented.row_reduce();
+		*check = augmented.get_right_slice();
+		auto end = std::chrono::high_resolution_clock::now();
+		augmented_time += end - start;
+
+		start = std::chrono::high_resolution_clock::now();
+		mtx->invert_gauss_jordan();
+		end = std::chrono::high_resolution_clock::now();
+		permuted_time += end - start;
+
+		if (*mtx != *check)
+			std::cout << "Inverses differ!\n";
+	}
+
+	std::cout << Size << "x" << Size << ": " <<
+		"augmented, with row interchange: " << (augmented_time.count() / test_count) << " s; " <<
+		"permuted index: " << (permuted_time.count() / test_count) << " s per matrix.\n";
+}
+
+int main ()
+{
+	time_inversions<8>(200'000);
+	time_inversions<32>(20'000);
+	time_inversions<128>(200);
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Shared memory ring benchmark.
+ *
+ * Passes random 4x4 matrices of small integers to another process to be inverted and back, first
+ * through a matrix_ring, then serialized through a pair of pipes, and reports the throughput of
+ * each.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3 -pthread
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "matrix_ring.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+constexpr index_t size = 4;
+using matrix_t = square_matrix<size>;
+
+// Reads or writes all of bytes through a pipe, or fails.
+bool read_pipe(const int fd, void* buffer, const std::size_t bytes)
+{
+	for (std::size_t done = 0; done < bytes; )
+	{
+		const ssize_t step = ::read(fd, static_cast<char*>(buffer) + done, bytes - done);
+		if (step <= 0)
+			return false;
+		done += step;
+	}
+	return true;
+}
+bool write_pipe(const int fd, const void* buffer, const std::size_t bytes)
+{
+	for (std::size_t done = 0; done < bytes; )
+	{
+		const ssize_t step = ::write(fd, static_cast<const char*>(buffer) + done, bytes - done);
+		if (step <= 0)
+			return false;
+		done += step;
+	}
+	return true;
+}
+
+int main ()
+{
+	constexpr index_t count = 1 << 20;
+	constexpr index_t ring_capacity = 4096;
+	constexpr index_t pipe_batch = 256;
+	const std::string name = "/benchmark_ring_" + std::to_string(::getpid());
+
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	std::uniform_int_distribution<> distribution(-10, 10);
+	std::vector<matrix_t> batch(count), results(count);
+	for (auto& mtx : batch)
+		for (auto& row : mtx)
+			for (auto& element : row)
+				element = distribution(generator);
+
+	{
+		auto ring = matrix_ring<size, size>::create(name, ring_capacity);
+		const pid_t inverter = ::fork();
+		if (inverter == 0)
+		{
+			auto shared = matrix_ring<size, size>::open(name);
+			while (shared.invert_pending() > 0)
+				;
+			::_exit(0);
+		}
+
+		index_t produced = 0, collected = 0, inverted = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		while (collected < count)
+		{
+			const auto free = ring.claim(count - produced, false);
+			std::copy_n(batch.begin() + produced, free.size(), free.begin());
+			ring.publish(free.size());
+			produced += free.size();
+			if (produced == count && !ring.closed())
+				ring.close();
+
+			const auto done = ring.results(std::numeric_limits<index_t>::max(), free.empty() || ring.closed());
+			std::copy(done.begin(), done.end(), results.begin() + collected);
+			for (index_t i = 0; i < done.size(); ++i)
+				inverted += done.status[i];
+			collected += done.size();
+			ring.release(done.size());
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		::waitpid(inverter, nullptr, 0);
+		matrix_ring<size, size>::remove(name);
+		std::cout << "Shared memory ring: " << (count / timer(end - start).count()) << " matrices/s (" <<
+			inverted << " inverted).\n";
+	}
+
+	{
+		int requests[2], replies[2];
+		if (::pipe(requests) != 0 || ::pipe(replies) != 0)
+			return 1;
+		const pid_t inverter = ::fork();
+		if (inverter == 0)
+		{
+			::close(requests[1]);
+			::close(replies[0]);
+			std::vector<matrix_t> chunk(pipe_batch);
+			std::vector<bool> status(pipe_batch);
+			while (read_pipe(requests[0], chunk.data(), sizeof(matrix_t) * pipe_batch))
+			{
+				invert_batch(chunk.begin(), chunk.end(), status.begin());
+				write_pipe(replies[1], chunk.data(), sizeof(matrix_t) * pipe_batch);
+			}
+			::_exit(0);
+		}
+		::close(requests[0]);
+		::close(replies[1]);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		std::thread producer([&]
+		{
+			for (index_t done = 0; done < count; done += pipe_batch)
+				write_pipe(requests[1], &batch[done], sizeof(matrix_t) * pipe_batch);
+			::close(requests[1]);
+		});
+		for (index_t done = 0; done < count; done += pipe_batch)
+			read_pipe(replies[0], &results[done], sizeof(matrix_t) * pipe_batch);
+		const auto end = std::chrono::high_resolution_clock::now();
+		producer.join();
+		::waitpid(inverter, nullptr, 0);
+		std::cout << "Pipes: " << (count / timer(end - start).count()) << " matrices/s.\n";
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Matrix series benchmark.
+ *
+ * Logs a 64x64 matrix that changes in a few elements each step, as a simulation's system matrix
+ * might, to a series file, and reports its size against that of the raw matrices, the rate of
+ * writing, the rate of decoding every step in order, and the time to decode steps at random.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include <sys/stat.h>
+
+#include "matrix_series.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+int main ()
+{
+	constexpr index_t size = 64;
+	constexpr index_t step_count = 20000;
+	constexpr unsigned changes_per_step = 8;
+	constexpr unsigned lookup_count = 2000;
+	const char* path = "benchmark-series.bin";
+
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	std::uniform_real_distribution<> distribution(-1, 1);
+	std::uniform_int_distribution<index_t> position(0, size - 1);
+	auto mtx = std::make_unique<square_matrix<size>>();
+	for (auto& row : *mtx)
+		for (auto& element : row)
+			element = distribution(generator);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		series_writer<size, size> writer(path);
+		for (index_t step = 0; step < step_count; ++step)
+		{
+			for (unsigned change = 0; change < changes_per_step; ++change)
+				(*mtx)[position(generator)][position(generator)] += 1e-3 * distribution(generator);
+			writer.append(*mtx);
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	struct stat status;
+	::stat(path, &status);
+	const double raw_bytes = double(step_count) * sizeof(*mtx);
+	std::cout << step_count << " steps of a " << size << "x" << size << " matrix, " << changes_per_step <<
+		" changes per step: " << (status.st_size / double(1 << 20)) << " MiB against " <<
+		(raw_bytes / (1 << 20)) << " MiB raw (ratio " << (raw_bytes / status.st_size) << "); written at " <<
+		(step_count / timer(end - start).count()) << " steps/s.\n";
+
+	const series_reader<size, size> reader(path);
+	double checksum = 0;
+	start = std::chrono::high_resolution_clock::now();
+	reader.for_each(0, step_count, [&](index_t, const square_matrix<size>& decoded)
+	{
+		checksum += decoded[0][0];
+	});
+	end = std::chrono::high_resolution_clock::now();
+	std::cout << "Sequential decoding: " << (step_count / timer(end - start).count()) << " steps/s, " <<
+		(raw_bytes / timer(end - start).count() / (1 << 20)) << " MiB/s of matrices.\n";
+
+	std::uniform_int_distribution<index_t> step(0, step_count - 1);
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned lookup = 0; lookup < lookup_count; ++lookup)
+	{
+		reader.get(step(generator), *mtx);
+		checksum += (*mtx)[1][1];
+	}
+	end = std::chrono::high_resolution_clock::now();
+	std::cout << "Random access: " << (timer(end - start).count() / lookup_count * 1e6) << " us per step, " <<
+		reader.keyframe_count() << " keyframes (" << (checksum != 0) << ").\n";
+
+	std::remove(path);
+	return 0;
+}
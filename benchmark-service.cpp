@@ -0,0 +1,89 @@
+/*
+ * Inversion service benchmark.
+ *
+ * Serves 8x8 inversions on a Unix domain socket, and drives the server with a number of client
+ * threads, each sending requests of a few matrices and waiting for every reply before sending its
+ * next request. For each batching window and number of clients, reports the rate of inversion,
+ * the mean and 99th percentile latency of a request, and the mean number of matrices per batch.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3 -pthread
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "matrix_service.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+int main ()
+{
+	constexpr index_t size = 8;
+	constexpr index_t request_size = 4;
+	constexpr unsigned requests_per_client = 2000;
+	const std::string path = "benchmark-service-" + std::to_string(::getpid()) + ".sock";
+
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+	std::uniform_real_distribution<> distribution(-1, 1);
+	std::vector<square_matrix<size>> matrices(request_size);
+	for (auto& mtx : matrices)
+		for (auto& row : mtx)
+			for (auto& element : row)
+				element = distribution(generator);
+
+	for (const unsigned window : {0, 50, 200, 1000})
+		for (const unsigned client_count : {1, 4, 16})
+		{
+			service_options options;
+			options.window = std::chrono::microseconds(window);
+			matrix_server<size> server(path, options);
+			std::thread serving([&server] { server.run(); });
+
+			std::vector<std::vector<double>> latencies(client_count);
+			std::vector<std::thread> clients;
+			const auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned c = 0; c < client_count; ++c)
+				clients.emplace_back([&, c]
+				{
+					matrix_client<size> client(path);
+					std::vector<square_matrix<size>> inverses(request_size);
+					for (unsigned r = 0; r < requests_per_client; ++r)
+					{
+						const auto sent = std::chrono::high_resolution_clock::now();
+						client.invert(matrices.data(), request_size, inverses.data());
+						latencies[c].push_back(timer(std::chrono::high_resolution_clock::now() - sent).count());
+					}
+				});
+			for (auto& client : clients)
+				client.join();
+			const auto end = std::chrono::high_resolution_clock::now();
+			server.stop();
+			serving.join();
+
+			std::vector<double> all;
+			for (const auto& client : latencies)
+				all.insert(all.end(), client.begin(), client.end());
+			std::sort(all.begin(), all.end());
+			double total = 0;
+			for (const double latency : all)
+				total += latency;
+			const auto statistics = server.statistics();
+			std::cout << "Window " << window << " us, " << client_count << " clients: " <<
+				(statistics.matrices / timer(end - start).count()) << " inversions/s, latency " <<
+				(total / all.size() * 1e6) << " us mean, " << (all[all.size() * 99 / 100] * 1e6) << " us p99, " <<
+				(double(statistics.matrices) / statistics.batches) << " matrices per batch.\n";
+		}
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Streaming store benchmark.
+ *
+ * Alternates concatenation of large matrices (forming augmented matrices, as for inversion)
+ * with random lookups in a table small enough to stay cached, and times both, with the
+ * concatenations stored normally and with non-temporal stores. Streaming stores should leave
+ * the table in cache, so that the lookups are faster, at little or no cost to the copies.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "matrix_math.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+//
+// time_concat<>().
+//
+// Concatenates two random Size x Size matrices, then makes lookup_count random reads in a table
+// of table_size elements, repeat_count times over.
+//
+template <index_t Size, typename Generator>
+void time_concat(const store_policy policy, unsigned repeat_count, std::size_t table_size,
+	unsigned lookup_count, Generator& generator)
+{
+	std::uniform_real_distribution<> distribution(-1, 1);
+	auto lhs = std::make_unique<square_matrix<Size>>();
+	auto rhs = std::make_unique<square_matrix<Size>>();
+	auto augmented = std::make_unique<matrix<Size, 2*Size>>();
+	for (auto* mtx : {lhs.get(), rhs.get()})
+		for (auto& row : *mtx)
+			for (auto& element : row)
+				element = distribution(generator);
+
+	std::vector<std::uint32_t> table(table_size);
+	for (auto& entry : table)
+		entry = std::uint32_t(generator());
+	std::vector<std::uint32_t> lookups(lookup_count);
+	for (auto& lookup : lookups)
+		lookup = std::uint32_t(generator() % table_size);
+
+	timer concat_time{0}, lookup_time{0};
+	std::uint32_t checksum = 0;
+	for (unsigned repeat = 0; repeat < repeat_count; ++repeat)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		horizontal_concat(*lhs, *rhs, *augmented, policy);
+		auto middle = std::chrono::high_resolution_clock::now();
+		for (const auto lookup : lookups)
+			checksum += table[lookup];
+		auto end = std::chrono::high_resolution_clock::now();
+		concat_time += middle - start;
+		lookup_time += end - middle;
+	}
+
+	std::cout << "Concatenation of " << Size << "x" << Size << " pairs, " <<
+		(policy == store_policy::streaming ? "streaming" : "cached") << ": " <<
+		(concat_time.count() / repeat_count) << " s per concatenation; " <<
+		(lookup_time.count() / repeat_count / lookup_count * 1e9) << " ns per lookup (" <<
+		(checksum & 1) << ").\n";
+}
+
+int main ()
+{
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+
+	for (const auto policy : {store_policy::cached, store_policy::streaming})
+	{
+		time_concat<512>(policy, 200, 256 * 1024, 100'000, generator);
+		time_concat<1024>(policy, 50, 256 * 1024, 100'000, generator);
+	}
+
+	return 0;
+}
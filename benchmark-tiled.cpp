@@ -0,0 +1,143 @@
+/*
+ * Tile algorithm benchmark.
+ *
+ * Times multiplication of large matrices in row-major storage, in tiles stored row by row and in
+ * tiles stored in Z-order. Then times the tiled LU, Cholesky and QR factorizations, run by the
+ * task scheduler, against the loop-parallel blocked LU on the same matrix, and reports the
+ * utilization of the workers. The trace of the last tiled LU is written to tiled-lu-trace.json,
+ * for chrome://tracing or Perfetto.
+ *
+ *
+ * Invoke with c++ -std=c++14 -O3 -pthread
+ *
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "matrix_lu.hpp"
+#include "matrix_tiled.hpp"
+
+using timer = std::chrono::duration<double>;
+
+using namespace matrix_math;
+
+//
+// time_multiply<>().
+//
+// Multiplies two random Size x Size matrices in each layout, on thread_count threads (row-major
+// storage on one).
+//
+template <index_t Size, index_t TileSize, typename Generator>
+void time_multiply(unsigned thread_count, Generator& generator)
+{
+	std::uniform_real_distribution<> distribution(-1, 1);
+	auto a = std::make_unique<square_matrix<Size>>();
+	auto b = std::make_unique<square_matrix<Size>>();
+	auto c = std::make_unique<square_matrix<Size>>();
+	for (auto* mtx : {a.get(), b.get()})
+		for (auto& row : *mtx)
+			for (auto& element : row)
+				element = distribution(generator);
+	const double operations = 2.0 * double(Size) * Size * Size * 1e-9;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	gemm(1.0, *a, *b, 0.0, *c);
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << Size << "x" << Size << " product: row-major " <<
+		(operations / timer(end - start).count()) << " GFLOP/s";
+
+	tiled_matrix<Size, TileSize> tiled_a{*a}, tiled_b{*b}, tiled_c;
+	start = std::chrono::high_resolution_clock::now();
+	gemm(1.0, tiled_a, tiled_b, 0.0, tiled_c, thread_count);
+	end = std::chrono::high_resolution_clock::now();
+	std::cout << "; tiles (" << TileSize << ") by row " << (operations / timer(end - start).count()) << " GFLOP/s";
+
+	tiled_matrix<Size, TileSize, double, tile_order::morton> z_a{*a}, z_b{*b}, z_c;
+	start = std::chrono::high_resolution_clock::now();
+	gemm(1.0, z_a, z_b, 0.0, z_c, thread_count);
+	end = std::chrono::high_resolution_clock::now();
+	std::cout << "; tiles in Z-order " << (operations / timer(end - start).count()) << " GFLOP/s, on " <<
+		thread_count << " thread(s).\n";
+}
+
+//
+// time_tiled<>().
+//
+// Factorizes a random Size x Size matrix in tiles of TileSize, on thread_count threads.
+//
+template <index_t Size, index_t TileSize, typename Generator>
+void time_tiled(unsigned thread_count, Generator& generator)
+{
+	std::uniform_real_distribution<> distribution(-1, 1);
+	auto source = std::make_unique<square_matrix<Size>>();
+	for (auto& row : *source)
+		for (auto& element : row)
+			element = distribution(generator);
+	const double lu_operations = 2.0 / 3.0 * double(Size) * Size * Size * 1e-9;
+
+	// Loop-parallel blocked LU, for comparison.
+	auto blocked = std::make_unique<square_matrix<Size>>(*source);
+	row_permutation<Size> permutation;
+	auto start = std::chrono::high_resolution_clock::now();
+	lu_blocked<TileSize>(*blocked, permutation, thread_count);
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << Size << "x" << Size << ", " << thread_count << " thread(s): blocked LU " <<
+		(lu_operations / timer(end - start).count()) << " GFLOP/s.\n";
+
+	tiled_matrix<Size, TileSize> tiled{*source};
+	task_graph lu_graph;
+	tiled_lu(tiled, permutation, lu_graph);
+	start = std::chrono::high_resolution_clock::now();
+	lu_graph.run(thread_count);
+	end = std::chrono::high_resolution_clock::now();
+	std::cout << "\ttiled LU (" << TileSize << ") " << (lu_operations / timer(end - start).count()) <<
+		" GFLOP/s, " << lu_graph.size() << " tasks, utilization " << lu_graph.utilization() << ".\n";
+	std::ofstream trace("tiled-lu-trace.json");
+	lu_graph.write_trace(trace);
+
+	// A A^T + Size I is positive definite.
+	auto spd = std::make_unique<square_matrix<Size>>();
+	syrk(1.0, *source, 0.0, *spd);
+	for (index_t i = 0; i < Size; ++i)
+		(*spd)[i][i] += Size;
+	tiled.assign(*spd);
+	task_graph cholesky_graph;
+	tiled_cholesky(tiled, cholesky_graph);
+	start = std::chrono::high_resolution_clock::now();
+	cholesky_graph.run(thread_count);
+	end = std::chrono::high_resolution_clock::now();
+	std::cout << "\ttiled Cholesky " << (lu_operations / 2 / timer(end - start).count()) <<
+		" GFLOP/s, utilization " << cholesky_graph.utilization() << ".\n";
+
+	tiled.assign(*source);
+	std::vector<std::array<double, TileSize>> tau;
+	task_graph qr_graph;
+	tiled_qr(tiled, tau, qr_graph);
+	start = std::chrono::high_resolution_clock::now();
+	qr_graph.run(thread_count);
+	end = std::chrono::high_resolution_clock::now();
+	std::cout << "\ttiled QR " << (lu_operations * 2 / timer(end - start).count()) <<
+		" GFLOP/s, utilization " << qr_graph.utilization() << ".\n";
+}
+
+int main ()
+{
+	std::random_device seed{};
+	std::mt19937_64 generator{seed()};
+
+	const unsigned max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	time_multiply<2048, 64>(max_threads, generator);
+	time_multiply<4096, 64>(max_threads, generator);
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+	{
+		time_tiled<512, 64>(threads, generator);
+		time_tiled<1024, 128>(threads, generator);
+	}
+
+	return 0;
+}
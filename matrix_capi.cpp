@@ -0,0 +1,275 @@
+/*
+ * Matrix maths: C interface.
+ *
+ * The kernels behind matrix_capi.h. Each entry point checks its arguments, then passes the batch
+ * to the kernel for the size of its matrices: the template for that size if one is compiled, and
+ * otherwise the same template with the size given at run time.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "matrix_capi.h"
+#include "matrix_math.hpp"
+
+namespace
+{
+	using namespace matrix_math;
+
+	template <index_t Size>
+	using size_constant = std::integral_constant<index_t, Size>;
+
+	// Calls fn with the size_constant for n if kernels of that size are compiled, and with
+	// size_constant<0> otherwise.
+	template <typename Function>
+	auto dispatch(const index_t n, Function fn)
+	{
+		switch (n)
+		{
+			case 2: return fn(size_constant<2>{});
+			case 3: return fn(size_constant<3>{});
+			case 4: return fn(size_constant<4>{});
+			case 5: return fn(size_constant<5>{});
+			case 6: return fn(size_constant<6>{});
+			case 7: return fn(size_constant<7>{});
+			case 8: return fn(size_constant<8>{});
+			case 16: return fn(size_constant<16>{});
+			case 32: return fn(size_constant<32>{});
+			case 64: return fn(size_constant<64>{});
+			default: return fn(size_constant<0>{});
+		}
+	}
+
+	// The library's matrices are viewed in place in the caller's buffers.
+	static_assert(sizeof(square_matrix<64>) == 64 * 64 * sizeof(double), "matrices must not be padded");
+
+	// Solves A X = B by Gaussian elimination with partial pivoting, where A is n x n and B is
+	// n x width, both stored by rows. Both are overwritten, and B holds X if A is not singular.
+	// Size is n if the size is compiled, and zero otherwise.
+	template <index_t Size>
+	bool eliminate(const index_t runtime_size, double* a, double* b, const index_t width) noexcept
+	{
+		const index_t n = Size ? Size : runtime_size;
+		for (index_t j = 0; j < n; ++j)
+		{
+			index_t p = j;
+			for (index_t i = j+1; i < n; ++i)
+				if (std::abs(a[i * n + j]) > std::abs(a[p * n + j]))
+					p = i;
+			if (std::abs(a[p * n + j]) <= equality_tolerance)
+				return false;
+			if (p != j)
+			{
+				std::swap_ranges(a + j * n + j, a + j * n + n, a + p * n + j);
+				std::swap_ranges(b + j * width, b + j * width + width, b + p * width);
+			}
+
+			const double reciprocal = 1 / a[j * n + j];
+			for (index_t i = j+1; i < n; ++i)
+			{
+				const double factor = a[i * n + j] * reciprocal;
+				if (factor == 0)
+					continue;
+				for (index_t k = j+1; k < n; ++k)
+					a[i * n + k] = multiply_add(-factor, a[j * n + k], a[i * n + k]);
+				for (index_t k = 0; k < width; ++k)
+					b[i * width + k] = multiply_add(-factor, b[j * width + k], b[i * width + k]);
+			}
+		}
+
+		for (index_t i = n; i-- > 0; )
+		{
+			for (index_t k = i+1; k < n; ++k)
+			{
+				const double factor = a[i * n + k];
+				if (factor != 0)
+					for (index_t c = 0; c < width; ++c)
+						b[i * width + c] = multiply_add(-factor, b[k * width + c], b[i * width + c]);
+			}
+			const double reciprocal = 1 / a[i * n + i];
+			for (index_t c = 0; c < width; ++c)
+				b[i * width + c] *= reciprocal;
+		}
+		return true;
+	}
+
+	// Inverts the n x n matrix mtx in place, or leaves it unchanged, with the compiled kernel.
+	template <index_t Size>
+	bool invert(index_t, double* mtx, double*, std::true_type) noexcept
+	{
+		return reinterpret_cast<square_matrix<Size>*>(mtx)->try_invert();
+	}
+
+	// As above, by elimination against the identity in scratch, which holds 2 n² elements.
+	template <index_t Size>
+	bool invert(const index_t n, double* mtx, double* scratch, std::false_type) noexcept
+	{
+		double* const copy = scratch;
+		double* const inverse = scratch + n * n;
+		std::copy_n(mtx, n * n, copy);
+		std::fill_n(inverse, n * n, 0.0);
+		for (index_t i = 0; i < n; ++i)
+			inverse[i * n + i] = 1;
+		if (!eliminate<Size>(n, copy, inverse, n))
+			return false;
+		std::copy_n(inverse, n * n, mtx);
+		return true;
+	}
+
+	// C = A B, where A is m x k and B is k x n, with the compiled kernel for square matrices.
+	template <index_t Size>
+	void multiply(index_t, index_t, index_t, const double* a, const double* b, double* c, std::true_type) noexcept
+	{
+		gemm(1.0, *reinterpret_cast<const square_matrix<Size>*>(a), *reinterpret_cast<const square_matrix<Size>*>(b),
+			0.0, *reinterpret_cast<square_matrix<Size>*>(c));
+	}
+
+	// As above, for any dimensions.
+	template <index_t Size>
+	void multiply(const index_t m, const index_t k, const index_t n, const double* a, const double* b, double* c,
+		std::false_type) noexcept
+	{
+		for (index_t r = 0; r < m; ++r)
+		{
+			double* const product = c + r * n;
+			std::fill_n(product, n, 0.0);
+			for (index_t i = 0; i < k; ++i)
+			{
+				const double factor = a[r * k + i];
+				if (factor != 0)
+					for (index_t col = 0; col < n; ++col)
+						product[col] = multiply_add(factor, b[i * n + col], product[col]);
+			}
+		}
+	}
+
+	// Fetches the next matrices of a batch while the current ones are worked on, as invert_batch()
+	// does.
+	inline void prefetch_next(const index_t i, const index_t count, const double* first, const index_t stride,
+		const index_t elements, const bool write) noexcept
+	{
+		if (stride != 0 && i + 1 < count && elements * sizeof(double) <= batch_prefetch_limit)
+			detail::prefetch(first + (i + 1) * stride, elements * sizeof(double), write);
+	}
+
+} // End anonymous namespace.
+
+extern "C"
+{
+	unsigned mm_abi_version(void)
+	{
+		return MM_ABI_VERSION;
+	}
+
+	size_t mm_invert_batch_f64(const size_t n, const size_t count, const double* in, const size_t stride,
+		double* out, unsigned char* status)
+	{
+		if (count == 0)
+			return 0;
+		if (n == 0 || !in || !out || stride < n * n)
+			return MM_ERROR;
+
+		try
+		{
+			return dispatch(n, [=](auto size)
+			{
+				constexpr index_t Size = decltype(size)::value;
+				std::vector<double> scratch(Size ? 0 : 2 * n * n);
+				size_t inverted = 0;
+				for (size_t i = 0; i < count; ++i)
+				{
+					double* const mtx = out + i * stride;
+					if (in != out)
+					{
+						std::copy_n(in + i * stride, n * n, mtx);
+						prefetch_next(i, count, in, stride, n * n, false);
+					}
+					prefetch_next(i, count, out, stride, n * n, true);
+
+					const bool success = invert<Size>(n, mtx, scratch.data(), std::integral_constant<bool, Size != 0>{});
+					if (status)
+						status[i] = success;
+					inverted += success;
+				}
+				return inverted;
+			});
+		}
+		catch (const std::bad_alloc&)
+		{
+			return MM_ERROR;
+		}
+	}
+
+	size_t mm_solve_batch_f64(const size_t n, const size_t nrhs, const size_t count, const double* a,
+		const size_t a_stride, double* b, const size_t b_stride, unsigned char* status)
+	{
+		if (count == 0)
+			return 0;
+		if (n == 0 || nrhs == 0 || !a || !b || (a_stride != 0 && a_stride < n * n) || b_stride < n * nrhs)
+			return MM_ERROR;
+
+		try
+		{
+			return dispatch(n, [=](auto size)
+			{
+				constexpr index_t Size = decltype(size)::value;
+				std::vector<double> scratch(n * n + n * nrhs);
+				double* const lhs = scratch.data();
+				double* const solution = lhs + n * n;
+				size_t solved = 0;
+				for (size_t i = 0; i < count; ++i)
+				{
+					prefetch_next(i, count, a, a_stride, n * n, false);
+					prefetch_next(i, count, b, b_stride, n * nrhs, true);
+
+					// Eliminated in scratch, so that a failure leaves B as it was.
+					std::copy_n(a + i * a_stride, n * n, lhs);
+					std::copy_n(b + i * b_stride, n * nrhs, solution);
+					const bool success = eliminate<Size>(n, lhs, solution, nrhs);
+					if (success)
+						std::copy_n(solution, n * nrhs, b + i * b_stride);
+					if (status)
+						status[i] = success;
+					solved += success;
+				}
+				return solved;
+			});
+		}
+		catch (const std::bad_alloc&)
+		{
+			return MM_ERROR;
+		}
+	}
+
+	size_t mm_multiply_batch_f64(const size_t m, const size_t k, const size_t n, const size_t count,
+		const double* a, const size_t a_stride, const double* b, const size_t b_stride, double* c, const size_t c_stride)
+	{
+		if (count == 0)
+			return 0;
+		if (m == 0 || k == 0 || n == 0 || !a || !b || !c ||
+			(a_stride != 0 && a_stride < m * k) || (b_stride != 0 && b_stride < k * n) || c_stride < m * n)
+			return MM_ERROR;
+
+		const auto run = [=](auto size)
+		{
+			constexpr index_t Size = decltype(size)::value;
+			for (size_t i = 0; i < count; ++i)
+			{
+				prefetch_next(i, count, a, a_stride, m * k, false);
+				prefetch_next(i, count, b, b_stride, k * n, false);
+				multiply<Size>(m, k, n, a + i * a_stride, b + i * b_stride, c + i * c_stride,
+					std::integral_constant<bool, Size != 0>{});
+			}
+			return count;
+		};
+		return (m == k && k == n) ? dispatch(n, run) : run(size_constant<0>{});
+	}
+
+} // End extern "C".
@@ -0,0 +1,75 @@
+/*
+ * Matrix maths: C interface.
+ *
+ * Batch inversion, solution and multiplication of double precision matrices held in the caller's
+ * own buffers, for callers in C or through a foreign function interface. Nothing is copied into
+ * or out of the library's matrix types: the matrices are worked on where they lie.
+ *
+ * Each matrix is stored by rows, with its rows contiguous. The matrices of a batch are stride
+ * elements apart, and the stride must be at least the number of elements of a matrix. An input
+ * that is only read may have a stride of zero, in which case the one matrix is used for every
+ * entry of the batch.
+ *
+ * Square matrices of the common small sizes, and a few larger powers of two, are passed to the
+ * kernels compiled for that size; other sizes are handled by kernels whose size is known only at
+ * run time. A matrix is singular if elimination with partial pivoting meets a pivot no larger
+ * than equality_tolerance in magnitude, as in matrix_math.hpp.
+ *
+ * No function throws or keeps any state between calls, so any number of threads may call them
+ * at once on distinct batches. Functions that return a count return MM_ERROR if an argument is
+ * invalid (a null pointer where one is needed, a stride too small) or the scratch memory a
+ * kernel needs cannot be allocated.
+ *
+ * Compile matrix_capi.cpp with c++ -std=c++14 -O3 (adding -fPIC to build a shared library), and
+ * include this header from C99 or later, or from C++.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_CAPI_H
+#define CROWSTON_MATRIX_CAPI_H
+
+#include <stddef.h>
+
+#if defined(__GNUC__)
+#define MM_API __attribute__((visibility("default")))
+#else
+#define MM_API
+#endif
+
+// Incremented whenever the interface changes incompatibly.
+#define MM_ABI_VERSION 1
+
+// Returned in place of a count on failure.
+#define MM_ERROR ((size_t)-1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The MM_ABI_VERSION that the library was built with.
+MM_API unsigned mm_abi_version(void);
+
+// Inverts count n x n matrices from in into out, which may be the same buffer; each buffer holds
+// its matrices stride elements apart. Where a matrix is singular, out receives it unchanged. If
+// status is not null, status[i] is set to 1 if matrix i was inverted and to 0 otherwise.
+// Returns the number of matrices inverted.
+MM_API size_t mm_invert_batch_f64(size_t n, size_t count, const double* in, size_t stride,
+	double* out, unsigned char* status);
+
+// Solves A X = B for count pairs of an n x n matrix A and an n x nrhs matrix B, overwriting B
+// with X. A is not modified. Where A is singular, B is left unchanged. If status is not null,
+// status[i] is set to 1 if system i was solved and to 0 otherwise. Returns the number of systems
+// solved.
+MM_API size_t mm_solve_batch_f64(size_t n, size_t nrhs, size_t count, const double* a, size_t a_stride,
+	double* b, size_t b_stride, unsigned char* status);
+
+// Computes C = A B for count triples of an m x k matrix A, a k x n matrix B and an m x n matrix
+// C. C must not overlap A or B. Returns count.
+MM_API size_t mm_multiply_batch_f64(size_t m, size_t k, size_t n, size_t count, const double* a, size_t a_stride,
+	const double* b, size_t b_stride, double* c, size_t c_stride);
+
+#ifdef __cplusplus
+} // End extern "C".
+#endif
+
+#endif // End ifndef CROWSTON_MATRIX_CAPI_H.
@@ -0,0 +1,494 @@
+/*
+ * Matrix maths: lossless compression of matrix data.
+ *
+ * The shuffle_codec compresses arrays of fixed-size elements in stages. First the bytes are
+ * shuffled into planes: the first byte of every element, then the second byte of every element,
+ * and so on. Matrices of small integers, or of values with similar exponents, then have planes
+ * that are long runs of identical bytes, and planes with only a handful of distinct bytes. A
+ * plane with no more than sixteen distinct bytes may be packed, each byte replaced by its index
+ * in a dictionary, in 1, 2 or 4 bits. Each plane, packed or not, is then coded by a byte-oriented
+ * LZ77 coder, which reduces a run to a few bytes.
+ *
+ * The coded form of each plane is a mode byte, which is 0 for a plain plane and otherwise the
+ * bits per packed byte; for a packed plane, the dictionary, of 2 to the power of the mode bytes;
+ * the size of the LZ77 code, in four bytes, little-endian; and the LZ77 code. The planes are
+ * followed by any bytes left over after the last whole element, as they are.
+ *
+ * LZ77 code is a series of sequences, each a token byte, a run of literal bytes, and a match: an
+ * earlier stretch of the output, up to 65535 bytes back, to be copied. The high nibble of the
+ * token is the literal length and the low nibble the match length less four; a nibble of fifteen
+ * is continued by bytes which are added to it, up to and including the first that is not 255.
+ * Each match is given by its distance, in two bytes, little-endian, after the literals. The last
+ * sequence has literals only, and ends the output, whose length is known to the decoder.
+ *
+ * Decoding copies literals and matches sixteen bytes at a time, unpacks a byte at a time through
+ * a table, and unshuffles with SSE2 for 4- and 8-byte elements where available.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_CODEC_H
+#define CROWSTON_MATRIX_CODEC_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace matrix_math
+{
+	//
+	// Exceptions.
+	//
+	struct codec_error : public std::runtime_error
+	{
+		explicit codec_error(const std::string& what) : std::runtime_error(what) {}
+		virtual ~codec_error() {}
+	};
+
+	namespace detail
+	{
+		//
+		// Byte shuffling. Any bytes left over after the last whole element are copied as they are.
+		//
+		inline void shuffle_bytes(const char* in, const std::size_t bytes, const std::size_t element_size,
+			char* out) noexcept
+		{
+			const std::size_t count = bytes / element_size;
+			for (std::size_t b = 0; b < element_size; ++b)
+			{
+				const char* source = in + b;
+				char* plane = out + b * count;
+				for (std::size_t e = 0; e < count; ++e, source += element_size)
+					plane[e] = *source;
+			}
+			std::copy(in + count * element_size, in + bytes, out + count * element_size);
+		}
+
+		inline void unshuffle_bytes(const char* in, const std::size_t bytes, const std::size_t element_size,
+			char* out) noexcept
+		{
+			const std::size_t count = bytes / element_size;
+			std::size_t e = 0;
+#ifdef __SSE2__
+			// Sixteen elements at a time: the planes are interleaved by bytes, then pairs of bytes,
+			// then (for eight-byte elements) quadruples of bytes.
+			const auto load = [&](const std::size_t b)
+			{
+				return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + b * count + e));
+			};
+			const auto store = [&](const std::size_t i, const __m128i value)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + e * element_size) + i, value);
+			};
+			if (element_size == 8)
+				for ( ; e + 16 <= count; e += 16)
+				{
+					const __m128i p0 = load(0), p1 = load(1), p2 = load(2), p3 = load(3);
+					const __m128i p4 = load(4), p5 = load(5), p6 = load(6), p7 = load(7);
+					const __m128i a01l = _mm_unpacklo_epi8(p0, p1), a01h = _mm_unpackhi_epi8(p0, p1);
+					const __m128i a23l = _mm_unpacklo_epi8(p2, p3), a23h = _mm_unpackhi_epi8(p2, p3);
+					const __m128i a45l = _mm_unpacklo_epi8(p4, p5), a45h = _mm_unpackhi_epi8(p4, p5);
+					const __m128i a67l = _mm_unpacklo_epi8(p6, p7), a67h = _mm_unpackhi_epi8(p6, p7);
+					const __m128i b0 = _mm_unpacklo_epi16(a01l, a23l), b1 = _mm_unpackhi_epi16(a01l, a23l);
+					const __m128i b2 = _mm_unpacklo_epi16(a01h, a23h), b3 = _mm_unpackhi_epi16(a01h, a23h);
+					const __m128i c0 = _mm_unpacklo_epi16(a45l, a67l), c1 = _mm_unpackhi_epi16(a45l, a67l);
+					const __m128i c2 = _mm_unpacklo_epi16(a45h, a67h), c3 = _mm_unpackhi_epi16(a45h, a67h);
+					store(0, _mm_unpacklo_epi32(b0, c0));
+					store(1, _mm_unpackhi_epi32(b0, c0));
+					store(2, _mm_unpacklo_epi32(b1, c1));
+					store(3, _mm_unpackhi_epi32(b1, c1));
+					store(4, _mm_unpacklo_epi32(b2, c2));
+					store(5, _mm_unpackhi_epi32(b2, c2));
+					store(6, _mm_unpacklo_epi32(b3, c3));
+					store(7, _mm_unpackhi_epi32(b3, c3));
+				}
+			else if (element_size == 4)
+				for ( ; e + 16 <= count; e += 16)
+				{
+					const __m128i p0 = load(0), p1 = load(1), p2 = load(2), p3 = load(3);
+					const __m128i a01l = _mm_unpacklo_epi8(p0, p1), a01h = _mm_unpackhi_epi8(p0, p1);
+					const __m128i a23l = _mm_unpacklo_epi8(p2, p3), a23h = _mm_unpackhi_epi8(p2, p3);
+					store(0, _mm_unpacklo_epi16(a01l, a23l));
+					store(1, _mm_unpackhi_epi16(a01l, a23l));
+					store(2, _mm_unpacklo_epi16(a01h, a23h));
+					store(3, _mm_unpackhi_epi16(a01h, a23h));
+				}
+#endif
+			for (std::size_t b = 0; b < element_size; ++b)
+			{
+				const char* plane = in + b * count;
+				char* destination = out + e * element_size + b;
+				for (std::size_t i = e; i < count; ++i, destination += element_size)
+					*destination = plane[i];
+			}
+			std::copy(in + count * element_size, in + bytes, out + count * element_size);
+		}
+
+		//
+		// LZ77 coding, in the format described above.
+		//
+		constexpr std::size_t lz_minimum_match = 4;
+		constexpr std::size_t lz_maximum_distance = 0xffff;
+		constexpr unsigned lz_hash_bits = 16;
+
+		inline std::uint32_t load_32(const char* p) noexcept
+		{
+			std::uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		inline std::uint64_t load_64(const char* p) noexcept
+		{
+			std::uint64_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		// The most bytes that coding bytes of input can produce.
+		constexpr std::size_t lz_bound(const std::size_t bytes) noexcept
+		{
+			return bytes + bytes / 255 + 16;
+		}
+
+		inline char* lz_put_length(char* out, std::size_t length) noexcept
+		{
+			for ( ; length >= 255; length -= 255)
+				*out++ = char(255);
+			*out++ = char(length);
+			return out;
+		}
+
+		inline char* lz_put_sequence(char* out, const char* literals, const std::size_t literal_length,
+			const std::size_t distance, const std::size_t match_length) noexcept
+		{
+			const std::size_t match_code = match_length ? match_length - lz_minimum_match : 0;
+			*out++ = char((std::min<std::size_t>(literal_length, 15) << 4) | std::min<std::size_t>(match_code, 15));
+			if (literal_length >= 15)
+				out = lz_put_length(out, literal_length - 15);
+			std::memcpy(out, literals, literal_length);
+			out += literal_length;
+			if (match_length == 0)
+				return out;
+			*out++ = char(distance & 0xff);
+			*out++ = char(distance >> 8);
+			if (match_code >= 15)
+				out = lz_put_length(out, match_code - 15);
+			return out;
+		}
+
+		// Codes bytes of input into out, which must have room for lz_bound(bytes). table is
+		// working space. Returns the number of bytes written.
+		inline std::size_t lz_compress(const char* in, const std::size_t bytes, char* out,
+			std::vector<std::uint32_t>& table)
+		{
+			table.assign(std::size_t(1) << lz_hash_bits, 0);
+			const auto hash = [](const std::uint32_t sequence)
+			{
+				return (sequence * 2654435761u) >> (32 - lz_hash_bits);
+			};
+			char* const out_first = out;
+			const char* const end = in + bytes;
+			const char* anchor = in;
+			const char* ip = in;
+			while (end - ip >= std::ptrdiff_t(lz_minimum_match))
+			{
+				const std::uint32_t sequence = load_32(ip);
+				std::uint32_t& entry = table[hash(sequence)];
+				const char* candidate = in + entry;
+				entry = std::uint32_t(ip - in);
+				if (candidate >= ip || std::size_t(ip - candidate) > lz_maximum_distance || load_32(candidate) != sequence)
+				{
+					// Step faster through input that does not compress.
+					ip += std::min<std::ptrdiff_t>(1 + ((ip - anchor) >> 8), end - ip);
+					continue;
+				}
+
+				std::size_t length = lz_minimum_match;
+				while (std::size_t(end - ip) - length >= 8)
+				{
+					const std::uint64_t difference = load_64(candidate + length) ^ load_64(ip + length);
+					if (difference != 0)
+						break;
+					length += 8;
+				}
+				while (ip + length < end && candidate[length] == ip[length])
+					++length;
+				out = lz_put_sequence(out, anchor, std::size_t(ip - anchor), std::size_t(ip - candidate), length);
+				ip += length;
+				anchor = ip;
+			}
+			out = lz_put_sequence(out, anchor, std::size_t(end - anchor), 0, 0);
+			return std::size_t(out - out_first);
+		}
+
+		inline std::size_t lz_get_length(const char*& in, const char* end, std::size_t length)
+		{
+			unsigned char next;
+			do
+			{
+				if (in == end)
+					throw codec_error("Coded data is truncated.");
+				next = static_cast<unsigned char>(*in++);
+				length += next;
+			} while (next == 255);
+			return length;
+		}
+
+		// Decodes exactly bytes of output from the coded data at in. The output buffer must have
+		// room for lz_slack bytes more, which may be overwritten: short copies are made sixteen
+		// bytes at a time, whatever their length, to save working out each length.
+		constexpr std::size_t lz_slack = 32;
+
+		inline void lz_decompress(const char* in, const std::size_t coded_bytes, char* out, const std::size_t bytes)
+		{
+			const char* const in_end = in + coded_bytes;
+			char* const out_first = out;
+			char* const out_end = out + bytes;
+			for (;;)
+			{
+				if (in == in_end)
+					throw codec_error("Coded data is truncated.");
+				const unsigned token = static_cast<unsigned char>(*in++);
+				std::size_t literal_length = token >> 4;
+				if (literal_length == 15)
+					literal_length = lz_get_length(in, in_end, literal_length);
+				if (literal_length > std::size_t(in_end - in) || literal_length > std::size_t(out_end - out))
+					throw codec_error("Coded data is corrupt.");
+				if (literal_length <= 16 && in_end - in >= 16)
+					std::memcpy(out, in, 16);
+				else
+					std::memcpy(out, in, literal_length);
+				in += literal_length;
+				out += literal_length;
+				if (out == out_end)
+					break;
+
+				if (in_end - in < 2)
+					throw codec_error("Coded data is truncated.");
+				const std::size_t distance = std::size_t(static_cast<unsigned char>(in[0])) |
+					std::size_t(static_cast<unsigned char>(in[1])) << 8;
+				in += 2;
+				std::size_t length = (token & 15) + lz_minimum_match;
+				if ((token & 15) == 15)
+					length = lz_get_length(in, in_end, length);
+				if (distance == 0 || distance > std::size_t(out - out_first) || length > std::size_t(out_end - out))
+					throw codec_error("Coded data is corrupt.");
+
+				// The copy may overlap itself. From the start of the match the output repeats
+				// with period distance, so whatever has been copied so far can be copied again,
+				// doubling the step each time.
+				const char* from = out - distance;
+				if (distance >= 16)
+				{
+					for (std::size_t copied = 0; copied < length; copied += 16)
+						std::memcpy(out + copied, from + copied, 16);
+					out += length;
+					continue;
+				}
+				while (length > 0)
+				{
+					const std::size_t step = std::min(length, std::size_t(out - from));
+					std::memcpy(out, from, step);
+					out += step;
+					length -= step;
+				}
+			}
+			if (in != in_end)
+				throw codec_error("Coded data has trailing bytes.");
+		}
+
+		//
+		// Packing of planes with few distinct bytes. Each byte is replaced by its index in the
+		// dictionary, in 1, 2 or 4 bits, the first byte of each packed byte in the lowest bits.
+		//
+		inline void pack_bytes(const char* in, const std::size_t count, const unsigned char* index,
+			const unsigned bits, char* out) noexcept
+		{
+			const unsigned per_byte = 8 / bits;
+			for (std::size_t i = 0; i < count; i += per_byte)
+			{
+				unsigned packed = 0;
+				for (unsigned j = 0; j < per_byte && i + j < count; ++j)
+					packed |= unsigned(index[static_cast<unsigned char>(in[i + j])]) << (j * bits);
+				*out++ = char(packed);
+			}
+		}
+
+		template <unsigned Bits>
+		void unpack_bytes(const char* in, const std::size_t count, const unsigned char* dictionary, char* out) noexcept
+		{
+			// Every packed byte expands to the same bytes, so they are looked up whole.
+			constexpr unsigned per_byte = 8 / Bits;
+			unsigned char expansions[256][per_byte];
+			for (unsigned packed = 0; packed < 256; ++packed)
+				for (unsigned j = 0; j < per_byte; ++j)
+					expansions[packed][j] = dictionary[(packed >> (j * Bits)) & ((1u << Bits) - 1)];
+			const std::size_t whole = count / per_byte;
+			for (std::size_t i = 0; i < whole; ++i, out += per_byte)
+				std::memcpy(out, expansions[static_cast<unsigned char>(in[i])], per_byte);
+			if (count > whole * per_byte)
+				std::memcpy(out, expansions[static_cast<unsigned char>(in[whole])], count - whole * per_byte);
+		}
+
+		inline void put_32(std::vector<char>& out, const std::uint32_t value)
+		{
+			for (unsigned i = 0; i < 4; ++i)
+				out.push_back(char(value >> (8 * i)));
+		}
+		inline std::uint32_t get_32(const char* in) noexcept
+		{
+			std::uint32_t value = 0;
+			for (unsigned i = 0; i < 4; ++i)
+				value |= std::uint32_t(static_cast<unsigned char>(in[i])) << (8 * i);
+			return value;
+		}
+	} // End namespace detail.
+
+	//
+	// Shuffle, pack and LZ77 compression of arrays of elements. A codec keeps its working space,
+	// so one codec should be reused for many arrays; it must not be shared between threads.
+	//
+	class shuffle_codec
+	{
+		std::vector<char> shuffled, packed, plain_code, packed_code;
+		std::vector<std::uint32_t> table;
+
+		public:
+		// The most bytes that encoding bytes of data, of elements of element_size bytes, can
+		// produce.
+		static constexpr std::size_t bound(const std::size_t bytes, const std::size_t element_size) noexcept
+		{
+			return detail::lz_bound(bytes) + element_size * (1 + 16 + 4 + detail::lz_bound(0));
+		}
+
+		// Encodes bytes of data, made up of elements of element_size bytes, into out, replacing
+		// its contents.
+		void encode(const void* data, const std::size_t bytes, std::size_t element_size, std::vector<char>& out)
+		{
+			element_size = std::max<std::size_t>(element_size, 1);
+			const std::size_t count = bytes / element_size;
+			shuffled.resize(bytes);
+			detail::shuffle_bytes(static_cast<const char*>(data), bytes, element_size, shuffled.data());
+
+			// Matches save little in data that hardly compresses, and are slower to decode than
+			// literals, so such data is coded as literals alone.
+			const auto code_stream = [this](const char* stream, const std::size_t length, std::vector<char>& code)
+			{
+				code.resize(detail::lz_bound(length));
+				std::size_t size = detail::lz_compress(stream, length, code.data(), table);
+				if (size > length - length / 4)
+					size = std::size_t(detail::lz_put_sequence(code.data(), stream, length, 0, 0) - code.data());
+				code.resize(size);
+			};
+
+			out.clear();
+			out.reserve(bound(bytes, element_size));
+			for (std::size_t b = 0; b < element_size; ++b)
+			{
+				const char* plane = shuffled.data() + b * count;
+				code_stream(plane, count, plain_code);
+
+				// A dictionary of the bytes that occur, in order of value.
+				unsigned char index[256] = {};
+				bool seen[256] = {};
+				for (std::size_t i = 0; i < count; ++i)
+					seen[static_cast<unsigned char>(plane[i])] = true;
+				unsigned char dictionary[16] = {};
+				unsigned distinct = 0;
+				for (unsigned value = 0; value < 256 && distinct <= 16; ++value)
+					if (seen[value])
+					{
+						if (distinct < 16)
+						{
+							index[value] = static_cast<unsigned char>(distinct);
+							dictionary[distinct] = static_cast<unsigned char>(value);
+						}
+						++distinct;
+					}
+
+				unsigned bits = 0;
+				if (distinct >= 2 && distinct <= 16)
+				{
+					const unsigned candidate = distinct <= 2 ? 1 : distinct <= 4 ? 2 : 4;
+					packed.resize((count * candidate + 7) / 8);
+					detail::pack_bytes(plane, count, index, candidate, packed.data());
+					code_stream(packed.data(), packed.size(), packed_code);
+					if (packed_code.size() + (std::size_t(1) << candidate) < plain_code.size())
+						bits = candidate;
+				}
+
+				const auto& code = bits ? packed_code : plain_code;
+				out.push_back(char(bits));
+				if (bits)
+					out.insert(out.end(), dictionary, dictionary + (std::size_t(1) << bits));
+				detail::put_32(out, std::uint32_t(code.size()));
+				out.insert(out.end(), code.begin(), code.end());
+			}
+			out.insert(out.end(), shuffled.begin() + count * element_size, shuffled.end());
+		}
+
+		// Decodes coded_bytes at coded, which must decode to exactly bytes, into data.
+		void decode(const char* coded, const std::size_t coded_bytes, std::size_t element_size,
+			void* data, const std::size_t bytes)
+		{
+			element_size = std::max<std::size_t>(element_size, 1);
+			const std::size_t count = bytes / element_size;
+			const char* in = coded;
+			const char* const in_end = coded + coded_bytes;
+			const auto take = [&](const std::size_t length)
+			{
+				if (std::size_t(in_end - in) < length)
+					throw codec_error("Coded data is truncated.");
+				const char* taken = in;
+				in += length;
+				return taken;
+			};
+
+			// Each plane may write up to lz_slack bytes beyond its end, into the next, before
+			// the next is decoded.
+			shuffled.resize(bytes + detail::lz_slack);
+			for (std::size_t b = 0; b < element_size; ++b)
+			{
+				char* const plane = shuffled.data() + b * count;
+				const unsigned bits = static_cast<unsigned char>(*take(1));
+				if (bits != 0 && bits != 1 && bits != 2 && bits != 4)
+					throw codec_error("Coded data is corrupt.");
+				const unsigned char* dictionary = bits
+					? reinterpret_cast<const unsigned char*>(take(std::size_t(1) << bits)) : nullptr;
+				const std::size_t code_size = detail::get_32(take(4));
+				const char* code = take(code_size);
+				if (!bits)
+				{
+					detail::lz_decompress(code, code_size, plane, count);
+					continue;
+				}
+				const std::size_t packed_size = (count * bits + 7) / 8;
+				packed.resize(packed_size + detail::lz_slack);
+				detail::lz_decompress(code, code_size, packed.data(), packed_size);
+				if (bits == 1)
+					detail::unpack_bytes<1>(packed.data(), count, dictionary, plane);
+				else if (bits == 2)
+					detail::unpack_bytes<2>(packed.data(), count, dictionary, plane);
+				else
+					detail::unpack_bytes<4>(packed.data(), count, dictionary, plane);
+			}
+			const std::size_t leftover = bytes - count * element_size;
+			if (std::size_t(in_end - in) != leftover)
+				throw codec_error("Coded data is corrupt.");
+			std::copy_n(in, leftover, shuffled.data() + count * element_size);
+			detail::unshuffle_bytes(shuffled.data(), bytes, element_size, static_cast<char*>(data));
+		}
+	}; // End of class shuffle_codec.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_CODEC_H.
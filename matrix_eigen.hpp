@@ -0,0 +1,625 @@
+/*
+ * Matrix maths: eigenvalues and eigenvectors.
+ *
+ * Nonsymmetric square matrices are balanced, reduced to upper Hessenberg form by Householder
+ * reflections, and their eigenvalues found by Francis double-shift QR iteration. Eigenvectors
+ * are found by inverse iteration. Symmetric matrices are diagonalized by cyclic Jacobi
+ * rotations, and the generalized symmetric-definite problem A x = λ B x is reduced to that case
+ * through the Cholesky factor of B.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_EIGEN_H
+#define CROWSTON_MATRIX_EIGEN_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <stdexcept>
+
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	//
+	// Exceptions.
+	//
+	struct eigen_did_not_converge_error : public std::runtime_error
+	{
+		eigen_did_not_converge_error()
+			: std::runtime_error("Eigenvalue iteration did not converge.") {}
+		virtual ~eigen_did_not_converge_error() {}
+	};
+
+	//
+	// Results.
+	//
+	// The eigenvectors are the columns of vectors, in the same order as the values.
+	//
+	template <index_t Size, typename T = default_T>
+	struct eigen_decomposition
+	{
+		std::array<std::complex<T>, Size> values;
+		matrix<Size, Size, std::complex<T>> vectors;
+	};
+
+	template <index_t Size, typename T = default_T>
+	struct symmetric_eigen_decomposition
+	{
+		std::array<T, Size> values;
+		matrix<Size, Size, T> vectors;
+	};
+
+	namespace detail
+	{
+		using signed_index_t = std::ptrdiff_t;
+
+		// Transfers |b| with the sign of a.
+		template <typename T>
+		T with_sign(const T a, const T b) noexcept
+		{
+			return b >= T(0) ? std::abs(a) : -std::abs(a);
+		}
+
+		// Similarity scaling by powers of two so that each row and column have comparable norms.
+		// This improves the accuracy of the eigenvalues of badly scaled matrices.
+		template <index_t Size, typename T>
+		void balance(matrix<Size, Size, T>& a) noexcept
+		{
+			const T radix = 2;
+			const T radix_squared = radix * radix;
+			bool done = false;
+			while (!done)
+			{
+				done = true;
+				for (index_t i = 0; i < Size; ++i)
+				{
+					T r = 0, c = 0;
+					for (index_t j = 0; j < Size; ++j)
+						if (j != i)
+						{
+							c += std::abs(a[j][i]);
+							r += std::abs(a[i][j]);
+						}
+					if (c == T(0) || r == T(0))
+						continue;
+
+					const T sum = c + r;
+					T g = r / radix;
+					T f = 1;
+					while (c < g)
+					{
+						f *= radix;
+						c *= radix_squared;
+					}
+					g = r * radix;
+					while (c > g)
+					{
+						f /= radix;
+						c /= radix_squared;
+					}
+					if ((c + r) / f < T(0.95) * sum)
+					{
+						done = false;
+						a[i] *= T(1) / f;
+						for (index_t j = 0; j < Size; ++j)
+							a[j][i] *= f;
+					}
+				}
+			}
+		}
+
+		// Householder reduction to upper Hessenberg form, in place.
+		template <index_t Size, typename T>
+		void hessenberg_reduce(matrix<Size, Size, T>& a) noexcept
+		{
+			std::array<T, Size> ort {};
+			for (index_t m = 1; m + 1 < Size; ++m)
+			{
+				T scale = 0;
+				for (index_t i = m; i < Size; ++i)
+					scale += std::abs(a[i][m-1]);
+				if (scale == T(0))
+					continue;
+
+				// Form the Householder vector.
+				T h = 0;
+				for (index_t i = Size; i-- > m; )
+				{
+					ort[i] = a[i][m-1] / scale;
+					h += ort[i] * ort[i];
+				}
+				T g = std::sqrt(h);
+				if (ort[m] > T(0))
+					g = -g;
+				h -= ort[m] * g;
+				ort[m] -= g;
+
+				// Apply the reflection from the left, then from the right.
+				for (index_t j = m; j < Size; ++j)
+				{
+					T f = 0;
+					for (index_t i = Size; i-- > m; )
+						f += ort[i] * a[i][j];
+					f /= h;
+					for (index_t i = m; i < Size; ++i)
+						a[i][j] -= f * ort[i];
+				}
+				for (index_t i = 0; i < Size; ++i)
+				{
+					T f = 0;
+					for (index_t j = Size; j-- > m; )
+						f += ort[j] * a[i][j];
+					f /= h;
+					for (index_t j = m; j < Size; ++j)
+						a[i][j] -= f * ort[j];
+				}
+
+				a[m][m-1] = scale * g;
+				for (index_t i = m+1; i < Size; ++i)
+					a[i][m-1] = 0;
+			}
+		}
+
+		// Francis double-shift QR iteration on an upper Hessenberg matrix, which is destroyed.
+		template <index_t Size, typename T>
+		auto hessenberg_qr(matrix<Size, Size, T>& a)
+			-> std::array<std::complex<T>, Size>
+		{
+			using complex_t = std::complex<T>;
+			using sindex_t = signed_index_t;
+			const T epsilon = std::numeric_limits<T>::epsilon();
+			const unsigned max_iterations = 30;
+			std::array<complex_t, Size> values {};
+
+			T norm = 0;
+			for (index_t i = 0; i < Size; ++i)
+				for (index_t j = (i > 0 ? i-1 : 0); j < Size; ++j)
+					norm += std::abs(a[i][j]);
+
+			sindex_t nn = sindex_t(Size) - 1;
+			sindex_t l = 0;
+			T t = 0;	// Accumulated exceptional shifts.
+			while (nn >= 0)
+			{
+				unsigned iterations = 0;
+				do
+				{
+					// Look for a single small subdiagonal element.
+					for (l = nn; l > 0; --l)
+					{
+						T s = std::abs(a[l-1][l-1]) + std::abs(a[l][l]);
+						if (s == T(0))
+							s = norm;
+						if (std::abs(a[l][l-1]) <= epsilon * s)
+						{
+							a[l][l-1] = 0;
+							break;
+						}
+					}
+
+					T x = a[nn][nn];
+					if (l == nn)
+					{
+						// One root found.
+						values[nn--] = x + t;
+						continue;
+					}
+					T y = a[nn-1][nn-1];
+					T w = a[nn][nn-1] * a[nn-1][nn];
+					if (l == nn-1)
+					{
+						// Two roots found.
+						const T p = T(0.5) * (y - x);
+						const T q = p * p + w;
+						T z = std::sqrt(std::abs(q));
+						x += t;
+						if (q >= T(0))
+						{
+							z = p + with_sign(z, p);
+							values[nn-1] = values[nn] = x + z;
+							if (z != T(0))
+								values[nn] = x - w / z;
+						}
+						else
+						{
+							values[nn-1] = complex_t(x + p, z);
+							values[nn] = complex_t(x + p, -z);
+						}
+						nn -= 2;
+						continue;
+					}
+
+					// No roots found yet. Continue iteration.
+					if (iterations == max_iterations)
+						throw eigen_did_not_converge_error();
+					if (iterations == 10 || iterations == 20)
+					{
+						// Exceptional shift.
+						t += x;
+						for (sindex_t i = 0; i <= nn; ++i)
+							a[i][i] -= x;
+						const T s = std::abs(a[nn][nn-1]) + std::abs(a[nn-1][nn-2]);
+						y = x = T(0.75) * s;
+						w = T(-0.4375) * s * s;
+					}
+					++iterations;
+
+					// Form the shift and look for two consecutive small subdiagonal elements.
+					sindex_t m = nn - 2;
+					T p = 0, q = 0, r = 0, z = 0;
+					for ( ; m >= l; --m)
+					{
+						z = a[m][m];
+						r = x - z;
+						T s = y - z;
+						p = (r * s - w) / a[m+1][m] + a[m][m+1];
+						q = a[m+1][m+1] - z - r - s;
+						r = a[m+2][m+1];
+						s = std::abs(p) + std::abs(q) + std::abs(r);
+						p /= s;
+						q /= s;
+						r /= s;
+						if (m == l)
+							break;
+						const T u = std::abs(a[m][m-1]) * (std::abs(q) + std::abs(r));
+						const T v = std::abs(p) * (std::abs(a[m-1][m-1]) + std::abs(z) + std::abs(a[m+1][m+1]));
+						if (u <= epsilon * v)
+							break;
+					}
+					for (sindex_t i = m; i < nn-1; ++i)
+					{
+						a[i+2][i] = 0;
+						if (i != m)
+							a[i+2][i-1] = 0;
+					}
+
+					// Double QR step on rows l to nn and columns m to nn.
+					for (sindex_t k = m; k < nn; ++k)
+					{
+						if (k != m)
+						{
+							p = a[k][k-1];
+							q = a[k+1][k-1];
+							r = 0;
+							if (k+1 != nn)
+								r = a[k+2][k-1];
+							if ((x = std::abs(p) + std::abs(q) + std::abs(r)) != T(0))
+							{
+								p /= x;
+								q /= x;
+								r /= x;
+							}
+						}
+						const T s = with_sign(std::sqrt(p * p + q * q + r * r), p);
+						if (s == T(0))
+							continue;
+
+						if (k == m)
+						{
+							if (l != m)
+								a[k][k-1] = -a[k][k-1];
+						}
+						else
+							a[k][k-1] = -s * x;
+						p += s;
+						x = p / s;
+						y = q / s;
+						z = r / s;
+						q /= p;
+						r /= p;
+						for (sindex_t j = k; j <= nn; ++j)
+						{
+							p = a[k][j] + q * a[k+1][j];
+							if (k+1 != nn)
+							{
+								p += r * a[k+2][j];
+								a[k+2][j] -= p * z;
+							}
+							a[k+1][j] -= p * y;
+							a[k][j] -= p * x;
+						}
+						const sindex_t i_max = std::min(nn, k+3);
+						for (sindex_t i = l; i <= i_max; ++i)
+						{
+							p = x * a[i][k] + y * a[i][k+1];
+							if (k+1 != nn)
+							{
+								p += z * a[i][k+2];
+								a[i][k+2] -= p * r;
+							}
+							a[i][k+1] -= p * q;
+							a[i][k] -= p;
+						}
+					}
+				} while (l+1 < nn);
+			}
+			return values;
+		}
+
+		// Inverse iteration for the eigenvector of A belonging to (approximate) eigenvalue λ.
+		// A - λI is factorized by LU decomposition with partial pivoting; pivots that vanish
+		// because λ is exact are replaced by a small multiple of the norm of A.
+		template <index_t Size, typename T>
+		auto inverse_iteration(const matrix<Size, Size, T>& a, const std::complex<T> lambda)
+			-> std::array<std::complex<T>, Size>
+		{
+			using complex_t = std::complex<T>;
+			matrix<Size, Size, complex_t> lu;
+			T norm = 0;
+			for (index_t r = 0; r < Size; ++r)
+				for (index_t c = 0; c < Size; ++c)
+				{
+					lu[r][c] = a[r][c];
+					norm = std::max(norm, std::abs(a[r][c]));
+				}
+			for (index_t i = 0; i < Size; ++i)
+				lu[i][i] -= lambda;
+			const T tiny = std::max(norm, T(1)) * std::numeric_limits<T>::epsilon();
+
+			// Factorize.
+			std::array<index_t, Size> pivots {};
+			for (index_t c = 0; c < Size; ++c)
+			{
+				index_t pivot = c;
+				for (index_t r = c+1; r < Size; ++r)
+					if (std::abs(lu[r][c]) > std::abs(lu[pivot][c]))
+						pivot = r;
+				pivots[c] = pivot;
+				if (pivot != c)
+					lu.swap_rows(pivot, c);
+				if (std::abs(lu[c][c]) < tiny)
+					lu[c][c] = tiny;
+				for (index_t r = c+1; r < Size; ++r)
+				{
+					const complex_t factor = lu[r][c] / lu[c][c];
+					lu[r][c] = factor;
+					for (index_t k = c+1; k < Size; ++k)
+						lu[r][k] -= factor * lu[c][k];
+				}
+			}
+
+			// Two steps of iteration, from a vector of ones, suffice for a converged eigenvalue.
+			std::array<complex_t, Size> vector;
+			vector.fill(complex_t(1));
+			for (unsigned step = 0; step < 2; ++step)
+			{
+				for (index_t i = 0; i < Size; ++i)
+					std::swap(vector[i], vector[pivots[i]]);
+				for (index_t r = 1; r < Size; ++r)
+					for (index_t k = 0; k < r; ++k)
+						vector[r] -= lu[r][k] * vector[k];
+				for (index_t r = Size; r-- > 0; )
+				{
+					for (index_t k = r+1; k < Size; ++k)
+						vector[r] -= lu[r][k] * vector[k];
+					vector[r] /= lu[r][r];
+				}
+
+				T length = 0;
+				for (const auto& element : vector)
+					length += std::norm(element);
+				length = std::sqrt(length);
+				for (auto& element : vector)
+					element /= length;
+			}
+			return vector;
+		}
+
+		// Cyclic Jacobi diagonalization of a symmetric matrix, which is destroyed.
+		template <index_t Size, typename T>
+		auto jacobi(matrix<Size, Size, T>& a)
+			-> symmetric_eigen_decomposition<Size, T>
+		{
+			const unsigned max_sweeps = 50;
+			auto vectors = matrix<Size, Size, T>::get_identity_matrix();
+			std::array<T, Size> d, b, z {};
+			for (index_t i = 0; i < Size; ++i)
+				b[i] = d[i] = a[i][i];
+
+			auto rotate = [](matrix<Size, Size, T>& m, const T s, const T tau,
+				const index_t i, const index_t j, const index_t k, const index_t l) noexcept
+			{
+				const T g = m[i][j];
+				const T h = m[k][l];
+				m[i][j] = g - s * (h + g * tau);
+				m[k][l] = h + s * (g - h * tau);
+			};
+
+			for (unsigned sweep = 1; ; ++sweep)
+			{
+				T off_diagonal = 0;
+				for (index_t p = 0; p < Size; ++p)
+					for (index_t q = p+1; q < Size; ++q)
+						off_diagonal += std::abs(a[p][q]);
+				if (off_diagonal == T(0))
+					break;
+				if (sweep > max_sweeps)
+					throw eigen_did_not_converge_error();
+
+				const T threshold = sweep < 4 ? T(0.2) * off_diagonal / T(Size * Size) : T(0);
+				for (index_t p = 0; p < Size; ++p)
+					for (index_t q = p+1; q < Size; ++q)
+					{
+						const T g = 100 * std::abs(a[p][q]);
+						if (sweep > 4 && std::abs(d[p]) + g == std::abs(d[p])
+							&& std::abs(d[q]) + g == std::abs(d[q]))
+						{
+							a[p][q] = 0;
+							continue;
+						}
+						if (std::abs(a[p][q]) <= threshold)
+							continue;
+
+						T h = d[q] - d[p];
+						T t;
+						if (std::abs(h) + g == std::abs(h))
+							t = a[p][q] / h;
+						else
+						{
+							const T theta = T(0.5) * h / a[p][q];
+							t = T(1) / (std::abs(theta) + std::sqrt(T(1) + theta * theta));
+							if (theta < T(0))
+								t = -t;
+						}
+						const T c = T(1) / std::sqrt(T(1) + t * t);
+						const T s = t * c;
+						const T tau = s / (T(1) + c);
+						h = t * a[p][q];
+						z[p] -= h;
+						z[q] += h;
+						d[p] -= h;
+						d[q] += h;
+						a[p][q] = 0;
+						// Rows and columns p and q, in the upper triangle, are rotated in one pass
+						// over [0, Size).
+						for (index_t j = 0; j < Size; ++j)
+							if (j != p && j != q)
+								rotate(a, s, tau, std::min(j, p), std::max(j, p), std::min(j, q), std::max(j, q));
+						for (index_t j = 0; j < Size; ++j)
+							rotate(vectors, s, tau, j, p, j, q);
+					}
+				for (index_t p = 0; p < Size; ++p)
+				{
+					b[p] += z[p];
+					d[p] = b[p];
+					z[p] = 0;
+				}
+			}
+
+			// Sort into ascending order of eigenvalue.
+			std::array<index_t, Size> order;
+			std::iota(order.begin(), order.end(), index_t(0));
+			std::sort(order.begin(), order.end(), [&d](index_t i, index_t j) { return d[i] < d[j]; });
+			symmetric_eigen_decomposition<Size, T> result;
+			for (index_t i = 0; i < Size; ++i)
+			{
+				result.values[i] = d[order[i]];
+				for (index_t r = 0; r < Size; ++r)
+					result.vectors[r][i] = vectors[r][order[i]];
+			}
+			return result;
+		}
+	} // End namespace detail.
+
+	//
+	// Nonsymmetric matrices.
+	//
+	// Eigenvalues are returned in no particular order, except that complex conjugate pairs are
+	// adjacent.
+	//
+	template <index_t Size, typename T>
+	auto eigenvalues(const matrix<Size, Size, T>& mtx)
+		-> std::array<std::complex<T>, Size>
+	{
+		static_assert(std::is_floating_point<T>::value, "Eigenvalues require a floating point type.");
+		auto hessenberg = mtx;
+		detail::balance(hessenberg);
+		detail::hessenberg_reduce(hessenberg);
+		return detail::hessenberg_qr(hessenberg);
+	}
+
+	// Eigenvalues and unit eigenvectors. A repeated eigenvalue yields the same eigenvector for
+	// each repetition.
+	template <index_t Size, typename T>
+	auto eigen_decompose(const matrix<Size, Size, T>& mtx)
+		-> eigen_decomposition<Size, T>
+	{
+		eigen_decomposition<Size, T> result;
+		result.values = eigenvalues(mtx);
+		for (index_t i = 0; i < Size; ++i)
+		{
+			const auto vector = detail::inverse_iteration(mtx, result.values[i]);
+			for (index_t r = 0; r < Size; ++r)
+				result.vectors[r][i] = vector[r];
+		}
+		return result;
+	}
+
+	//
+	// Symmetric matrices.
+	//
+	// Eigenvalues are returned in ascending order, with orthonormal eigenvectors. Only the upper
+	// triangle of the matrix is read.
+	//
+	template <index_t Size, typename T>
+	auto symmetric_eigen_decompose(const matrix<Size, Size, T>& mtx)
+		-> symmetric_eigen_decomposition<Size, T>
+	{
+		static_assert(std::is_floating_point<T>::value, "Eigenvalues require a floating point type.");
+		auto working = mtx;
+		return detail::jacobi(working);
+	}
+
+	//
+	// The generalized symmetric-definite problem, A x = λ B x, with A symmetric and B symmetric
+	// positive definite. With B = L Lᵀ, this is the standard problem C y = λ y, for
+	// C = L⁻¹ A L⁻ᵀ, and x = L⁻ᵀ y. The eigenvectors are B-orthonormal.
+	//
+	template <index_t Size, typename T>
+	auto generalized_symmetric_eigen_decompose(const matrix<Size, Size, T>& a, const matrix<Size, Size, T>& b)
+		-> symmetric_eigen_decomposition<Size, T>
+	{
+		const auto lower = cholesky(b);
+
+		// C = L⁻¹ A L⁻ᵀ by forward substitution: first W = L⁻¹ A, then C = L⁻¹ Wᵀ.
+		auto forward_substitute = [&lower](matrix<Size, Size, T>& m) noexcept
+		{
+			for (index_t c = 0; c < Size; ++c)
+				for (index_t r = 0; r < Size; ++r)
+				{
+					T element = m[r][c];
+					for (index_t k = 0; k < r; ++k)
+						element -= lower[r][k] * m[k][c];
+					m[r][c] = element / lower[r][r];
+				}
+		};
+		auto c = a;
+		forward_substitute(c);
+		c = c.get_transpose();
+		forward_substitute(c);
+
+		auto result = detail::jacobi(c);
+
+		// x = L⁻ᵀ y by back substitution.
+		for (index_t v = 0; v < Size; ++v)
+			for (index_t r = Size; r-- > 0; )
+			{
+				T element = result.vectors[r][v];
+				for (index_t k = r+1; k < Size; ++k)
+					element -= lower[k][r] * result.vectors[k][v];
+				result.vectors[r][v] = element / lower[r][r];
+			}
+		return result;
+	}
+
+	//
+	// Batches.
+	//
+	// Each matrix in [first, last) is decomposed in turn and its result written through out.
+	// Intended for many small matrices, where the per-matrix work is best kept in one tight loop.
+	//
+	template <typename InputIt, typename OutputIt>
+	OutputIt eigenvalues(InputIt first, const InputIt last, OutputIt out)
+	{
+		for ( ; first != last; ++first, ++out)
+			*out = eigenvalues(*first);
+		return out;
+	}
+
+	template <typename InputIt, typename OutputIt>
+	OutputIt symmetric_eigen_decompose(InputIt first, const InputIt last, OutputIt out)
+	{
+		for ( ; first != last; ++first, ++out)
+			*out = symmetric_eigen_decompose(*first);
+		return out;
+	}
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_EIGEN_H.
@@ -0,0 +1,1458 @@
+/*
+ * Matrix maths: batch files and asynchronous I/O.
+ *
+ * A batch file holds a header and then count matrices of the same dimensions and element type,
+ * stored in order, each row-major and without padding. The header occupies the first
+ * batch_header_size bytes, so that the matrices begin on a page boundary and can be read and
+ * written with O_DIRECT.
+ *
+ * Reads and writes go through an io_ring: on Linux, an io_uring driven by raw system calls, so
+ * that several reads and writes can be in flight while the CPU works; elsewhere, or where the
+ * kernel refuses io_uring, each request is carried out by a blocking pread() or pwrite() as it
+ * is submitted. transform_batch_file() uses it to stream a batch file through a function a
+ * chunk at a time, reading the next chunk and writing the previous one while the function works
+ * on the current one. It can record its progress in an append-only checkpoint file, so that a run
+ * that is interrupted resumes where it left off.
+ *
+ * A batch file may instead be encoded with the shuffle_codec, in frames: each frame is a
+ * batch_frame_header, giving how many matrices it holds and how many bytes they were coded into,
+ * followed by those bytes. Frames are coded independently, so a file can be decoded as it is read.
+ *
+ * Either kind of batch file may end with an index: an entry for each chunk of consecutive
+ * matrices, saying where it is stored and giving statistics of its matrices, then a trailer that
+ * locates the entries. An indexed_batch_reader uses it to find any matrix without reading the
+ * rest of the file, and to skip the chunks whose statistics show they hold nothing of interest.
+ * Functions that do not use the index ignore it.
+ *
+ *
+ * Requires C++14 or later and POSIX. Define CROWSTON_MATRIX_IO_URING as 0 to build without
+ * io_uring.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_IO_H
+#define CROWSTON_MATRIX_IO_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef CROWSTON_MATRIX_IO_URING
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define CROWSTON_MATRIX_IO_URING 1
+#endif
+#endif
+#endif
+#ifndef CROWSTON_MATRIX_IO_URING
+#define CROWSTON_MATRIX_IO_URING 0
+#endif
+
+#if CROWSTON_MATRIX_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+#include "matrix_codec.hpp"
+#include "matrix_lu.hpp"
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	//
+	// Exceptions.
+	//
+	struct batch_file_error : public std::runtime_error
+	{
+		explicit batch_file_error(const std::string& what) : std::runtime_error(what) {}
+		virtual ~batch_file_error() {}
+	};
+
+	//
+	// Batch file format.
+	//
+	constexpr std::size_t batch_header_size = 4096;
+
+	enum class element_kind : std::uint32_t
+	{
+		signed_integer = 0,
+		unsigned_integer = 1,
+		floating_point = 2
+	};
+
+	enum class batch_encoding : std::uint32_t
+	{
+		raw = 0,
+		shuffled_lz = 1
+	};
+
+	// The number of bytes of matrices write_batch_file() codes into each frame.
+	constexpr std::size_t batch_frame_size = 256 * 1024;
+
+	struct batch_file_header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t element_size;
+		element_kind kind;
+		batch_encoding encoding;
+		std::uint64_t height;
+		std::uint64_t width;
+		std::uint64_t count;
+
+		static constexpr char expected_magic[8] = {'M', 'T', 'X', 'B', 'A', 'T', 'C', 'H'};
+		static constexpr std::uint32_t current_version = 1;
+
+		template <index_t Height, index_t Width, typename T>
+		static batch_file_header make(const std::uint64_t count,
+			const batch_encoding encoding = batch_encoding::raw) noexcept
+		{
+			batch_file_header header {};
+			std::copy_n(expected_magic, sizeof(magic), header.magic);
+			header.version = current_version;
+			header.element_size = sizeof(T);
+			header.kind = std::is_floating_point<T>::value ? element_kind::floating_point
+				: std::is_signed<T>::value ? element_kind::signed_integer : element_kind::unsigned_integer;
+			header.encoding = encoding;
+			header.height = Height;
+			header.width = Width;
+			header.count = count;
+			return header;
+		}
+
+		// Whether the file holds matrix<Height, Width, T>, in an encoding that can be read.
+		template <index_t Height, index_t Width, typename T>
+		bool holds() const noexcept
+		{
+			const auto expected = make<Height, Width, T>(count);
+			return std::equal(magic, magic + sizeof(magic), expected_magic) && version == current_version &&
+				element_size == expected.element_size && kind == expected.kind &&
+				(encoding == batch_encoding::raw || encoding == batch_encoding::shuffled_lz) &&
+				height == Height && width == Width;
+		}
+	}; // End of struct batch_file_header.
+
+	constexpr char batch_file_header::expected_magic[8];
+	constexpr std::uint32_t batch_file_header::current_version;
+
+	static_assert(sizeof(batch_file_header) <= batch_header_size, "The header must fit its space.");
+
+	struct batch_frame_header
+	{
+		std::uint32_t count;
+		std::uint32_t coded_size;
+	};
+
+	namespace detail
+	{
+		[[noreturn]] inline void throw_errno(const char* what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		// A file descriptor, closed on destruction.
+		class file_descriptor
+		{
+			int fd = -1;
+
+			public:
+			file_descriptor() noexcept = default;
+			explicit file_descriptor(const int fd) noexcept : fd(fd) { }
+			file_descriptor(file_descriptor&& other) noexcept : fd(other.fd) { other.fd = -1; }
+			file_descriptor& operator= (file_descriptor&& other) noexcept
+			{
+				std::swap(fd, other.fd);
+				return *this;
+			}
+			~file_descriptor()
+			{
+				if (fd >= 0)
+					::close(fd);
+			}
+			int get() const noexcept { return fd; }
+		};
+
+		inline file_descriptor open_file(const char* path, int flags, const bool direct)
+		{
+#ifdef O_DIRECT
+			if (direct)
+				flags |= O_DIRECT;
+#else
+			(void)direct;
+#endif
+			const int fd = ::open(path, flags | O_CLOEXEC, 0644);
+			if (fd < 0)
+				throw_errno(path);
+			return file_descriptor{fd};
+		}
+
+		// Page-aligned memory, as O_DIRECT requires.
+		struct aligned_free
+		{
+			void operator()(void* p) const noexcept { std::free(p); }
+		};
+		inline std::unique_ptr<void, aligned_free> allocate_aligned(const std::size_t bytes)
+		{
+			void* memory = nullptr;
+			if (::posix_memalign(&memory, batch_header_size, std::max<std::size_t>(bytes, 1)) != 0)
+				throw std::bad_alloc();
+			return std::unique_ptr<void, aligned_free>(memory);
+		}
+
+		// A file mapped read-only into memory, unmapped on destruction. An empty file maps to
+		// nothing.
+		class mapped_file
+		{
+			void* address = MAP_FAILED;
+			std::size_t length = 0;
+
+			public:
+			explicit mapped_file(const char* path)
+			{
+				const auto file = open_file(path, O_RDONLY, false);
+				struct stat status;
+				if (::fstat(file.get(), &status) != 0)
+					throw_errno(path);
+				length = std::size_t(status.st_size);
+				if (length == 0)
+					return;
+				address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file.get(), 0);
+				if (address == MAP_FAILED)
+					throw_errno(path);
+			}
+			mapped_file(const mapped_file&) = delete;
+			mapped_file& operator= (const mapped_file&) = delete;
+			~mapped_file()
+			{
+				if (address != MAP_FAILED)
+					::munmap(address, length);
+			}
+
+			const char* data() const noexcept { return length ? static_cast<const char*>(address) : nullptr; }
+			std::size_t size() const noexcept { return length; }
+		};
+
+		inline void read_fully(const int fd, void* buffer, const std::size_t bytes, const off_t offset)
+		{
+			std::size_t done = 0;
+			while (done < bytes)
+			{
+				const ssize_t result = ::pread(fd, static_cast<char*>(buffer) + done, bytes - done, offset + done);
+				if (result < 0 && errno == EINTR)
+					continue;
+				if (result < 0)
+					throw_errno("pread");
+				if (result == 0)
+					throw batch_file_error("Batch file is truncated.");
+				done += result;
+			}
+		}
+		inline void write_fully(const int fd, const void* buffer, const std::size_t bytes, const off_t offset)
+		{
+			std::size_t done = 0;
+			while (done < bytes)
+			{
+				const ssize_t result = ::pwrite(fd, static_cast<const char*>(buffer) + done, bytes - done, offset + done);
+				if (result < 0 && errno == EINTR)
+					continue;
+				if (result < 0)
+					throw_errno("pwrite");
+				done += result;
+			}
+		}
+	} // End namespace detail.
+
+	//
+	// Asynchronous reads and writes.
+	//
+	// Requests are identified by a caller-chosen tag, returned with their completion. A completion
+	// carries the number of bytes transferred, or minus an errno value. Reads and writes of
+	// regular files may complete short only at the end of the file.
+	//
+	class io_ring
+	{
+		public:
+		struct completion
+		{
+			std::uint64_t tag;
+			std::int64_t result;
+		};
+
+		private:
+		std::deque<completion> completed;
+		index_t in_flight = 0;
+#if CROWSTON_MATRIX_IO_URING
+		int ring_fd = -1;
+		void* rings = MAP_FAILED;
+		std::size_t rings_size = 0;
+		void* completion_rings = MAP_FAILED;
+		std::size_t completion_rings_size = 0;
+		io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		std::size_t sqes_size = 0;
+		unsigned* sq_tail = nullptr;
+		unsigned sq_mask = 0;
+		unsigned* sq_array = nullptr;
+		unsigned* cq_head = nullptr;
+		unsigned* cq_tail = nullptr;
+		unsigned cq_mask = 0;
+		io_uring_cqe* cqes = nullptr;
+
+		int enter(const unsigned submit, const unsigned wait) noexcept
+		{
+			return int(::syscall(__NR_io_uring_enter, ring_fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0u,
+				nullptr, 0));
+		}
+
+		// Moves whatever the kernel has completed onto completed.
+		void reap() noexcept
+		{
+			unsigned head = *cq_head;
+			const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+			for ( ; head != tail; ++head)
+			{
+				const auto& cqe = cqes[head & cq_mask];
+				completed.push_back(completion{cqe.user_data, cqe.res});
+			}
+			__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+		}
+
+		void submit(const std::uint8_t opcode, const int fd, const void* buffer, const std::size_t bytes,
+			const off_t offset, const std::uint64_t tag, const std::uint32_t flags = 0)
+		{
+			// Every entry is handed to the kernel as soon as it is queued, so the submission queue
+			// always has room; the completion queue is emptied first so that it too has room.
+			reap();
+			const unsigned tail = *sq_tail;
+			const unsigned index = tail & sq_mask;
+			io_uring_sqe& sqe = sqes[index];
+			std::memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = opcode;
+			sqe.fd = fd;
+			sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+			sqe.len = unsigned(bytes);
+			sqe.off = std::uint64_t(offset);
+			sqe.fsync_flags = flags;
+			sqe.user_data = tag;
+			sq_array[index] = index;
+			__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+			++in_flight;
+			int result;
+			while ((result = enter(1, 0)) < 0 && errno == EINTR)
+				;
+			if (result < 0)
+				detail::throw_errno("io_uring_enter");
+		}
+
+		void wait_one()
+		{
+			reap();
+			while (completed.empty())
+			{
+				if (enter(0, 1) < 0 && errno != EINTR)
+					detail::throw_errno("io_uring_enter");
+				reap();
+			}
+		}
+
+		void release() noexcept
+		{
+			if (sqes != MAP_FAILED)
+				::munmap(sqes, sqes_size);
+			if (completion_rings != MAP_FAILED)
+				::munmap(completion_rings, completion_rings_size);
+			if (rings != MAP_FAILED)
+				::munmap(rings, rings_size);
+			if (ring_fd >= 0)
+				::close(ring_fd);
+			ring_fd = -1;
+		}
+
+		// Sets up the ring, returning false (and leaving the fallback in use) if the kernel
+		// will not provide one.
+		bool set_up(const unsigned depth) noexcept
+		{
+			io_uring_params params;
+			std::memset(&params, 0, sizeof(params));
+			ring_fd = int(::syscall(__NR_io_uring_setup, depth, &params));
+			if (ring_fd < 0)
+				return false;
+
+			rings_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			completion_rings_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			const bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+			if (single_map)
+				rings_size = completion_rings_size = std::max(rings_size, completion_rings_size);
+			rings = ::mmap(nullptr, rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ring_fd, IORING_OFF_SQ_RING);
+			if (rings == MAP_FAILED)
+			{
+				release();
+				return false;
+			}
+			if (!single_map)
+			{
+				completion_rings = ::mmap(nullptr, completion_rings_size, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+				if (completion_rings == MAP_FAILED)
+				{
+					release();
+					return false;
+				}
+			}
+			sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+			sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+			if (sqes == MAP_FAILED)
+			{
+				release();
+				return false;
+			}
+
+			char* sq = static_cast<char*>(rings);
+			char* cq = single_map ? sq : static_cast<char*>(completion_rings);
+			sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+			return true;
+		}
+#endif
+
+		// The fallback: the transfer happens now, and its completion is queued.
+		void transfer_now(const bool write, const int fd, void* buffer, const std::size_t bytes,
+			const off_t offset, const std::uint64_t tag) noexcept
+		{
+			std::size_t done = 0;
+			std::int64_t result = 0;
+			while (done < bytes)
+			{
+				const ssize_t step = write
+					? ::pwrite(fd, static_cast<const char*>(buffer) + done, bytes - done, offset + done)
+					: ::pread(fd, static_cast<char*>(buffer) + done, bytes - done, offset + done);
+				if (step < 0 && errno == EINTR)
+					continue;
+				if (step <= 0)
+				{
+					result = step < 0 ? -errno : 0;
+					break;
+				}
+				done += step;
+			}
+			completed.push_back(completion{tag, result < 0 ? result : std::int64_t(done)});
+			++in_flight;
+		}
+
+		public:
+		// The largest read or write that may be requested. The kernel transfers less than 2 GiB
+		// at a time, and a request's length is 32 bits.
+		static constexpr std::size_t max_transfer = std::size_t(1) << 30;
+
+		// A ring with room for depth requests in flight. If asynchronous is false, or io_uring is
+		// unavailable, requests are carried out as they are submitted.
+		explicit io_ring(const unsigned depth = 8, const bool asynchronous = true)
+		{
+#if CROWSTON_MATRIX_IO_URING
+			if (asynchronous)
+				set_up(std::max(depth, 1u));
+#else
+			(void)depth; (void)asynchronous;
+#endif
+		}
+		io_ring(const io_ring&) = delete;
+		io_ring& operator= (const io_ring&) = delete;
+		~io_ring()
+		{
+#if CROWSTON_MATRIX_IO_URING
+			// The kernel may still be writing into buffers that are about to be freed.
+			while (in_flight > 0 && ring_fd >= 0)
+			{
+				try { wait(); } catch (...) { break; }
+			}
+			release();
+#endif
+		}
+
+		// Whether requests are carried out asynchronously.
+		bool asynchronous() const noexcept
+		{
+#if CROWSTON_MATRIX_IO_URING
+			return ring_fd >= 0;
+#else
+			return false;
+#endif
+		}
+
+		// The number of requests submitted whose completions have not been collected by wait().
+		index_t pending() const noexcept { return in_flight; }
+
+		// Requests, of at most max_transfer bytes. The buffer must remain valid until the
+		// completion has been collected.
+		void read(const int fd, void* buffer, const std::size_t bytes, const off_t offset, const std::uint64_t tag)
+		{
+			if (bytes > max_transfer)
+				throw std::length_error("Transfer too large for io_ring.");
+#if CROWSTON_MATRIX_IO_URING
+			if (ring_fd >= 0)
+				return submit(IORING_OP_READ, fd, buffer, bytes, offset, tag);
+#endif
+			transfer_now(false, fd, buffer, bytes, offset, tag);
+		}
+		void write(const int fd, const void* buffer, const std::size_t bytes, const off_t offset, const std::uint64_t tag)
+		{
+			if (bytes > max_transfer)
+				throw std::length_error("Transfer too large for io_ring.");
+#if CROWSTON_MATRIX_IO_URING
+			if (ring_fd >= 0)
+				return submit(IORING_OP_WRITE, fd, buffer, bytes, offset, tag);
+#endif
+			transfer_now(true, fd, const_cast<void*>(buffer), bytes, offset, tag);
+		}
+
+		// Flushes the data of fd to storage, as fdatasync() does: everything written before the
+		// request was made, and perhaps some written since.
+		void flush(const int fd, const std::uint64_t tag)
+		{
+#if CROWSTON_MATRIX_IO_URING
+			if (ring_fd >= 0)
+				return submit(IORING_OP_FSYNC, fd, nullptr, 0, 0, tag, IORING_FSYNC_DATASYNC);
+#endif
+			completed.push_back(completion{tag, ::fdatasync(fd) == 0 ? 0 : -std::int64_t(errno)});
+			++in_flight;
+		}
+
+		// Waits for the next completion. There must be a request pending.
+		completion wait()
+		{
+#if CROWSTON_MATRIX_IO_URING
+			if (ring_fd >= 0 && completed.empty())
+				wait_one();
+#endif
+			const completion next = completed.front();
+			completed.pop_front();
+			--in_flight;
+			return next;
+		}
+	}; // End of class io_ring.
+
+	namespace detail
+	{
+		// Codes count matrices as one frame, written at offset, which is advanced past it.
+		template <index_t Height, index_t Width, typename T>
+		void write_frame(const int fd, const matrix<Height, Width, T>* first, const index_t count, off_t& offset,
+			shuffle_codec& codec, std::vector<char>& coded)
+		{
+			codec.encode(first, count * sizeof(*first), sizeof(T), coded);
+			if (count > 0xffffffff || coded.size() > 0xffffffff)
+				throw batch_file_error("Too many matrices for one frame.");
+			const batch_frame_header frame{std::uint32_t(count), std::uint32_t(coded.size())};
+			write_fully(fd, &frame, sizeof(frame), offset);
+			write_fully(fd, coded.data(), coded.size(), offset + off_t(sizeof(frame)));
+			offset += off_t(sizeof(frame) + coded.size());
+		}
+
+		// Reads the frame at offset, which is advanced past it, leaving its coded bytes in coded.
+		// The frame must hold at least one matrix and no more than room.
+		inline batch_frame_header read_frame(const int fd, off_t& offset, const index_t room, std::vector<char>& coded)
+		{
+			batch_frame_header frame;
+			read_fully(fd, &frame, sizeof(frame), offset);
+			if (frame.count == 0 || frame.count > room)
+				throw batch_file_error("Batch file frame is corrupt.");
+			coded.resize(frame.coded_size);
+			read_fully(fd, coded.data(), coded.size(), offset + off_t(sizeof(frame)));
+			offset += off_t(sizeof(frame) + coded.size());
+			return frame;
+		}
+	} // End namespace detail.
+
+	//
+	// Whole batch files.
+	//
+	template <index_t Height, index_t Width, typename T>
+	void write_batch_file(const char* path, const matrix<Height, Width, T>* first, const index_t count,
+		const batch_encoding encoding = batch_encoding::raw)
+	{
+		static_assert(sizeof(matrix<Height, Width, T>) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+		const auto file = detail::open_file(path, O_WRONLY | O_CREAT | O_TRUNC, false);
+		char header[batch_header_size] = {};
+		const auto fields = batch_file_header::make<Height, Width, T>(count, encoding);
+		std::memcpy(header, &fields, sizeof(fields));
+		detail::write_fully(file.get(), header, sizeof(header), 0);
+		if (encoding == batch_encoding::raw)
+			return detail::write_fully(file.get(), first, count * sizeof(*first), batch_header_size);
+
+		const index_t frame_count = std::max<index_t>(batch_frame_size / sizeof(*first), 1);
+		shuffle_codec codec;
+		std::vector<char> coded;
+		off_t offset = batch_header_size;
+		for (index_t done = 0; done < count; done += frame_count)
+			detail::write_frame(file.get(), first + done, std::min(frame_count, count - done), offset, codec, coded);
+	}
+
+	inline batch_file_header read_batch_file_header(const char* path)
+	{
+		const auto file = detail::open_file(path, O_RDONLY, false);
+		batch_file_header header;
+		detail::read_fully(file.get(), &header, sizeof(header), 0);
+		return header;
+	}
+
+	template <index_t Height, index_t Width, typename T>
+	auto read_batch_file(const char* path)
+		-> std::vector<matrix<Height, Width, T>>
+	{
+		const auto file = detail::open_file(path, O_RDONLY, false);
+		batch_file_header header;
+		detail::read_fully(file.get(), &header, sizeof(header), 0);
+		if (!header.holds<Height, Width, T>())
+			throw batch_file_error("Batch file does not hold matrices of this type.");
+		std::vector<matrix<Height, Width, T>> batch(header.count);
+		if (header.encoding == batch_encoding::raw)
+		{
+			detail::read_fully(file.get(), batch.data(), batch.size() * sizeof(batch[0]), batch_header_size);
+			return batch;
+		}
+
+		shuffle_codec codec;
+		std::vector<char> coded;
+		off_t offset = batch_header_size;
+		for (index_t done = 0; done < batch.size(); )
+		{
+			const auto frame = detail::read_frame(file.get(), offset, batch.size() - done, coded);
+			codec.decode(coded.data(), coded.size(), sizeof(T), &batch[done], frame.count * sizeof(batch[0]));
+			done += frame.count;
+		}
+		return batch;
+	}
+
+	//
+	// Checkpoints.
+	//
+	// A transform_batch_file() run given a batch_checkpoint appends a checkpoint of its progress
+	// to the checkpoint file every few chunks, and a later run given the same file resumes from
+	// the last checkpoint rather than from the start. A checkpoint is appended only once the output
+	// it covers has been flushed to storage, so everything it records is durable; one torn by a
+	// crash fails its check, and the run resumes from the one before. The file begins with the
+	// identity of the run, and a file left by a run of another input, or with another chunk size
+	// or output encoding, is started afresh.
+	//
+	struct batch_checkpoint_identity
+	{
+		char magic[8];
+		batch_file_header input;
+		std::uint64_t input_size;
+		// Nanoseconds since the epoch.
+		std::int64_t input_modified;
+		std::uint64_t chunk_size;
+		batch_encoding output_encoding;
+		std::uint32_t reserved;
+
+		static constexpr char expected_magic[8] = {'M', 'T', 'X', 'C', 'K', 'P', 'T', '1'};
+	};
+
+	constexpr char batch_checkpoint_identity::expected_magic[8];
+
+	// Each checkpoint is a record followed by saved_size bytes saved by the owner of the run.
+	struct batch_checkpoint_record
+	{
+		// Matrices transformed and written.
+		std::uint64_t done;
+		std::uint64_t input_offset;
+		std::uint64_t output_offset;
+		std::uint64_t value;
+		std::uint64_t saved_size;
+		// Of the fields above and the saved bytes.
+		std::uint64_t check;
+	};
+
+	namespace detail
+	{
+		// FNV-1a.
+		inline std::uint64_t checksum(const void* data, const std::size_t length,
+			std::uint64_t hash = 14695981039346656037ull) noexcept
+		{
+			const auto bytes = static_cast<const unsigned char*>(data);
+			for (std::size_t i = 0; i < length; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		inline std::uint64_t record_check(const batch_checkpoint_record& record, const char* saved) noexcept
+		{
+			return checksum(saved, record.saved_size, checksum(&record, offsetof(batch_checkpoint_record, check)));
+		}
+
+		inline off_t file_size(const int fd)
+		{
+			struct stat status;
+			if (::fstat(fd, &status) != 0)
+				throw_errno("fstat");
+			return status.st_size;
+		}
+	} // End namespace detail.
+
+	class batch_checkpoint
+	{
+		std::string path;
+		detail::file_descriptor file;
+		off_t end = 0;
+		index_t resumed_count = 0;
+		index_t chunk_matrices = 0;
+		std::uint64_t sealed_value = 0;
+		std::vector<char> restored, pending, sealed;
+
+		public:
+		// Checkpoints are kept in the file at path, which is created if need be.
+		explicit batch_checkpoint(std::string path) : path(std::move(path)) { }
+
+		// A value of the owner's choosing, such as a count of results so far: saved with each
+		// checkpoint, and restored from the last one when a run resumes.
+		std::uint64_t value = 0;
+
+		// Bytes to save with the next checkpoint.
+		void save(const void* data, const std::size_t bytes)
+		{
+			const char* const first = static_cast<const char*>(data);
+			pending.insert(pending.end(), first, first + bytes);
+		}
+
+		// Once a run has begun: the number of matrices done by the runs before it, which it
+		// skips; everything that they saved, in order; and the chunk size of the runs.
+		index_t resumed() const noexcept { return resumed_count; }
+		const std::vector<char>& restored_bytes() const noexcept { return restored; }
+		index_t chunk_size() const noexcept { return chunk_matrices; }
+
+		// Begins a run of the given identity, whose output is output_size bytes long. Returns the
+		// last intact checkpoint of an earlier run of that identity whose output is all present,
+		// and discards any after it; otherwise starts the file afresh and returns a record of no
+		// progress. Used by transform_batch_file().
+		batch_checkpoint_record begin(const batch_checkpoint_identity& identity, const off_t output_size)
+		{
+			file = detail::open_file(path.c_str(), O_RDWR | O_CREAT, false);
+			std::vector<char> contents(std::size_t(detail::file_size(file.get())));
+			if (!contents.empty())
+				detail::read_fully(file.get(), contents.data(), contents.size(), 0);
+
+			batch_checkpoint_record last {};
+			last.input_offset = last.output_offset = batch_header_size;
+			restored.clear();
+			pending.clear();
+			sealed.clear();
+			chunk_matrices = identity.chunk_size;
+			if (contents.size() >= sizeof(identity) && std::memcmp(contents.data(), &identity, sizeof(identity)) == 0)
+			{
+				std::size_t offset = sizeof(identity);
+				batch_checkpoint_record record;
+				while (contents.size() - offset >= sizeof(record))
+				{
+					std::memcpy(&record, &contents[offset], sizeof(record));
+					const char* const saved = &contents[offset + sizeof(record)];
+					if (record.saved_size > contents.size() - offset - sizeof(record) ||
+						record.check != detail::record_check(record, saved) ||
+						record.done < last.done || record.done > identity.input.count ||
+						record.output_offset > std::uint64_t(output_size))
+						break;
+					restored.insert(restored.end(), saved, saved + record.saved_size);
+					last = record;
+					offset += sizeof(record) + record.saved_size;
+				}
+				end = off_t(offset);
+			}
+			else
+			{
+				detail::write_fully(file.get(), &identity, sizeof(identity), 0);
+				end = off_t(sizeof(identity));
+			}
+			if (::ftruncate(file.get(), end) != 0)
+				detail::throw_errno("ftruncate");
+			resumed_count = last.done;
+			value = last.value;
+			return last;
+		}
+
+		// Sets the value and the bytes saved so far aside for the next checkpoint, once the
+		// matrices it covers have been transformed, so that what is saved afterwards goes to the
+		// checkpoint after. Used by transform_batch_file().
+		void seal()
+		{
+			sealed_value = value;
+			sealed.insert(sealed.end(), pending.begin(), pending.end());
+			pending.clear();
+		}
+
+		// Appends the sealed checkpoint: done matrices, read up to input_offset, have been written
+		// up to output_offset, all of it already flushed to storage. The checkpoint file itself is
+		// not flushed: losing a checkpoint only means resuming from an earlier one. Used by
+		// transform_batch_file().
+		void commit(const index_t done, const off_t input_offset, const off_t output_offset)
+		{
+			batch_checkpoint_record record {done, std::uint64_t(input_offset), std::uint64_t(output_offset), sealed_value,
+				sealed.size(), 0};
+			record.check = detail::record_check(record, sealed.data());
+			sealed.insert(sealed.begin(), reinterpret_cast<const char*>(&record),
+				reinterpret_cast<const char*>(&record) + sizeof(record));
+			detail::write_fully(file.get(), sealed.data(), sealed.size(), end);
+			end += off_t(sealed.size());
+			sealed.clear();
+		}
+	}; // End of class batch_checkpoint.
+
+	namespace detail
+	{
+		inline batch_checkpoint_identity checkpoint_identity(const int input, const batch_file_header& header,
+			const index_t chunk_size, const batch_encoding output_encoding)
+		{
+			struct stat status;
+			if (::fstat(input, &status) != 0)
+				throw_errno("fstat");
+			batch_checkpoint_identity identity {};
+			std::copy_n(batch_checkpoint_identity::expected_magic, sizeof(identity.magic), identity.magic);
+			identity.input = header;
+			identity.input_size = std::uint64_t(status.st_size);
+			identity.input_modified = std::int64_t(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+			identity.chunk_size = chunk_size;
+			identity.output_encoding = output_encoding;
+			return identity;
+		}
+
+		// Flushes the output written so far to storage.
+		inline void flush(const int fd)
+		{
+			if (::fdatasync(fd) != 0)
+				throw_errno("fdatasync");
+		}
+	} // End namespace detail.
+
+	//
+	// Streaming through batch files.
+	//
+	struct batch_io_options
+	{
+		// Matrices per chunk. With direct I/O this is rounded up to a whole number of pages.
+		index_t chunk_size = 4096;
+		// Open the files with O_DIRECT, bypassing the page cache, where available.
+		bool direct = false;
+		// Use io_uring where available.
+		bool asynchronous = true;
+		// How to store the output. Coded input or output is read and written with ordinary
+		// blocking I/O, a frame at a time, whatever direct and asynchronous are.
+		batch_encoding encoding = batch_encoding::raw;
+		// Where to record progress, if anywhere, and how many chunks (or frames of coded input)
+		// to transform between checkpoints. Each checkpoint waits for the output so far to be
+		// flushed to storage, so the interval should cover some tens of megabytes.
+		batch_checkpoint* checkpoint = nullptr;
+		index_t checkpoint_interval = 64;
+	};
+
+	namespace detail
+	{
+		// transform_batch_file(), when either file is coded.
+		template <index_t Height, index_t Width, typename T, typename Function>
+		index_t transform_coded_batch_file(const char* input, const char* output, const batch_file_header& header,
+			Function fn, const batch_io_options& options)
+		{
+			using matrix_t = matrix<Height, Width, T>;
+			const index_t count = header.count;
+			batch_checkpoint* const checkpoint = options.checkpoint;
+			const auto in = open_file(input, O_RDONLY, false);
+			const auto out = open_file(output, O_WRONLY | O_CREAT | (checkpoint ? 0 : O_TRUNC), false);
+
+			// Raw input is read a chunk at a time, and coded input a frame at a time.
+			const index_t chunk_size = std::max<index_t>(options.chunk_size, 1);
+			batch_checkpoint_record resumed {};
+			resumed.input_offset = resumed.output_offset = batch_header_size;
+			if (checkpoint)
+			{
+				resumed = checkpoint->begin(checkpoint_identity(in.get(), header, chunk_size, options.encoding),
+					file_size(out.get()));
+				// The output of a finished run is left as it is, with anything added since.
+				if (resumed.done == count)
+					return count;
+				if (::ftruncate(out.get(), off_t(resumed.output_offset)) != 0)
+					throw_errno("ftruncate");
+			}
+			char header_buffer[batch_header_size] = {};
+			const auto fields = batch_file_header::make<Height, Width, T>(count, options.encoding);
+			std::memcpy(header_buffer, &fields, sizeof(fields));
+			write_fully(out.get(), header_buffer, sizeof(header_buffer), 0);
+
+			shuffle_codec codec;
+			std::vector<char> coded;
+			std::vector<matrix_t> chunk;
+			off_t in_offset = off_t(resumed.input_offset), out_offset = off_t(resumed.output_offset);
+			const index_t interval = std::max<index_t>(options.checkpoint_interval, 1);
+			for (index_t done = resumed.done, transformed = 0; done < count; )
+			{
+				if (header.encoding == batch_encoding::raw)
+				{
+					chunk.resize(std::min(chunk_size, count - done));
+					read_fully(in.get(), chunk.data(), chunk.size() * sizeof(matrix_t), in_offset);
+					in_offset += off_t(chunk.size() * sizeof(matrix_t));
+				}
+				else
+				{
+					const auto frame = read_frame(in.get(), in_offset, count - done, coded);
+					chunk.resize(frame.count);
+					codec.decode(coded.data(), coded.size(), sizeof(T), chunk.data(), chunk.size() * sizeof(matrix_t));
+				}
+
+				fn(chunk.data(), chunk.data() + chunk.size());
+
+				if (options.encoding == batch_encoding::raw)
+				{
+					write_fully(out.get(), chunk.data(), chunk.size() * sizeof(matrix_t), out_offset);
+					out_offset += off_t(chunk.size() * sizeof(matrix_t));
+				}
+				else
+					write_frame(out.get(), chunk.data(), chunk.size(), out_offset, codec, coded);
+				done += chunk.size();
+
+				if (checkpoint && (++transformed % interval == 0 || done == count))
+				{
+					checkpoint->seal();
+					flush(out.get());
+					checkpoint->commit(done, in_offset, out_offset);
+				}
+			}
+			return count;
+		}
+	} // End namespace detail.
+
+	// Reads the batch file at input a chunk at a time into memory, calls fn(first, last) on each
+	// chunk of matrices to transform them in place, and writes the results to a batch file at
+	// output. Three chunk buffers rotate: while fn works on one, the next chunk is being read
+	// into another and the previous one written from the third. Returns the number of matrices.
+	template <index_t Height, index_t Width, typename T, typename Function>
+	index_t transform_batch_file(const char* input, const char* output, Function fn,
+		const batch_io_options& options = {})
+	{
+		using matrix_t = matrix<Height, Width, T>;
+		static_assert(sizeof(matrix_t) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+		static_assert(std::is_trivially_copyable<matrix_t>::value, "Matrices are read as bytes.");
+		constexpr index_t buffer_count = 3;
+
+		const batch_file_header header = read_batch_file_header(input);
+		if (!header.holds<Height, Width, T>())
+			throw batch_file_error("Batch file does not hold matrices of this type.");
+		if (header.encoding != batch_encoding::raw || options.encoding != batch_encoding::raw)
+			return detail::transform_coded_batch_file<Height, Width, T>(input, output, header, fn, options);
+		const index_t count = header.count;
+
+		batch_checkpoint* const checkpoint = options.checkpoint;
+		const auto in = detail::open_file(input, O_RDONLY, options.direct);
+		auto header_buffer = detail::allocate_aligned(batch_header_size);
+		detail::read_fully(in.get(), header_buffer.get(), batch_header_size, 0);
+
+		const auto out = detail::open_file(output, O_WRONLY | O_CREAT | (checkpoint ? 0 : O_TRUNC), options.direct);
+
+		// Chunks are no larger than the batch, and each is read and written in one request to
+		// the ring. With direct I/O every transfer is whole pages, so chunks are too; only the
+		// last chunk may be partly filled, and the output is truncated to length at the end.
+		index_t chunk_size = std::max<index_t>(
+			std::min<index_t>({options.chunk_size, count, io_ring::max_transfer / sizeof(matrix_t)}), 1);
+		if (options.direct)
+		{
+			index_t granularity = 1;
+			while (granularity * sizeof(matrix_t) % batch_header_size != 0)
+				++granularity;
+			chunk_size = (chunk_size + granularity - 1) / granularity * granularity;
+		}
+		const std::size_t chunk_bytes = chunk_size * sizeof(matrix_t);
+		const index_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+		// A resumed run starts from the chunk after the last one checkpointed. The output of a
+		// finished run is left as it is, with anything added since, such as an index.
+		index_t first_chunk = 0;
+		if (checkpoint)
+		{
+			const auto resumed = checkpoint->begin(
+				detail::checkpoint_identity(in.get(), header, chunk_size, options.encoding), detail::file_size(out.get()));
+			if (resumed.done == count)
+				return count;
+			first_chunk = resumed.done / chunk_size;
+			if (::ftruncate(out.get(), off_t(batch_header_size + resumed.done * sizeof(matrix_t))) != 0)
+				detail::throw_errno("ftruncate");
+		}
+		detail::write_fully(out.get(), header_buffer.get(), batch_header_size, 0);
+		const auto chunk_length = [&](const index_t chunk)
+		{
+			return std::min(chunk_size, count - chunk * chunk_size);
+		};
+		const auto transfer_bytes = [&](const index_t chunk)
+		{
+			const std::size_t bytes = chunk_length(chunk) * sizeof(matrix_t);
+			return options.direct ? (bytes + batch_header_size - 1) / batch_header_size * batch_header_size : bytes;
+		};
+
+		std::unique_ptr<void, detail::aligned_free> buffers[buffer_count];
+		for (auto& buffer : buffers)
+			buffer = detail::allocate_aligned(chunk_bytes);
+		const auto chunk_data = [&](const index_t chunk)
+		{
+			return static_cast<matrix_t*>(buffers[chunk % buffer_count].get());
+		};
+
+		// Completion tags: the chunk, with the top bit set for writes, and the next bit for the
+		// flushes that precede checkpoints. A checkpoint is committed when its flush completes.
+		constexpr std::uint64_t write_tag = std::uint64_t(1) << 63;
+		constexpr std::uint64_t flush_tag = std::uint64_t(1) << 62;
+		std::vector<bool> read_done(chunk_count), write_done(chunk_count);
+		bool flushing = false;
+		io_ring ring(2 * buffer_count + 1, options.asynchronous);
+		const auto collect = [&]
+		{
+			const auto done = ring.wait();
+			const index_t chunk = index_t(done.tag & ~(write_tag | flush_tag));
+			if (done.result < 0)
+				throw std::system_error(int(-done.result), std::generic_category(),
+					(done.tag & flush_tag) ? "batch flush" : (done.tag & write_tag) ? "batch write" : "batch read");
+			if (done.tag & flush_tag)
+			{
+				const index_t matrices = std::min(count, (chunk + 1) * chunk_size);
+				const off_t end = off_t(batch_header_size + matrices * sizeof(matrix_t));
+				checkpoint->commit(matrices, end, end);
+				flushing = false;
+				return;
+			}
+			if (std::size_t(done.result) < chunk_length(chunk) * sizeof(matrix_t))
+				throw batch_file_error((done.tag & write_tag) ? "Short write to batch file." : "Batch file is truncated.");
+			((done.tag & write_tag) ? write_done : read_done)[chunk] = true;
+		};
+		const auto start_read = [&](const index_t chunk)
+		{
+			ring.read(in.get(), chunk_data(chunk), transfer_bytes(chunk),
+				off_t(batch_header_size + chunk * chunk_bytes), chunk);
+		};
+
+		// A checkpoint's flush is requested once every chunk it covers has been written, and
+		// proceeds while later chunks are transformed. Only one flush is in flight at a time.
+		const index_t interval = std::max<index_t>(options.checkpoint_interval, 1);
+		index_t written = first_chunk;
+		const auto make_checkpoint = [&](const index_t chunk)
+		{
+			while (flushing)
+				collect();
+			checkpoint->seal();
+			for ( ; written <= chunk; ++written)
+				while (!write_done[written])
+					collect();
+			ring.flush(out.get(), chunk | flush_tag);
+			flushing = true;
+		};
+
+		for (index_t chunk = first_chunk; chunk < std::min<index_t>(chunk_count, first_chunk + buffer_count - 1); ++chunk)
+			start_read(chunk);
+		for (index_t chunk = first_chunk; chunk < chunk_count; ++chunk)
+		{
+			while (!read_done[chunk])
+				collect();
+			matrix_t* const first = chunk_data(chunk);
+			fn(first, first + chunk_length(chunk));
+			ring.write(out.get(), first, transfer_bytes(chunk),
+				off_t(batch_header_size + chunk * chunk_bytes), chunk | write_tag);
+			if (checkpoint && ((chunk + 1 - first_chunk) % interval == 0 || chunk + 1 == chunk_count))
+				make_checkpoint(chunk);
+
+			// The buffer for the chunk after next is the one the previous chunk was written from.
+			const index_t ahead = chunk + buffer_count - 1;
+			if (ahead < chunk_count)
+			{
+				while (chunk > first_chunk && !write_done[chunk - 1])
+					collect();
+				start_read(ahead);
+			}
+		}
+		while (ring.pending() > 0)
+			collect();
+
+		if (options.direct && ::ftruncate(out.get(), off_t(batch_header_size + count * sizeof(matrix_t))) != 0)
+			detail::throw_errno("ftruncate");
+		return count;
+	}
+
+	// Inverts every matrix of a batch file, writing the inverses (and the degenerate matrices,
+	// unchanged) to another. If status is given, whether each matrix was inverted is appended
+	// to it. Returns the number of matrices inverted.
+	//
+	// With a checkpoint, the count of matrices inverted is its value, and the index of each
+	// degenerate matrix is saved with it, so that a resumed run returns the count and status of
+	// the whole batch.
+	template <index_t Size, typename T = default_T>
+	index_t invert_batch_file(const char* input, const char* output, std::vector<bool>* status = nullptr,
+		const batch_io_options& options = {})
+	{
+		batch_checkpoint* const checkpoint = options.checkpoint;
+		std::uint64_t inverted = 0;
+		std::uint64_t& total = checkpoint ? checkpoint->value : inverted;
+		const std::size_t status_start = status ? status->size() : 0;
+		std::uint64_t position = 0;
+		bool started = false;
+		std::vector<bool> chunk_status;
+		transform_batch_file<Size, Size, T>(input, output,
+			[&](matrix<Size, Size, T>* first, matrix<Size, Size, T>* last)
+			{
+				if (checkpoint && !started)
+					position = checkpoint->resumed();
+				started = true;
+				chunk_status.resize(last - first);
+				total += invert_batch(first, last, chunk_status.begin());
+				if (status)
+					status->insert(status->end(), chunk_status.begin(), chunk_status.end());
+				for (index_t i = 0; checkpoint && i < chunk_status.size(); ++i, ++position)
+					if (!chunk_status[i])
+						checkpoint->save(&position, sizeof(position));
+			}, options);
+
+		if (checkpoint && status)
+		{
+			std::vector<bool> resumed(checkpoint->resumed(), true);
+			const auto& degenerate = checkpoint->restored_bytes();
+			for (std::size_t i = 0; i + sizeof(position) <= degenerate.size(); i += sizeof(position))
+			{
+				std::memcpy(&position, &degenerate[i], sizeof(position));
+				if (position < resumed.size())
+					resumed[position] = false;
+			}
+			status->insert(status->begin() + status_start, resumed.begin(), resumed.end());
+		}
+		return index_t(total);
+	}
+
+	//
+	// Indexed batch files.
+	//
+	// Chunks of raw files hold chunk_size matrices each, but the last; chunks of coded files are
+	// their frames, which must hold the same number each, but the last.
+	//
+	struct batch_chunk_statistics
+	{
+		// The smallest and largest elements.
+		double min;
+		double max;
+		// The smallest and largest Frobenius norms of the matrices.
+		double min_norm;
+		double max_norm;
+		// The number of matrices that are square and cannot be inverted.
+		std::uint64_t singular_count;
+	};
+
+	struct batch_chunk_entry
+	{
+		std::uint64_t first;
+		std::uint64_t count;
+		std::uint64_t offset;
+		std::uint64_t stored_size;
+		batch_chunk_statistics statistics;
+	};
+
+	struct batch_index_trailer
+	{
+		std::uint64_t chunk_count;
+		std::uint64_t chunk_size;
+		std::uint64_t index_offset;
+		char magic[8];
+
+		static constexpr char expected_magic[8] = {'M', 'T', 'X', 'B', 'I', 'D', 'X', '1'};
+	};
+
+	constexpr char batch_index_trailer::expected_magic[8];
+
+	namespace detail
+	{
+		// Whether elimination with partial pivoting, as in try_invert(), finds a column without an
+		// acceptable pivot. Only a copy is factorized, at a third of the cost of inverting it.
+		template <index_t Size, typename T>
+		bool is_singular(const matrix<Size, Size, T>& mtx, std::true_type) noexcept
+		{
+			auto copy = mtx;
+			row_permutation<Size> permutation;
+			return !try_lu_blocked(copy, permutation, 1);
+		}
+		template <index_t Height, index_t Width, typename T>
+		bool is_singular(const matrix<Height, Width, T>&, std::false_type) noexcept
+		{
+			return false;
+		}
+
+		template <index_t Height, index_t Width, typename T>
+		batch_chunk_statistics chunk_statistics(const matrix<Height, Width, T>* first, const index_t count) noexcept
+		{
+			using square = std::integral_constant<bool, Height == Width && std::is_floating_point<T>::value>;
+			batch_chunk_statistics statistics{std::numeric_limits<double>::infinity(),
+				-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(), 0, 0};
+			for (const auto* mtx = first; mtx != first + count; ++mtx)
+			{
+				double sum_of_squares = 0;
+				for (const auto& row : *mtx)
+					for (const auto element : row)
+					{
+						const double value = double(element);
+						statistics.min = std::min(statistics.min, value);
+						statistics.max = std::max(statistics.max, value);
+						sum_of_squares += value * value;
+					}
+				const double norm = std::sqrt(sum_of_squares);
+				statistics.min_norm = std::min(statistics.min_norm, norm);
+				statistics.max_norm = std::max(statistics.max_norm, norm);
+				statistics.singular_count += is_singular(*mtx, square{});
+			}
+			return statistics;
+		}
+
+		// Writes the index entries and trailer at offset, and ends the file there.
+		inline void write_batch_index(const int fd, const off_t offset, const std::vector<batch_chunk_entry>& entries,
+			const index_t chunk_size)
+		{
+			batch_index_trailer trailer{entries.size(), chunk_size, std::uint64_t(offset), {}};
+			std::copy_n(batch_index_trailer::expected_magic, sizeof(trailer.magic), trailer.magic);
+			write_fully(fd, entries.data(), entries.size() * sizeof(batch_chunk_entry), offset);
+			const off_t end = offset + off_t(entries.size() * sizeof(batch_chunk_entry));
+			write_fully(fd, &trailer, sizeof(trailer), end);
+			if (::ftruncate(fd, end + off_t(sizeof(trailer))) != 0)
+				throw_errno("ftruncate");
+		}
+	} // End namespace detail.
+
+	// Writes a batch file with an index of chunks of chunk_size matrices (by default, as many as
+	// fit in batch_frame_size bytes). Coded files have one frame per chunk.
+	template <index_t Height, index_t Width, typename T>
+	void write_indexed_batch_file(const char* path, const matrix<Height, Width, T>* first, const index_t count,
+		const batch_encoding encoding = batch_encoding::raw, index_t chunk_size = 0)
+	{
+		using matrix_t = matrix<Height, Width, T>;
+		static_assert(sizeof(matrix_t) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+		if (chunk_size == 0)
+			chunk_size = std::max<index_t>(batch_frame_size / sizeof(matrix_t), 1);
+		const auto file = detail::open_file(path, O_WRONLY | O_CREAT | O_TRUNC, false);
+		char header[batch_header_size] = {};
+		const auto fields = batch_file_header::make<Height, Width, T>(count, encoding);
+		std::memcpy(header, &fields, sizeof(fields));
+		detail::write_fully(file.get(), header, sizeof(header), 0);
+
+		std::vector<batch_chunk_entry> entries;
+		shuffle_codec codec;
+		std::vector<char> coded;
+		off_t offset = batch_header_size;
+		for (index_t done = 0; done < count; done += chunk_size)
+		{
+			const index_t length = std::min(chunk_size, count - done);
+			batch_chunk_entry entry{done, length, std::uint64_t(offset), 0,
+				detail::chunk_statistics(first + done, length)};
+			if (encoding == batch_encoding::raw)
+			{
+				detail::write_fully(file.get(), first + done, length * sizeof(matrix_t), offset);
+				offset += off_t(length * sizeof(matrix_t));
+			}
+			else
+				detail::write_frame(file.get(), first + done, length, offset, codec, coded);
+			entry.stored_size = std::uint64_t(offset) - entry.offset;
+			entries.push_back(entry);
+		}
+		detail::write_batch_index(file.get(), offset, entries, chunk_size);
+	}
+
+	// Adds an index to an existing batch file, or replaces the one it has. Raw files are indexed
+	// in chunks of chunk_size matrices (by default, as many as fit in batch_frame_size bytes), and
+	// coded files by frame.
+	template <index_t Height, index_t Width, typename T>
+	void index_batch_file(const char* path, index_t chunk_size = 0)
+	{
+		using matrix_t = matrix<Height, Width, T>;
+		const batch_file_header header = read_batch_file_header(path);
+		if (!header.holds<Height, Width, T>())
+			throw batch_file_error("Batch file does not hold matrices of this type.");
+		const index_t count = header.count;
+		const auto file = detail::open_file(path, O_RDWR, false);
+		std::vector<batch_chunk_entry> entries;
+		off_t offset = batch_header_size;
+
+		if (header.encoding == batch_encoding::raw)
+		{
+			if (chunk_size == 0)
+				chunk_size = std::max<index_t>(batch_frame_size / sizeof(matrix_t), 1);
+			std::vector<matrix_t> chunk;
+			for (index_t done = 0; done < count; done += chunk_size)
+			{
+				chunk.resize(std::min(chunk_size, count - done));
+				const std::size_t bytes = chunk.size() * sizeof(matrix_t);
+				detail::read_fully(file.get(), chunk.data(), bytes, offset);
+				entries.push_back(batch_chunk_entry{done, chunk.size(), std::uint64_t(offset), bytes,
+					detail::chunk_statistics(chunk.data(), chunk.size())});
+				offset += off_t(bytes);
+			}
+		}
+		else
+		{
+			shuffle_codec codec;
+			std::vector<char> coded;
+			std::vector<matrix_t> chunk;
+			chunk_size = 0;
+			for (index_t done = 0; done < count; )
+			{
+				const off_t frame_offset = offset;
+				const auto frame = detail::read_frame(file.get(), offset, count - done, coded);
+				if (chunk_size == 0)
+					chunk_size = frame.count;
+				else if (entries.back().count != chunk_size)
+					throw batch_file_error("Only the last frame of an indexed batch file may be short.");
+				chunk.resize(frame.count);
+				codec.decode(coded.data(), coded.size(), sizeof(T), chunk.data(), chunk.size() * sizeof(matrix_t));
+				entries.push_back(batch_chunk_entry{done, frame.count, std::uint64_t(frame_offset),
+					std::uint64_t(offset - frame_offset), detail::chunk_statistics(chunk.data(), chunk.size())});
+				done += frame.count;
+			}
+			if (entries.size() > 1 && entries.back().count > chunk_size)
+				throw batch_file_error("Only the last frame of an indexed batch file may be short.");
+		}
+		detail::write_batch_index(file.get(), offset, entries, std::max<index_t>(chunk_size, 1));
+	}
+
+	//
+	// Reads an indexed batch file, which it maps into memory. The matrices of raw files are viewed
+	// in place. Those of coded files are decoded a chunk at a time into a buffer, which the views
+	// of the last chunk decoded refer to, so that views of a coded file last only until another
+	// chunk is decoded, and a reader of a coded file must not be shared between threads.
+	//
+	template <index_t Height, index_t Width, typename T = default_T>
+	class indexed_batch_reader
+	{
+		using matrix_t = matrix<Height, Width, T>;
+		static_assert(sizeof(matrix_t) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+
+		std::unique_ptr<const detail::mapped_file> file;
+		batch_file_header header;
+		std::vector<batch_chunk_entry> entries;
+		index_t chunk_matrices = 1;
+		mutable shuffle_codec codec;
+		mutable std::vector<matrix_t> decoded;
+		mutable index_t decoded_chunk = std::numeric_limits<index_t>::max();
+
+		public:
+		explicit indexed_batch_reader(const char* path)
+			: file(new detail::mapped_file(path))
+		{
+			const char* const first = file->data();
+			const std::size_t size = file->size();
+			if (size < batch_header_size)
+				throw batch_file_error("Batch file is truncated.");
+			std::memcpy(&header, first, sizeof(header));
+			if (!header.holds<Height, Width, T>())
+				throw batch_file_error("Batch file does not hold matrices of this type.");
+
+			batch_index_trailer trailer;
+			if (size < batch_header_size + sizeof(trailer))
+				throw batch_file_error("Batch file has no index.");
+			std::memcpy(&trailer, first + size - sizeof(trailer), sizeof(trailer));
+			if (!std::equal(trailer.magic, trailer.magic + sizeof(trailer.magic), batch_index_trailer::expected_magic))
+				throw batch_file_error("Batch file has no index.");
+			if (trailer.index_offset < batch_header_size || trailer.chunk_size == 0 ||
+				trailer.chunk_count != (size - sizeof(trailer) - trailer.index_offset) / sizeof(batch_chunk_entry))
+				throw batch_file_error("Batch file index is corrupt.");
+			entries.resize(trailer.chunk_count);
+			std::memcpy(entries.data(), first + trailer.index_offset, entries.size() * sizeof(batch_chunk_entry));
+			chunk_matrices = trailer.chunk_size;
+
+			// Every chunk must be where the chunk size puts it, and lie before the index.
+			std::uint64_t expected_first = 0;
+			for (const auto& entry : entries)
+			{
+				const bool raw = header.encoding == batch_encoding::raw;
+				if (entry.first != expected_first || entry.count == 0 || entry.count > chunk_matrices ||
+					(entry.count < chunk_matrices && &entry != &entries.back()) ||
+					entry.offset < batch_header_size || entry.offset > trailer.index_offset ||
+					entry.stored_size > trailer.index_offset - entry.offset ||
+					(raw && (entry.stored_size != entry.count * sizeof(matrix_t) ||
+						entry.offset != batch_header_size + entry.first * sizeof(matrix_t))))
+					throw batch_file_error("Batch file index is corrupt.");
+				expected_first += entry.count;
+			}
+			if (expected_first != header.count)
+				throw batch_file_error("Batch file index is corrupt.");
+		}
+
+		// Accessors.
+		index_t size() const noexcept { return header.count; }
+		batch_encoding encoding() const noexcept { return header.encoding; }
+		index_t chunk_size() const noexcept { return chunk_matrices; }
+		index_t chunk_count() const noexcept { return entries.size(); }
+		const batch_chunk_entry& chunk(const index_t c) const { return entries.at(c); }
+		index_t chunk_of(const index_t i) const noexcept { return i / chunk_matrices; }
+
+		// The matrices of chunk c.
+		auto get_chunk(const index_t c) const
+			-> const_batch_view<Height, Width, T>
+		{
+			const auto& entry = entries.at(c);
+			const char* const stored = file->data() + entry.offset;
+			if (header.encoding == batch_encoding::raw)
+				return {reinterpret_cast<const T*>(stored), entry.count};
+			if (decoded_chunk != c)
+			{
+				batch_frame_header frame;
+				if (entry.stored_size < sizeof(frame))
+					throw batch_file_error("Batch file frame is corrupt.");
+				std::memcpy(&frame, stored, sizeof(frame));
+				if (frame.count != entry.count || frame.coded_size != entry.stored_size - sizeof(frame))
+					throw batch_file_error("Batch file frame is corrupt.");
+				decoded_chunk = std::numeric_limits<index_t>::max();
+				decoded.resize(entry.count);
+				codec.decode(stored + sizeof(frame), frame.coded_size, sizeof(T), decoded.data(),
+					decoded.size() * sizeof(matrix_t));
+				decoded_chunk = c;
+			}
+			return {decoded.data(), entry.count};
+		}
+
+		// Matrix i, found through the index.
+		auto operator[] (const index_t i) const
+			-> const_matrix_view<Height, Width, T>
+		{
+			if (i >= size())
+				throw std::out_of_range("No such matrix in the batch file.");
+			return get_chunk(i / chunk_matrices)[i % chunk_matrices];
+		}
+
+		// Calls fn(first, chunk) for each chunk whose statistics satisfy predicate, where first
+		// is the index of the chunk's first matrix. Other chunks are neither read nor decoded.
+		// Returns the number of chunks visited.
+		template <typename Predicate, typename Function>
+		index_t for_each_chunk(Predicate predicate, Function fn) const
+		{
+			index_t visited = 0;
+			for (index_t c = 0; c < entries.size(); ++c)
+				if (predicate(static_cast<const batch_chunk_statistics&>(entries[c].statistics)))
+				{
+					fn(index_t(entries[c].first), get_chunk(c));
+					++visited;
+				}
+			return visited;
+		}
+	}; // End of class indexed_batch_reader.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_IO_H.
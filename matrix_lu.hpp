@@ -0,0 +1,279 @@
+/*
+ * Matrix maths: blocked LU factorization.
+ *
+ * Two right-looking blocked factorizations P A = L U of a square matrix, in place: the standard
+ * one, whose panels are factorized by Gaussian elimination with partial pivoting, and
+ * communication-avoiding LU (CALU), whose panels choose their pivot rows by a tournament. In the
+ * tournament the rows of the panel are divided into blocks, each block nominates its best rows
+ * independently (in parallel), and the nominees play off in pairs, level by level, until one set
+ * of pivot rows remains. The panel is then factorized without further pivoting, row by row in
+ * parallel, where partial pivoting must search the whole column at every step.
+ *
+ * Pivots follow the semantics of row_reduce(): a pivot no larger than equality_tolerance in
+ * magnitude means the matrix is degenerate.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_LU_H
+#define CROWSTON_MATRIX_LU_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	// Row i of P A is row permutation[i] of A.
+	template <index_t Size>
+	using row_permutation = std::array<index_t, Size>;
+
+	namespace detail
+	{
+		// Gaussian elimination with partial pivoting on a copy of columns [col, col+width) of the
+		// given rows of a. Returns the rows chosen as pivots, in order: at most width of them.
+		// Columns with no non-zero candidate still nominate a row, so that the tournament always
+		// produces a full set; the factorization that follows finds them degenerate.
+		template <index_t Size, typename T>
+		std::vector<index_t> nominate_pivot_rows(const matrix<Size, Size, T>& a, std::vector<index_t> rows,
+			const index_t col, const index_t width)
+		{
+			const index_t count = rows.size();
+			std::vector<T> block(count * width);
+			for (index_t i = 0; i < count; ++i)
+				std::copy_n(a[rows[i]].begin() + col, width, block.begin() + i * width);
+
+			const index_t steps = std::min(count, width);
+			for (index_t j = 0; j < steps; ++j)
+			{
+				index_t p = j;
+				for (index_t i = j+1; i < count; ++i)
+					if (std::abs(block[i * width + j]) > std::abs(block[p * width + j]))
+						p = i;
+				if (p != j)
+				{
+					std::swap_ranges(block.begin() + p * width, block.begin() + (p+1) * width,
+						block.begin() + j * width);
+					std::swap(rows[p], rows[j]);
+				}
+				const T pivot = block[j * width + j];
+				if (pivot == T(0))
+					continue;
+				for (index_t i = j+1; i < count; ++i)
+				{
+					const T factor = block[i * width + j] / pivot;
+					for (index_t k = j+1; k < width; ++k)
+						block[i * width + k] = matrix_math::multiply_add(-factor, block[j * width + k], block[i * width + k]);
+				}
+			}
+			rows.resize(steps);
+			return rows;
+		}
+
+		// Swaps rows a and b of the matrix and of the permutation.
+		template <index_t Size, typename T>
+		void interchange(matrix<Size, Size, T>& mtx, row_permutation<Size>& permutation,
+			const index_t a, const index_t b) noexcept
+		{
+			if (a == b)
+				return;
+			mtx.swap_rows(a, b);
+			std::swap(permutation[a], permutation[b]);
+		}
+
+		// With the panel of columns [col, col+width) factorized: U12 = L11⁻¹ A12 for the rows of
+		// the panel, then A22 -= L21 U12 for the rows below it, the latter in parallel.
+		template <index_t Size, typename T>
+		void update_trailing_matrix(matrix<Size, Size, T>& a, const index_t col, const index_t width,
+			const unsigned thread_count)
+		{
+			const index_t end = col + width;
+			if (end == Size)
+				return;
+			for (index_t k = col; k < end; ++k)
+				for (index_t i = k+1; i < end; ++i)
+					if (a[i][k] != T(0))
+						a[i].add_scaled(a[k], -a[i][k], end);
+
+			parallel_for(Size - end, thread_count, [&](const index_t offset)
+			{
+				auto& target = a[end + offset];
+				for (index_t k = col; k < end; ++k)
+					if (target[k] != T(0))
+						target.add_scaled(a[k], -target[k], end);
+			});
+		}
+	} // End namespace detail.
+
+	//
+	// Standard right-looking blocked LU.
+	//
+	// Factorizes a in place into unit lower triangular L (below the diagonal) and upper triangular
+	// U, returning false (with a partly factorized) if a is degenerate. The trailing update is
+	// shared among thread_count threads; the panels are factorized serially.
+	//
+	template <index_t BlockSize = 64, index_t Size, typename T>
+	bool try_lu_blocked(matrix<Size, Size, T>& a, row_permutation<Size>& permutation,
+		const unsigned thread_count = std::thread::hardware_concurrency())
+	{
+		std::iota(permutation.begin(), permutation.end(), index_t(0));
+		for (index_t col = 0; col < Size; col += BlockSize)
+		{
+			const index_t width = std::min(BlockSize, Size - col);
+			for (index_t j = col; j < col + width; ++j)
+			{
+				index_t p = j;
+				for (index_t i = j+1; i < Size; ++i)
+					if (std::abs(a[i][j]) > std::abs(a[p][j]))
+						p = i;
+				if (std::abs(a[p][j]) <= equality_tolerance)
+					return false;
+				detail::interchange(a, permutation, j, p);
+
+				const T reciprocal = T(1) / a[j][j];
+				for (index_t i = j+1; i < Size; ++i)
+				{
+					const T factor = a[i][j] *= reciprocal;
+					if (factor != T(0))
+						for (index_t k = j+1; k < col + width; ++k)
+							a[i][k] = multiply_add(-factor, a[j][k], a[i][k]);
+				}
+			}
+			detail::update_trailing_matrix(a, col, width, thread_count);
+		}
+		return true;
+	}
+
+	template <index_t BlockSize = 64, index_t Size, typename T>
+	void lu_blocked(matrix<Size, Size, T>& a, row_permutation<Size>& permutation,
+		const unsigned thread_count = std::thread::hardware_concurrency())
+	{
+		if (!try_lu_blocked<BlockSize>(a, permutation, thread_count))
+			throw matrix_is_degenerate_error();
+	}
+
+	//
+	// Communication-avoiding LU with tournament pivoting.
+	//
+	// As try_lu_blocked(), but each panel is divided into up to thread_count blocks of at least
+	// BlockSize rows for the tournament, and is factorized in parallel. The pivots are not those
+	// of partial pivoting, but are as stable in practice.
+	//
+	template <index_t BlockSize = 64, index_t Size, typename T>
+	bool try_calu(matrix<Size, Size, T>& a, row_permutation<Size>& permutation,
+		const unsigned thread_count = std::thread::hardware_concurrency())
+	{
+		std::iota(permutation.begin(), permutation.end(), index_t(0));
+		for (index_t col = 0; col < Size; col += BlockSize)
+		{
+			const index_t width = std::min(BlockSize, Size - col);
+			const index_t end = col + width;
+			const index_t panel_rows = Size - col;
+
+			// The tournament: nominations from each block of rows, then pairwise play-offs.
+			const index_t block_count = std::max<index_t>(1,
+				std::min<index_t>(std::max(thread_count, 1u), panel_rows / width));
+			std::vector<std::vector<index_t>> nominees(block_count);
+			detail::parallel_for(block_count, thread_count, [&](const index_t b)
+			{
+				std::vector<index_t> rows(panel_rows * (b+1) / block_count - panel_rows * b / block_count);
+				std::iota(rows.begin(), rows.end(), col + panel_rows * b / block_count);
+				nominees[b] = detail::nominate_pivot_rows(a, std::move(rows), col, width);
+			});
+			while (nominees.size() > 1)
+			{
+				std::vector<std::vector<index_t>> winners((nominees.size() + 1) / 2);
+				detail::parallel_for(nominees.size() / 2, thread_count, [&](const index_t n)
+				{
+					std::vector<index_t> rows = nominees[2*n];
+					rows.insert(rows.end(), nominees[2*n+1].begin(), nominees[2*n+1].end());
+					winners[n] = detail::nominate_pivot_rows(a, std::move(rows), col, width);
+				});
+				if (nominees.size() % 2 == 1)
+					winners.back() = std::move(nominees.back());
+				nominees = std::move(winners);
+			}
+
+			// Move the winners to the top of the panel, in order. A row displaced from the top may
+			// itself be a later winner.
+			auto& pivots = nominees.front();
+			for (index_t k = 0; k < width; ++k)
+			{
+				const index_t source = pivots[k];
+				detail::interchange(a, permutation, col + k, source);
+				for (index_t m = k+1; m < width; ++m)
+					if (pivots[m] == col + k)
+						pivots[m] = source;
+			}
+
+			// Factorize the panel without pivoting: first its top square, then every row below
+			// independently, as L21 = A21 U11⁻¹.
+			for (index_t j = col; j < end; ++j)
+			{
+				if (std::abs(a[j][j]) <= equality_tolerance)
+					return false;
+				for (index_t i = j+1; i < end; ++i)
+				{
+					const T factor = a[i][j] /= a[j][j];
+					for (index_t k = j+1; k < end; ++k)
+						a[i][k] = multiply_add(-factor, a[j][k], a[i][k]);
+				}
+			}
+			detail::parallel_for(Size - end, thread_count, [&](const index_t offset)
+			{
+				auto& target = a[end + offset];
+				for (index_t j = col; j < end; ++j)
+				{
+					const T factor = target[j] /= a[j][j];
+					if (factor != T(0))
+						for (index_t k = j+1; k < end; ++k)
+							target[k] = multiply_add(-factor, a[j][k], target[k]);
+				}
+			});
+
+			detail::update_trailing_matrix(a, col, width, thread_count);
+		}
+		return true;
+	}
+
+	template <index_t BlockSize = 64, index_t Size, typename T>
+	void calu(matrix<Size, Size, T>& a, row_permutation<Size>& permutation,
+		const unsigned thread_count = std::thread::hardware_concurrency())
+	{
+		if (!try_calu<BlockSize>(a, permutation, thread_count))
+			throw matrix_is_degenerate_error();
+	}
+
+	// Solves A X = B in place, given the factorization of A by either of the above.
+	template <index_t Size, index_t Width, typename T>
+	void lu_solve(const matrix<Size, Size, T>& lu, const row_permutation<Size>& permutation,
+		matrix<Size, Width, T>& b)
+	{
+		auto x = std::make_unique<matrix<Size, Width, T>>();
+		for (index_t i = 0; i < Size; ++i)
+			(*x)[i] = b[permutation[i]];
+		for (index_t i = 0; i < Size; ++i)
+			for (index_t k = 0; k < i; ++k)
+				if (lu[i][k] != T(0))
+					(*x)[i].add_scaled((*x)[k], -lu[i][k]);
+		for (index_t i = Size; i-- > 0; )
+		{
+			for (index_t k = i+1; k < Size; ++k)
+				if (lu[i][k] != T(0))
+					(*x)[i].add_scaled((*x)[k], -lu[i][k]);
+			(*x)[i] *= T(1) / lu[i][i];
+		}
+		b = *x;
+	}
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_LU_H.
@@ -11,15 +11,26 @@
 #ifndef CROWSTON_MATRIX_MATH_H
 #define CROWSTON_MATRIX_MATH_H
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <initializer_list>
+#include <iterator>
+#include <memory>
 #include <ostream>
 #include <numeric>
+#include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace matrix_math
 {
@@ -31,6 +42,219 @@ namespace matrix_math
 	// This is a fudge factor for floating point types..
 	const default_T equality_tolerance{0.00000000001};
 
+	//
+	// Fused multiply-add.
+	//
+	// Define CROWSTON_MATRIX_MATH_USE_FMA as 1 to evaluate the multiply-add kernels (dot products,
+	// row updates) through std::fma, with a single rounding per step, whether or not the compiler
+	// is permitted to contract a*b+c itself. Build with -mfma (or similar) so that std::fma is a 
+	// single instruction rather than a library call.
+	//
+#ifndef CROWSTON_MATRIX_MATH_USE_FMA
+#define CROWSTON_MATRIX_MATH_USE_FMA 0
+#endif
+	constexpr bool use_fma = CROWSTON_MATRIX_MATH_USE_FMA;
+
+	//
+	// Inversion.
+	//
+	// invert_blocked() inverts square matrices larger than CROWSTON_MATRIX_MATH_INVERSION_LEAF_SIZE
+	// by recursive 2x2 block inversion, so that most of the work is done by matrix multiplication.
+	// Blocks at or below the leaf size are inverted directly by Gauss--Jordan elimination.
+	//
+#ifndef CROWSTON_MATRIX_MATH_INVERSION_LEAF_SIZE
+#define CROWSTON_MATRIX_MATH_INVERSION_LEAF_SIZE 32
+#endif
+	constexpr index_t inversion_leaf_size = CROWSTON_MATRIX_MATH_INVERSION_LEAF_SIZE;
+
+	//
+	// Multiplication kernels, selected from the dimensions of the operands.
+	//
+	// A product with a small inner dimension (such as tall-skinny by small square), or with few 
+	// rows on the left (short-wide), is accumulated row by row from the rows of the rhs, which is
+	// then read in its natural order and never transposed. A product with an inner dimension of
+	// one is an outer product. Other products take inner products over the packed columns of
+	// the rhs.
+	//
+	constexpr index_t small_product_dimension = 8;
+	// Depth of the panels of the rhs over which gemm() accumulates, so that each panel stays in
+	// cache while it is applied to every row of the output.
+	constexpr index_t gemm_panel_depth = 64;
+
+	//
+	// Streaming stores.
+	//
+	// Large outputs that will not be read again soon (concatenations, slices, transposes, bulk
+	// copies) can be written into existing storage with non-temporal stores, which bypass the
+	// cache rather than evict whatever else is in it. By default this is done for outputs of at
+	// least CROWSTON_MATRIX_MATH_STREAMING_THRESHOLD bytes, about half of a typical last level
+	// cache; smaller outputs are likely to be read again while still cached, and are better
+	// stored normally. Non-temporal stores need SSE2; elsewhere every store is an ordinary one.
+	//
+#ifndef CROWSTON_MATRIX_MATH_STREAMING_THRESHOLD
+#define CROWSTON_MATRIX_MATH_STREAMING_THRESHOLD (std::size_t(4) << 20)
+#endif
+	constexpr std::size_t streaming_threshold = CROWSTON_MATRIX_MATH_STREAMING_THRESHOLD;
+	// Batch operations prefetch each matrix while working on the one before, if it is no larger
+	// than this. The hardware prefetcher finds the rows of larger matrices by itself.
+	constexpr std::size_t batch_prefetch_limit = 16384;
+
+	enum class store_policy
+	{
+		automatic,
+		cached,
+		streaming
+	};
+
+	namespace detail
+	{
+		constexpr bool streams(const store_policy policy, const std::size_t bytes) noexcept
+		{
+			return policy == store_policy::streaming || 
+				(policy == store_policy::automatic && bytes >= streaming_threshold);
+		}
+
+		// Copies and fills with non-temporal stores where the type allows, and ordinary ones
+		// otherwise. Follow with stream_fence() before the data is shared with another thread.
+		template <typename T>
+		void stream_copy(const T* source, const index_t count, T* destination) noexcept
+		{
+			std::copy_n(source, count, destination);
+		}
+		template <typename T>
+		void stream_fill(T* destination, const index_t count, const T value) noexcept
+		{
+			std::fill_n(destination, count, value);
+		}
+		inline void stream_fence() noexcept
+		{
+#ifdef __SSE2__
+			_mm_sfence();
+#endif
+		}
+#ifdef __SSE2__
+		inline void stream_copy(const double* source, index_t count, double* destination) noexcept
+		{
+			if (count != 0 && reinterpret_cast<std::uintptr_t>(destination) % 16 != 0)
+			{
+				*destination++ = *source++;
+				--count;
+			}
+			for ( ; count >= 2; count -= 2, source += 2, destination += 2)
+				_mm_stream_pd(destination, _mm_loadu_pd(source));
+			if (count != 0)
+				*destination = *source;
+		}
+		inline void stream_fill(double* destination, index_t count, const double value) noexcept
+		{
+			if (count != 0 && reinterpret_cast<std::uintptr_t>(destination) % 16 != 0)
+			{
+				*destination++ = value;
+				--count;
+			}
+			const __m128d pair = _mm_set1_pd(value);
+			for ( ; count >= 2; count -= 2, destination += 2)
+				_mm_stream_pd(destination, pair);
+			if (count != 0)
+				*destination = value;
+		}
+		inline void stream_copy(const float* source, index_t count, float* destination) noexcept
+		{
+			for ( ; count != 0 && reinterpret_cast<std::uintptr_t>(destination) % 16 != 0; --count)
+				*destination++ = *source++;
+			for ( ; count >= 4; count -= 4, source += 4, destination += 4)
+				_mm_stream_ps(destination, _mm_loadu_ps(source));
+			for ( ; count != 0; --count)
+				*destination++ = *source++;
+		}
+		inline void stream_fill(float* destination, index_t count, const float value) noexcept
+		{
+			for ( ; count != 0 && reinterpret_cast<std::uintptr_t>(destination) % 16 != 0; --count)
+				*destination++ = value;
+			const __m128 quad = _mm_set1_ps(value);
+			for ( ; count >= 4; count -= 4, destination += 4)
+				_mm_stream_ps(destination, quad);
+			for ( ; count != 0; --count)
+				*destination++ = value;
+		}
+#endif
+
+		// Copies with non-temporal stores if streaming, and ordinary ones otherwise.
+		template <typename T>
+		void copy_elements(const T* source, const index_t count, T* destination, const bool streaming) noexcept
+		{
+			if (streaming)
+				stream_copy(source, count, destination);
+			else
+				std::copy_n(source, count, destination);
+		}
+
+		// Prefetches the cache lines of an object that is about to be read, or written if write.
+		inline void prefetch(const void* address, const std::size_t bytes, const bool write) noexcept
+		{
+#if defined(__GNUC__)
+			const char* line = static_cast<const char*>(address);
+			for (std::size_t offset = 0; offset < bytes; offset += 64)
+				if (write)
+					__builtin_prefetch(line + offset, 1);
+				else
+					__builtin_prefetch(line + offset, 0);
+#else
+			(void)address; (void)bytes; (void)write;
+#endif
+		}
+
+		// Calls fn(i) for i in [0, count), across up to thread_count threads.
+		template <typename Function>
+		void parallel_for(const index_t count, const unsigned thread_count, const Function& fn)
+		{
+			const unsigned threads = unsigned(std::min<index_t>(std::max(thread_count, 1u), count));
+			if (threads <= 1)
+			{
+				for (index_t i = 0; i < count; ++i)
+					fn(i);
+				return;
+			}
+			std::vector<std::thread> pool;
+			for (unsigned t = 0; t < threads; ++t)
+				pool.emplace_back([&fn, count, threads, t]
+				{
+					for (index_t i = t; i < count; i += threads)
+						fn(i);
+				});
+			for (auto& thread : pool)
+				thread.join();
+		}
+
+		struct outer_product_kernel {};
+		struct row_accumulation_kernel {};
+		struct packed_inner_product_kernel {};
+
+		template <index_t Height, index_t InnerSize>
+		using product_kernel_t = std::conditional_t<InnerSize == 1, outer_product_kernel,
+			std::conditional_t<(InnerSize <= small_product_dimension || Height <= small_product_dimension),
+				row_accumulation_kernel, packed_inner_product_kernel>>;
+
+		template <typename T>
+		constexpr T multiply_add(const T a, const T b, const T c, std::true_type) noexcept
+		{
+			return std::fma(a, b, c);
+		}
+		template <typename T>
+		constexpr T multiply_add(const T a, const T b, const T c, std::false_type) noexcept
+		{
+			return a * b + c;
+		}
+	} // End namespace detail.
+
+	// Computes a*b + c. Fused only for floating point types.
+	template <bool Fused = use_fma, typename T>
+	constexpr T multiply_add(const T a, const T b, const T c) noexcept
+	{
+		return detail::multiply_add(a, b, c, 
+			std::integral_constant<bool, Fused && std::is_floating_point<T>::value>{});
+	}
+
 	//
 	// Exceptions.
 	//
@@ -39,6 +263,12 @@ namespace matrix_math
 		matrix_is_degenerate_error() : std::domain_error("Cannot invert degenerate matrix.") {}
 		virtual ~matrix_is_degenerate_error() {}
 	};
+	struct matrix_not_positive_definite_error : public std::domain_error
+	{
+		matrix_not_positive_definite_error() 
+			: std::domain_error("Matrix is not symmetric positive definite.") {}
+		virtual ~matrix_not_positive_definite_error() {}
+	};
 
 	//
 	// In this system, matrices comprise rows. Access column-by-column is also supported by a
@@ -65,11 +295,17 @@ namespace matrix_math
         
 		// Accessors.
         constexpr T& operator[] (const index_t x) noexcept { return storage[x]; }
-        constexpr const T operator[] (const index_t x) const noexcept { return storage[x]; }
+        constexpr const T& operator[] (const index_t x) const noexcept { return storage[x]; }
+		constexpr T* data() noexcept { return storage.data(); }
+		constexpr const T* data() const noexcept { return storage.data(); }
 
 		// Iteration (through underlying storage type).
 		constexpr auto begin() noexcept { return storage.begin(); }
 		constexpr auto end() noexcept { return storage.end(); }
+		constexpr auto begin() const noexcept { return storage.begin(); }
+		constexpr auto end() const noexcept { return storage.end(); }
+		constexpr auto cbegin() const noexcept { return storage.cbegin(); }
+		constexpr auto cend() const noexcept { return storage.cend(); }
 
 		// Row multiplication by a constant.
         void operator*= (const T rhs) noexcept
@@ -91,8 +327,32 @@ namespace matrix_math
             for (index_t i = 0; i < Width; ++i)
                 storage[i] += rhs[i];
         }
+
+		// Addition of a multiple of one row to this one (axpy), without a temporary row. Elements 
+		// before first are left alone.
+		template <bool Fused = use_fma>
+		void add_scaled(const row<Width,T>& rhs, const T factor, const index_t first = 0) noexcept
+		{
+			for (index_t i = first; i < Width; ++i)
+				storage[i] = multiply_add<Fused>(rhs[i], factor, storage[i]);
+		}
     }; // End of class row.
 
+	// Inner product of two rows.
+	template <bool Fused = use_fma, index_t Width, typename LhsT, typename RhsT>
+	auto dot(const row<Width, LhsT>& lhs, const row<Width, RhsT>& rhs) noexcept
+		-> std::common_type_t<LhsT, RhsT>
+	{
+		using commonT = std::common_type_t<LhsT, RhsT>;
+		commonT sum{0};
+		for (index_t i = 0; i < Width; ++i)
+			sum = multiply_add<Fused>(commonT(lhs[i]), commonT(rhs[i]), sum);
+		return sum;
+	}
+
+	template <index_t Height, index_t Width, typename T> class matrix_view;
+	template <index_t Height, index_t Width, typename T> class const_matrix_view;
+
 	//
 	// Matrix class.
 	//
@@ -125,9 +385,15 @@ namespace matrix_math
 			return storage[y]; 
 		}
 
+		// Views of the whole matrix.
+		matrix_view<Height, Width, T> view() noexcept { return {*this}; }
+		const_matrix_view<Height, Width, T> view() const noexcept { return {*this}; }
+
 		// Iteration, by row.
 		constexpr auto begin() noexcept { return storage.begin(); }
 		constexpr auto end() noexcept   { return storage.end(); }
+		constexpr auto begin() const noexcept { return storage.begin(); }
+		constexpr auto end() const noexcept   { return storage.end(); }
 		
 		// Iteration, by column. (Const iterators.)
 		constexpr auto column_cbegin(index_t col) const noexcept 
@@ -139,6 +405,86 @@ namespace matrix_math
 			return const_column_iterator(*this, Height, col);
 		}
 
+		// Copy of a single column, as a contiguous row.
+		auto get_column(index_t col) const noexcept
+			-> row<Height, T>
+		{
+			row<Height, T> column {};
+			std::copy(column_cbegin(col), column_cend(col), column.begin());
+			return column;
+		}
+
+		// Transposition. Each column is packed once into a contiguous row of the result, so 
+		// consumers that walk columns repeatedly (such as multiplication) need not stride 
+		// through the rows of this matrix to do so.
+		auto get_transpose() const noexcept
+			-> matrix<Width, Height, T>
+		{
+			matrix<Width, Height, T> transpose {};
+			for (index_t r = 0; r < Height; ++r)
+				for (index_t c = 0; c < Width; ++c)
+					transpose[c][r] = storage[r][c];
+			return transpose;
+		}
+		// Transposition into existing storage, as for a large transpose reused across a batch.
+		// With streaming stores, each row of the transpose is gathered a few elements at a time.
+		void get_transpose(matrix<Width, Height, T>& transpose, 
+			const store_policy policy = store_policy::automatic) const noexcept
+		{
+			if (!detail::streams(policy, sizeof(transpose)))
+			{
+				for (index_t r = 0; r < Height; ++r)
+					for (index_t c = 0; c < Width; ++c)
+						transpose[c][r] = storage[r][c];
+				return;
+			}
+			constexpr index_t chunk = 8;
+			for (index_t c = 0; c < Width; ++c)
+				for (index_t r = 0; r < Height; r += chunk)
+				{
+					T gathered[chunk];
+					const index_t count = std::min(chunk, Height - r);
+					for (index_t k = 0; k < count; ++k)
+						gathered[k] = storage[r+k][c];
+					detail::stream_copy(gathered, count, transpose[c].data() + r);
+				}
+			detail::stream_fence();
+		}
+
+		// Copying of blocks. The block's top left element is at [row][col] in this matrix.
+		template <index_t BlockHeight, index_t BlockWidth>
+		void get_block(const index_t row, const index_t col, matrix<BlockHeight, BlockWidth, T>& block) const noexcept
+		{
+			for (index_t r = 0; r < BlockHeight; ++r)
+				std::copy_n(storage[row+r].begin() + col, BlockWidth, block[r].begin());
+		}
+		template <index_t BlockHeight, index_t BlockWidth>
+		void set_block(const index_t row, const index_t col, const matrix<BlockHeight, BlockWidth, T>& block) noexcept
+		{
+			for (index_t r = 0; r < BlockHeight; ++r)
+				std::copy_n(block[r].begin(), BlockWidth, storage[row+r].begin() + col);
+		}
+
+		// Elementwise addition and subtraction, and multiplication by a constant.
+		self_t& operator+= (const self_t& rhs) noexcept
+		{
+			for (index_t r = 0; r < Height; ++r)
+				storage[r] += rhs[r];
+			return *this;
+		}
+		self_t& operator-= (const self_t& rhs) noexcept
+		{
+			for (index_t r = 0; r < Height; ++r)
+				storage[r].add_scaled(rhs[r], T(-1));
+			return *this;
+		}
+		self_t& operator*= (const T rhs) noexcept
+		{
+			for (auto& row : storage)
+				row *= rhs;
+			return *this;
+		}
+
 		// Elementary row operations.
         void swap_rows(const index_t a, const index_t b) noexcept
         {
@@ -148,19 +494,29 @@ namespace matrix_math
 
 		// The Gauss--Jordan algorithm.
 		void row_reduce()
+		{
+			if (!try_row_reduce())
+				throw matrix_is_degenerate_error();
+		}
+
+		// The Gauss--Jordan algorithm, returning false (with the matrix partly reduced) as soon as
+		// a column is found to have no acceptable pivot, rather than throwing.
+		bool try_row_reduce() noexcept
 		{
 			for (index_t r = 0; r < Height; ++r)
 			{
 				// We need a non-zero element at position [r][r].
-				// Interchange rows to obtain a non-zero.
-				if (std::abs(storage[r][r]) <= equality_tolerance)
+				// Interchange rows to bring the largest element of column r, at or below row r,
+				// into place.
 				{
-					index_t s = r+1;
-					while (s < Height && std::abs(storage[s][s]) <= equality_tolerance )
-						++s;
-					if (s == Height)
-						throw matrix_is_degenerate_error();
-					swap_rows(r,s);
+					index_t pivot = r;
+					for (index_t s = r+1; s < Height; ++s)
+						if (std::abs(storage[s][r]) > std::abs(storage[pivot][r]))
+							pivot = s;
+					if (std::abs(storage[pivot][r]) <= equality_tolerance)
+						return false;
+					if (pivot != r)
+						swap_rows(r, pivot);
 				}
 				// We need element at position [r][r] to be 1.
 				// Multiply by the reciprocal.
@@ -173,9 +529,60 @@ namespace matrix_math
 				{
 					for (index_t s=0; s < Height; ++s)
 						if (s != r && storage[s][r] != T(0))
-							storage[s] += storage[r] * -storage[s][r];
+							storage[s].add_scaled(storage[r], -storage[s][r]);
 				}
 			}
+			return true;
+		}
+
+		// Cheap screening for degeneracy, in O(N^2) time (barring collisions of hashes) and without
+		// elimination: true if any row or column is zero, or if any two rows or any two columns are
+		// equal. A false result does not imply that the matrix is invertible. Only valid for square
+		// matrices.
+		bool has_degenerate_structure() const noexcept
+		{
+			static_assert(Height == Width, "Degeneracy only defined for square matrices.");
+			// Each row and column is hashed in one pass. Equal elements have equal hashes: adding
+			// zero makes a negative zero positive.
+			std::array<std::uint64_t, Height> row_hashes;
+			std::array<std::uint64_t, Width> column_hashes;
+			std::array<bool, Width> zero_columns;
+			column_hashes.fill(0);
+			zero_columns.fill(true);
+			for (index_t r = 0; r < Height; ++r)
+			{
+				std::uint64_t hash = 0;
+				bool zero_row = true;
+				for (index_t c = 0; c < Width; ++c)
+				{
+					const T x = storage[r][c];
+					const bool zero = std::abs(x) <= equality_tolerance;
+					zero_row &= zero;
+					zero_columns[c] &= zero;
+					const double normal = double(x) + 0.0;
+					std::uint64_t bits;
+					std::memcpy(&bits, &normal, sizeof(bits));
+					hash = (hash ^ bits) * 1099511628211u;
+					column_hashes[c] = (column_hashes[c] ^ bits) * 1099511628211u;
+				}
+				if (zero_row)
+					return true;
+				row_hashes[r] = hash;
+			}
+			if (std::find(zero_columns.begin(), zero_columns.end(), true) != zero_columns.end())
+				return true;
+
+			return has_equal_lines(row_hashes, [this](const index_t a, const index_t b)
+				{
+					return std::equal(storage[a].begin(), storage[a].end(), storage[b].begin());
+				}) ||
+				has_equal_lines(column_hashes, [this](const index_t a, const index_t b)
+				{
+					for (index_t r = 0; r < Height; ++r)
+						if (!(storage[r][a] == storage[r][b]))
+							return false;
+					return true;
+				});
 		}
 
 		// Obtain the right-hand half following row reduction.
@@ -188,6 +595,15 @@ namespace matrix_math
 					right_slice[r][c] = storage[r][c+Width/2];
 			return right_slice;
 		}
+		void get_right_slice(matrix<Height, Width/2, T>& right_slice, 
+			const store_policy policy = store_policy::automatic) const noexcept
+		{
+			const bool streaming = detail::streams(policy, sizeof(right_slice));
+			for (index_t r = 0; r < Height; ++r)
+				detail::copy_elements(storage[r].data() + Width/2, Width/2, right_slice[r].data(), streaming);
+			if (streaming)
+				detail::stream_fence();
+		}
 
 		// Equality relationships.
 		template <index_t LhsHeight, index_t LhsWidth, typename LhsT, index_t RhsHeight, index_t RhsWidth, typename RhsT>
@@ -197,18 +613,12 @@ namespace matrix_math
 
 		// Matrix multiplication.
 		template <index_t RhsWidth, typename RhsT>
-		auto operator* (const matrix<Width, RhsWidth, RhsT>& rhs) noexcept
+		auto operator* (const matrix<Width, RhsWidth, RhsT>& rhs) const noexcept
 			-> matrix<Height, RhsWidth, std::common_type_t<T, RhsT>>
 		{
 			using commonT = std::common_type_t<T, RhsT>;
-			constexpr index_t RhsHeight = Width; // Avoid confusion.
-			matrix<RhsHeight, RhsWidth, commonT> product;
-			
-			for (index_t r = 0; r < RhsHeight; ++r)
-				for (index_t c = 0; c < RhsWidth; ++c)
-					product[r][c] = std::inner_product(
-						storage[r].begin(), storage[r].end(), rhs.column_cbegin(c),	commonT(0)
-					);
+			matrix<Height, RhsWidth, commonT> product;
+			multiply(rhs, product, detail::product_kernel_t<Height, Width>{});
 			return product;
 		}
 		
@@ -235,15 +645,53 @@ namespace matrix_math
         	return identity;
     	}
 		
-		// In place inversion. Only valid for square matrices.
+		// In place inversion, by the Gauss--Jordan algorithm with partial pivoting. Only valid for
+		// square matrices.
 		void invert()
 		{
             static_assert(Height == Width, "Can only invert square matrices.");
-			auto augmented_matrix = horizontal_concat(*this, get_identity_matrix());
-            augmented_matrix.row_reduce();
-            *this = augmented_matrix.get_right_slice();
+			invert_gauss_jordan();
         }
 
+		// In place inversion, returning false (with the matrix unchanged) if the matrix is 
+		// degenerate, rather than throwing.
+		bool try_invert() noexcept
+		{
+            static_assert(Height == Width, "Can only invert square matrices.");
+			return try_gauss_jordan_inverse(*this);
+		}
+
+		// In place inversion by the Gauss--Jordan algorithm, as invert() performs it.
+		void invert_gauss_jordan()
+		{
+            static_assert(Height == Width, "Can only invert square matrices.");
+			if (!try_gauss_jordan_inverse(*this))
+				throw matrix_is_degenerate_error();
+		}
+
+		// In place inversion by recursive 2x2 block inversion down to LeafSize. The block method
+		// does not pivot between blocks, so if a leading block (or its Schur complement) is 
+		// degenerate, the whole matrix is inverted by the Gauss--Jordan algorithm instead. An
+		// ill-conditioned leading block is not detected, and gives an inaccurate inverse; use
+		// this only for matrices whose leading blocks are known to be well conditioned, such as
+		// those that are diagonally dominant or positive definite.
+		template <index_t LeafSize = inversion_leaf_size>
+		void invert_blocked()
+		{
+            static_assert(Height == Width, "Can only invert square matrices.");
+			static_assert(LeafSize > 0, "Leaf size must be positive.");
+			try
+			{
+				const auto inverse = std::make_unique<self_t>(*this);
+				inverse->template invert_recursive<LeafSize>(std::integral_constant<bool, (Height > LeafSize)>{});
+				*this = *inverse;
+			}
+			catch (matrix_is_degenerate_error& )
+			{
+				invert_gauss_jordan();
+			}
+		}
+
 		// Inversion of the present matrix, returned by value.
 		self_t get_inverse() const
 		{
@@ -252,26 +700,191 @@ namespace matrix_math
 			return mtx;
 		}
 
-		// Iteration through columns. Only the minimum feature set is implemented.
+		private:
+		// Gauss--Jordan inversion, as row_reduce() would perform it on the matrix augmented by the
+		// identity (and with the same result), but without forming the augmented matrix. Rows are
+		// interchanged by permuting an index of the rows rather than by moving them; the
+		// permutation is applied once, as the inverse is written out. Returns false, leaving
+		// inverse unchanged, if the matrix is degenerate. The inverse may be this matrix.
+		bool try_gauss_jordan_inverse(self_t& inverse) const noexcept
+		{
+			self_t left{*this};
+			self_t right = get_identity_matrix();
+			// Logical row r is physical row order[r].
+			std::array<index_t, Height> order;
+			std::iota(order.begin(), order.end(), index_t(0));
+
+			for (index_t r = 0; r < Height; ++r)
+			{
+				// We need a non-zero element at position [r][r].
+				// Interchange rows to bring the largest element of column r, at or below row r,
+				// into place.
+				{
+					index_t pivot = r;
+					for (index_t s = r+1; s < Height; ++s)
+						if (std::abs(left[order[s]][r]) > std::abs(left[order[pivot]][r]))
+							pivot = s;
+					if (std::abs(left[order[pivot]][r]) <= equality_tolerance)
+						return false;
+					std::swap(order[r], order[pivot]);
+				}
+				auto& pivot_left = left[order[r]];
+				auto& pivot_right = right[order[r]];
+
+				// We need element at position [r][r] to be 1.
+				// Multiply by the reciprocal.
+				// Columns before r of the left half are finished with, and no longer updated.
+				if (pivot_left[r] != T(1))
+				{
+					const T reciprocal = T(1) / pivot_left[r];
+					for (index_t c = r+1; c < Width; ++c)
+						pivot_left[c] *= reciprocal;
+					pivot_right *= reciprocal;
+				}
+				// In column r for each other row, we need a zero.
+				for (index_t p = 0; p < Height; ++p)
+					if (p != order[r] && left[p][r] != T(0))
+					{
+						const T factor = -left[p][r];
+						left[p].add_scaled(pivot_left, factor, r+1);
+						right[p].add_scaled(pivot_right, factor);
+					}
+			}
+
+			for (index_t r = 0; r < Height; ++r)
+				inverse[r] = right[order[r]];
+			return true;
+		}
+		// True if any two of the lines (rows or columns) with the given hashes are equal by
+		// equal(a, b). Lines are compared element by element only when their hashes are equal.
+		template <std::size_t Count, typename Equal>
+		static bool has_equal_lines(const std::array<std::uint64_t, Count>& hashes, const Equal& equal) noexcept
+		{
+			for (index_t i = 0; i < Count; ++i)
+				for (index_t j = i+1; j < Count; ++j)
+					if (hashes[i] == hashes[j] && equal(i, j))
+						return true;
+			return false;
+		}
+
+		// Multiplication kernels. The product must be zero on entry.
+		template <index_t RhsWidth, typename RhsT, typename ProductT>
+		void multiply(const matrix<Width, RhsWidth, RhsT>& rhs, matrix<Height, RhsWidth, ProductT>& product,
+			detail::outer_product_kernel) const noexcept
+		{
+			for (index_t r = 0; r < Height; ++r)
+				for (index_t c = 0; c < RhsWidth; ++c)
+					product[r][c] = ProductT(storage[r][0]) * ProductT(rhs[0][c]);
+		}
+		template <index_t RhsWidth, typename RhsT, typename ProductT>
+		void multiply(const matrix<Width, RhsWidth, RhsT>& rhs, matrix<Height, RhsWidth, ProductT>& product,
+			detail::row_accumulation_kernel) const noexcept
+		{
+			for (index_t r = 0; r < Height; ++r)
+			{
+				auto& product_row = product[r];
+				for (index_t k = 0; k < Width; ++k)
+				{
+					const ProductT factor = storage[r][k];
+					const auto& rhs_row = rhs[k];
+					for (index_t c = 0; c < RhsWidth; ++c)
+						product_row[c] = multiply_add(factor, ProductT(rhs_row[c]), product_row[c]);
+				}
+			}
+		}
+		template <index_t RhsWidth, typename RhsT, typename ProductT>
+		void multiply(const matrix<Width, RhsWidth, RhsT>& rhs, matrix<Height, RhsWidth, ProductT>& product,
+			detail::packed_inner_product_kernel) const noexcept
+		{
+			// Pack the columns of the rhs once, rather than striding down them for every row.
+			const auto rhs_columns = rhs.get_transpose();
+			for (index_t r = 0; r < Height; ++r)
+				for (index_t c = 0; c < RhsWidth; ++c)
+					product[r][c] = dot(storage[r], rhs_columns[c]);
+		}
+
+		template <index_t LeafSize>
+		void invert_recursive(std::false_type)
+		{
+			invert_gauss_jordan();
+		}
+
+		// With A = [A11 A12; A21 A22] and Schur complement S = A22 - A21 A11^-1 A12,
+		// A^-1 = [A11^-1 + A11^-1 A12 S^-1 A21 A11^-1,  -A11^-1 A12 S^-1; -S^-1 A21 A11^-1,  S^-1].
+		template <index_t LeafSize>
+		void invert_recursive(std::true_type)
+		{
+			constexpr index_t N1 = Height / 2;
+			constexpr index_t N2 = Height - N1;
+			constexpr bool recurse_1 = N1 > LeafSize;
+			constexpr bool recurse_2 = N2 > LeafSize;
+			// The blocks live on the heap, and the products are computed into them in place. At the
+			// sizes for which this method is worthwhile, they would soon exhaust the stack.
+			auto a11 = std::make_unique<matrix<N1, N1, T>>();
+			auto a12 = std::make_unique<matrix<N1, N2, T>>();
+			auto a21 = std::make_unique<matrix<N2, N1, T>>();
+			auto schur = std::make_unique<matrix<N2, N2, T>>();
+			get_block(0, 0, *a11);
+			get_block(0, N1, *a12);
+			get_block(N1, 0, *a21);
+			get_block(N1, N1, *schur);
+
+			a11->template invert_recursive<LeafSize>(std::integral_constant<bool, recurse_1>{});
+			auto a11_inv_a12 = std::make_unique<matrix<N1, N2, T>>();
+			auto a21_a11_inv = std::make_unique<matrix<N2, N1, T>>();
+			gemm(T(1), *a11, *a12, T(0), *a11_inv_a12);
+			gemm(T(1), *a21, *a11, T(0), *a21_a11_inv);
+			gemm(T(-1), *a21, *a11_inv_a12, T(1), *schur);
+			schur->template invert_recursive<LeafSize>(std::integral_constant<bool, recurse_2>{});
+
+			// Reuse the off-diagonal blocks for the off-diagonal blocks of the inverse.
+			gemm(T(-1), *a11_inv_a12, *schur, T(0), *a12);
+			gemm(T(-1), *schur, *a21_a11_inv, T(0), *a21);
+			gemm(T(-1), *a12, *a21_a11_inv, T(1), *a11);
+
+			set_block(0, 0, *a11);
+			set_block(0, N1, *a12);
+			set_block(N1, 0, *a21);
+			set_block(N1, N1, *schur);
+		}
+
+		// Blocks of other sizes invert recursively.
+		template <index_t, index_t, typename> friend class matrix;
+
+		public:
+		// Iteration through columns. A full random access iterator, so that std:: algorithms 
+		// may use it to best effect.
 		class const_column_iterator 
 		{
-			const self_t& parent;
+			const self_t* parent;
 			index_t row;
-			const index_t column;
+			index_t column;
 			
 			public:
-			const_column_iterator(const self_t& parent, index_t row, index_t column) 
-				: parent(parent), row(row), column(column) 
+			using iterator_category = std::random_access_iterator_tag;
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const T*;
+			using reference = const T&;
+
+			const_column_iterator() noexcept : parent(nullptr), row(0), column(0) { }
+			const_column_iterator(const self_t& parent, index_t row, index_t column) noexcept
+				: parent(&parent), row(row), column(column) 
 			{ }
 			
 			// Dereference.
-			constexpr T operator*() const noexcept { return parent[row][column]; }
+			constexpr reference operator*() const noexcept { return (*parent)[row][column]; }
+			constexpr pointer operator->() const noexcept { return &(*parent)[row][column]; }
+			constexpr reference operator[](difference_type n) const noexcept
+			{
+				return (*parent)[row + n][column];
+			}
 			
 			// Increment.
 			const_column_iterator& operator++() noexcept { ++row; return *this; }
 			const_column_iterator operator++(int) noexcept
 			{
-				const_column_iterator unincremented{parent, row, column};
+				const_column_iterator unincremented{*this};
 				++row;
 				return unincremented;
 			}
@@ -280,10 +893,56 @@ namespace matrix_math
 			const_column_iterator& operator--() noexcept { --row; return *this; }
 			const_column_iterator operator--(int) noexcept
 			{
-				const_column_iterator undecremented{parent, row, column};
+				const_column_iterator undecremented{*this};
 				--row;
 				return undecremented;
 			}
+
+			// Random access.
+			const_column_iterator& operator+=(difference_type n) noexcept { row += n; return *this; }
+			const_column_iterator& operator-=(difference_type n) noexcept { row -= n; return *this; }
+			friend const_column_iterator operator+(const_column_iterator it, difference_type n) noexcept
+			{
+				return it += n;
+			}
+			friend const_column_iterator operator+(difference_type n, const_column_iterator it) noexcept
+			{
+				return it += n;
+			}
+			friend const_column_iterator operator-(const_column_iterator it, difference_type n) noexcept
+			{
+				return it -= n;
+			}
+			friend difference_type operator-(const const_column_iterator& lhs, const const_column_iterator& rhs) noexcept
+			{
+				return difference_type(lhs.row) - difference_type(rhs.row);
+			}
+
+			// Comparison. Only iterators over the same column of the same matrix are comparable.
+			friend bool operator==(const const_column_iterator& lhs, const const_column_iterator& rhs) noexcept
+			{
+				return lhs.row == rhs.row;
+			}
+			friend bool operator!=(const const_column_iterator& lhs, const const_column_iterator& rhs) noexcept
+			{
+				return lhs.row != rhs.row;
+			}
+			friend bool operator<(const const_column_iterator& lhs, const const_column_iterator& rhs) noexcept
+			{
+				return lhs.row < rhs.row;
+			}
+			friend bool operator>(const const_column_iterator& lhs, const const_column_iterator& rhs) noexcept
+			{
+				return lhs.row > rhs.row;
+			}
+			friend bool operator<=(const const_column_iterator& lhs, const const_column_iterator& rhs) noexcept
+			{
+				return lhs.row <= rhs.row;
+			}
+			friend bool operator>=(const const_column_iterator& lhs, const const_column_iterator& rhs) noexcept
+			{
+				return lhs.row >= rhs.row;
+			}
 		}; // End of const_column_iterator.
 	}; // End of class matrix.
 
@@ -316,6 +975,130 @@ namespace matrix_math
 	template <index_t Size, typename T = default_T>
     using square_matrix = matrix<Size, Size, T>;
 
+	//
+	// Views.
+	//
+	// A view is a Height x Width window onto row-major storage that it does not own: a matrix, a
+	// block of a matrix, or memory from elsewhere. Consecutive rows are stride elements apart.
+	// Indexing a view by row gives a pointer to the first element of that row, so view[r][c]
+	// reads as it would for a matrix. Views are cheap to copy and are passed by value.
+	//
+	template <index_t Height, index_t Width, typename T = default_T>
+	class matrix_view
+	{
+		T* first;
+		index_t stride;
+
+		public:
+		using type = T;
+
+		// Constructors.
+		matrix_view(T* first, const index_t stride = Width) noexcept 
+			: first(first), stride(stride)
+		{ }
+		template <index_t MtxHeight, index_t MtxWidth>
+		matrix_view(matrix<MtxHeight, MtxWidth, T>& mtx, const index_t row = 0, const index_t col = 0) noexcept
+			: first(mtx[row].data() + col), stride(MtxWidth)
+		{
+			static_assert(sizeof(matrix<MtxHeight, MtxWidth, T>) == MtxHeight * MtxWidth * sizeof(T),
+				"Matrix rows must be contiguous.");
+		}
+
+		// Accessors.
+		T* operator[] (const index_t r) const noexcept { return first + r * stride; }
+		T* data() const noexcept { return first; }
+		index_t row_stride() const noexcept { return stride; }
+
+		// Copying in and out.
+		auto get_matrix() const noexcept
+			-> matrix<Height, Width, T>
+		{
+			matrix<Height, Width, T> mtx;
+			for (index_t r = 0; r < Height; ++r)
+				std::copy_n((*this)[r], Width, mtx[r].begin());
+			return mtx;
+		}
+		void assign(const matrix<Height, Width, T>& mtx) const noexcept
+		{
+			for (index_t r = 0; r < Height; ++r)
+				std::copy_n(mtx[r].begin(), Width, (*this)[r]);
+		}
+	}; // End of class matrix_view.
+
+	template <index_t Height, index_t Width, typename T = default_T>
+	class const_matrix_view
+	{
+		const T* first;
+		index_t stride;
+
+		public:
+		using type = T;
+
+		// Constructors.
+		const_matrix_view(const T* first, const index_t stride = Width) noexcept 
+			: first(first), stride(stride)
+		{ }
+		template <index_t MtxHeight, index_t MtxWidth>
+		const_matrix_view(const matrix<MtxHeight, MtxWidth, T>& mtx, const index_t row = 0, const index_t col = 0) noexcept
+			: first(mtx[row].data() + col), stride(MtxWidth)
+		{
+			static_assert(sizeof(matrix<MtxHeight, MtxWidth, T>) == MtxHeight * MtxWidth * sizeof(T),
+				"Matrix rows must be contiguous.");
+		}
+		const_matrix_view(const matrix_view<Height, Width, T> view) noexcept
+			: first(view.data()), stride(view.row_stride())
+		{ }
+
+		// Accessors.
+		const T* operator[] (const index_t r) const noexcept { return first + r * stride; }
+		const T* data() const noexcept { return first; }
+		index_t row_stride() const noexcept { return stride; }
+
+		// Copying out.
+		auto get_matrix() const noexcept
+			-> matrix<Height, Width, T>
+		{
+			matrix<Height, Width, T> mtx;
+			for (index_t r = 0; r < Height; ++r)
+				std::copy_n((*this)[r], Width, mtx[r].begin());
+			return mtx;
+		}
+	}; // End of class const_matrix_view.
+
+	//
+	// A batch view is count Height x Width matrices stored one after another, each row-major and
+	// without padding, in memory that it does not own. Indexing it gives a view of one matrix.
+	//
+	template <index_t Height, index_t Width, typename T = default_T>
+	class const_batch_view
+	{
+		const T* first;
+		index_t count;
+
+		public:
+		using type = T;
+
+		// Constructors.
+		const_batch_view(const T* first, const index_t count) noexcept
+			: first(first), count(count)
+		{ }
+		const_batch_view(const matrix<Height, Width, T>* first, const index_t count) noexcept
+			: first(reinterpret_cast<const T*>(first)), count(count)
+		{
+			static_assert(sizeof(matrix<Height, Width, T>) == Height * Width * sizeof(T),
+				"Matrices must be unpadded.");
+		}
+
+		// Accessors.
+		const_matrix_view<Height, Width, T> operator[] (const index_t i) const noexcept
+		{
+			return {first + i * Height * Width};
+		}
+		const T* data() const noexcept { return first; }
+		index_t size() const noexcept { return count; }
+		bool empty() const noexcept { return count == 0; }
+	}; // End of class const_batch_view.
+
 	// Concatenation, for producing the adjunct matrix.
     template <index_t Height, index_t LhsWidth, index_t RhsWidth, typename T = default_T>
     auto horizontal_concat(const matrix<Height, LhsWidth, T>& lhs, 
@@ -332,6 +1115,156 @@ namespace matrix_math
         }
         return concatenation; 
     }
+	// Concatenation into existing storage.
+	template <index_t Height, index_t LhsWidth, index_t RhsWidth, typename T>
+	void horizontal_concat(const matrix<Height, LhsWidth, T>& lhs, const matrix<Height, RhsWidth, T>& rhs,
+		matrix<Height, LhsWidth+RhsWidth, T>& concatenation, const store_policy policy = store_policy::automatic) noexcept
+	{
+		const bool streaming = detail::streams(policy, sizeof(concatenation));
+		for (index_t r = 0; r < Height; ++r)
+		{
+			detail::copy_elements(lhs[r].data(), LhsWidth, concatenation[r].data(), streaming);
+			detail::copy_elements(rhs[r].data(), RhsWidth, concatenation[r].data() + LhsWidth, streaming);
+		}
+		if (streaming)
+			detail::stream_fence();
+	}
+
+	// Bulk copy and initialization.
+	template <index_t Height, index_t Width, typename T>
+	void copy_matrix(const matrix<Height, Width, T>& source, matrix<Height, Width, T>& destination,
+		const store_policy policy = store_policy::automatic) noexcept
+	{
+		const bool streaming = detail::streams(policy, sizeof(destination));
+		for (index_t r = 0; r < Height; ++r)
+			detail::copy_elements(source[r].data(), Width, destination[r].data(), streaming);
+		if (streaming)
+			detail::stream_fence();
+	}
+	template <index_t Height, index_t Width, typename T>
+	void fill_matrix(matrix<Height, Width, T>& destination, const T value,
+		const store_policy policy = store_policy::automatic) noexcept
+	{
+		if (!detail::streams(policy, sizeof(destination)))
+		{
+			for (auto& row : destination)
+				std::fill(row.begin(), row.end(), value);
+			return;
+		}
+		for (auto& row : destination)
+			detail::stream_fill(row.data(), Width, value);
+		detail::stream_fence();
+	}
+
+	//
+	// In place accumulation (BLAS-style level 3 and level 2 updates).
+	//
+
+	// General matrix multiplication, C = alpha A B + beta C. If beta is zero, C need not be
+	// initialized.
+	template <index_t Height, index_t InnerSize, index_t Width, typename T>
+	void gemm(const T alpha, const matrix<Height, InnerSize, T>& a, const matrix<InnerSize, Width, T>& b,
+		const T beta, matrix<Height, Width, T>& c) noexcept
+	{
+		// Cleared in place: a zero temporary would be as large as C, which may not fit on the stack.
+		if (beta == T(0))
+			for (auto& row : c)
+				std::fill(row.begin(), row.end(), T(0));
+		else if (beta != T(1))
+			c *= beta;
+
+		for (index_t panel = 0; panel < InnerSize; panel += gemm_panel_depth)
+		{
+			const index_t panel_end = std::min(panel + gemm_panel_depth, InnerSize);
+			for (index_t r = 0; r < Height; ++r)
+				for (index_t k = panel; k < panel_end; ++k)
+				{
+					const T factor = alpha * a[r][k];
+					if (factor != T(0))
+						c[r].add_scaled(b[k], factor);
+				}
+		}
+	}
+
+	// Rank-1 update, A = alpha x yᵀ + A.
+	template <index_t Height, index_t Width, typename T>
+	void ger(const T alpha, const row<Height, T>& x, const row<Width, T>& y, matrix<Height, Width, T>& a) noexcept
+	{
+		for (index_t r = 0; r < Height; ++r)
+		{
+			const T factor = alpha * x[r];
+			if (factor != T(0))
+				a[r].add_scaled(y, factor);
+		}
+	}
+
+	// Symmetric rank-k update, C = alpha A Aᵀ + beta C. Only the upper triangle is computed; the
+	// lower triangle is copied from it, so C is exactly symmetric.
+	template <index_t Size, index_t InnerSize, typename T>
+	void syrk(const T alpha, const matrix<Size, InnerSize, T>& a, const T beta, matrix<Size, Size, T>& c) noexcept
+	{
+		for (index_t r = 0; r < Size; ++r)
+			for (index_t col = r; col < Size; ++col)
+			{
+				const T product = alpha * dot(a[r], a[col]);
+				c[r][col] = (beta == T(0)) ? product : multiply_add(beta, c[r][col], product);
+				c[col][r] = c[r][col];
+			}
+	}
+
+	// Inversion of a batch of square matrices, in place. Each matrix in [first, last) is inverted
+	// if possible and left unchanged otherwise, and whether it was inverted is written through
+	// status. If screen is set, matrices of degenerate structure are rejected before any
+	// elimination is attempted; this pays only when such matrices are common in the batch.
+	// Returns the number of matrices inverted.
+	template <typename ForwardIt, typename OutputIt>
+	index_t invert_batch(ForwardIt first, const ForwardIt last, OutputIt status, const bool screen = false) noexcept
+	{
+		index_t inverted = 0;
+		for ( ; first != last; ++first, ++status)
+		{
+			// The next matrix is fetched while this one is inverted.
+			using matrix_t = typename std::iterator_traits<ForwardIt>::value_type;
+			if (sizeof(matrix_t) <= batch_prefetch_limit)
+			{
+				const auto next = std::next(first);
+				if (next != last)
+					detail::prefetch(&*next, sizeof(matrix_t), true);
+			}
+
+			const bool success = !(screen && first->has_degenerate_structure()) && first->try_invert();
+			*status = success;
+			inverted += success;
+		}
+		return inverted;
+	}
+
+	// Cholesky decomposition, A = L Lᵀ, of a symmetric positive definite matrix. Only the lower
+	// triangle of A is read. Returns the lower triangular factor L.
+	template <index_t Size, typename T>
+	auto cholesky(const matrix<Size, Size, T>& mtx)
+		-> matrix<Size, Size, T>
+	{
+		matrix<Size, Size, T> lower {};
+		for (index_t c = 0; c < Size; ++c)
+		{
+			T diagonal = mtx[c][c];
+			for (index_t k = 0; k < c; ++k)
+				diagonal -= lower[c][k] * lower[c][k];
+			if (!(diagonal > T(0)))
+				throw matrix_not_positive_definite_error();
+			lower[c][c] = std::sqrt(diagonal);
+
+			for (index_t r = c+1; r < Size; ++r)
+			{
+				T element = mtx[r][c];
+				for (index_t k = 0; k < c; ++k)
+					element -= lower[r][k] * lower[c][k];
+				lower[r][c] = element / lower[c][c];
+			}
+		}
+		return lower;
+	}
 
 } // End namespace matrix_math.
 
@@ -0,0 +1,728 @@
+/*
+ * Matrix maths: NumPy .npy and .npz files.
+ *
+ * load_npy() maps a .npy file into memory and parses its header. Where the array has the shape,
+ * element type and byte order of a matrix<Height, Width, T> (or, in three dimensions, of a batch
+ * of them), and is stored in C order, it can be viewed in place with a const_matrix_view or a
+ * const_batch_view, without reading or converting anything. Otherwise get_matrix() and
+ * get_batch() copy it, converting the elements and the layout.
+ *
+ * An npz_archive maps a .npz file, as written by numpy.savez(), and gives each array in it by
+ * name. Arrays compressed by numpy.savez_compressed() cannot be mapped, and are refused.
+ *
+ * write_npy() and npz_writer write matrices and batches for NumPy to read. The writer aligns the
+ * elements of every array to 64 bytes, within .npz files as well as .npy files, so that they can
+ * always be viewed in place when read back.
+ *
+ *
+ * Requires C++14 or later and POSIX.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_NPY_H
+#define CROWSTON_MATRIX_NPY_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "matrix_io.hpp"
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	//
+	// Exceptions.
+	//
+	struct npy_format_error : public std::runtime_error
+	{
+		explicit npy_format_error(const std::string& what) : std::runtime_error(what) {}
+		virtual ~npy_format_error() {}
+	};
+
+	// The alignment the writer gives to the elements of every array.
+	constexpr std::size_t npy_alignment = 64;
+
+	namespace detail
+	{
+		// Little-endian fields, as in .npy headers and zip records.
+		template <typename Unsigned>
+		Unsigned load_little_endian(const char* p) noexcept
+		{
+			Unsigned value = 0;
+			for (std::size_t i = sizeof(Unsigned); i-- > 0; )
+				value = Unsigned(value << 8) | Unsigned(static_cast<unsigned char>(p[i]));
+			return value;
+		}
+		template <typename Unsigned>
+		void store_little_endian(std::string& out, const Unsigned value)
+		{
+			for (std::size_t i = 0; i < sizeof(Unsigned); ++i)
+				out.push_back(char((std::uint64_t(value) >> (8 * i)) & 0xff));
+		}
+
+		constexpr bool little_endian_host = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+		// The NumPy type string of T, such as "<f8".
+		template <typename T>
+		std::string npy_descr()
+		{
+			static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+				"Only numbers can be stored in .npy files.");
+			const char kind = std::is_floating_point<T>::value ? 'f' : std::is_signed<T>::value ? 'i' : 'u';
+			const char order = sizeof(T) == 1 ? '|' : little_endian_host ? '<' : '>';
+			return std::string{order, kind} + std::to_string(sizeof(T));
+		}
+
+		// An element type, as parsed from a type string. Kind is zero if it is not one that can
+		// be converted.
+		struct npy_dtype
+		{
+			char kind = 0;
+			std::size_t size = 0;
+			bool swap = false;
+		};
+
+		inline npy_dtype parse_descr(const std::string& descr) noexcept
+		{
+			npy_dtype dtype;
+			if (descr.size() < 3 || std::string("<>|=").find(descr[0]) == std::string::npos)
+				return dtype;
+			const std::string size = descr.substr(2);
+			if (size != "1" && size != "2" && size != "4" && size != "8")
+				return dtype;
+			dtype.size = std::size_t(size[0] - '0');
+			const bool floating = descr[1] == 'f' && dtype.size >= 4;
+			const bool boolean = descr[1] == 'b' && dtype.size == 1;
+			if (!floating && !boolean && descr[1] != 'i' && descr[1] != 'u')
+				return dtype;
+			dtype.kind = descr[1];
+			dtype.swap = dtype.size > 1 && (descr[0] == '<' || descr[0] == '>') &&
+				(descr[0] == '<') != little_endian_host;
+			return dtype;
+		}
+
+		// Reads one element of the given type, converting it to T.
+		template <typename T>
+		T convert_element(const char* p, const npy_dtype& dtype) noexcept
+		{
+			char bytes[8];
+			std::memcpy(bytes, p, dtype.size);
+			if (dtype.swap)
+				std::reverse(bytes, bytes + dtype.size);
+			const auto as = [&bytes](auto value)
+			{
+				std::memcpy(&value, bytes, sizeof(value));
+				return T(value);
+			};
+			switch (dtype.kind)
+			{
+				case 'f':
+					return dtype.size == 4 ? as(float()) : as(double());
+				case 'i':
+					return dtype.size == 1 ? as(std::int8_t()) : dtype.size == 2 ? as(std::int16_t()) :
+						dtype.size == 4 ? as(std::int32_t()) : as(std::int64_t());
+				case 'u':
+					return dtype.size == 1 ? as(std::uint8_t()) : dtype.size == 2 ? as(std::uint16_t()) :
+						dtype.size == 4 ? as(std::uint32_t()) : as(std::uint64_t());
+				default:
+					return T(bytes[0] != 0);
+			}
+		}
+
+		// The value of key in the header dictionary, as the text that follows its colon.
+		inline const char* find_key(const std::string& header, const char* key)
+		{
+			for (const char quote : {'\'', '"'})
+			{
+				const auto at = header.find(quote + std::string(key) + quote);
+				if (at == std::string::npos)
+					continue;
+				const auto colon = header.find(':', at);
+				if (colon == std::string::npos)
+					break;
+				const auto value = header.find_first_not_of(" ", colon + 1);
+				if (value == std::string::npos)
+					break;
+				return header.c_str() + value;
+			}
+			throw npy_format_error(std::string("The .npy header has no ") + key + ".");
+		}
+
+		constexpr char npy_magic[] = "\x93NUMPY";
+		constexpr std::size_t npy_magic_size = 6;
+
+		// A header for an array of the given type and shape, padded so that the elements
+		// begin on a multiple of npy_alignment.
+		inline std::string npy_header(const std::string& descr, const std::vector<index_t>& shape)
+		{
+			std::string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (";
+			for (std::size_t d = 0; d < shape.size(); ++d)
+				dict += std::to_string(shape[d]) + (d + 1 < shape.size() ? ", " : shape.size() == 1 ? ",)" : ")");
+			if (shape.empty())
+				dict += ")";
+			dict += ", }";
+			// Version 1 has a two-byte header length; version 2, four.
+			const bool version_1 = dict.size() + npy_alignment < 0xffff;
+			const std::size_t prefix = npy_magic_size + 2 + (version_1 ? 2 : 4);
+			const std::size_t padded = (prefix + dict.size() + 1 + npy_alignment - 1) / npy_alignment * npy_alignment;
+			dict.append(padded - prefix - dict.size() - 1, ' ');
+			dict.push_back('\n');
+
+			std::string header(npy_magic, npy_magic_size);
+			header.push_back(char(version_1 ? 1 : 2));
+			header.push_back(0);
+			if (version_1)
+				store_little_endian(header, std::uint16_t(dict.size()));
+			else
+				store_little_endian(header, std::uint32_t(dict.size()));
+			return header + dict;
+		}
+
+		// The CRC-32 that zip files record, continued from crc over the given bytes.
+		inline std::uint32_t crc32(std::uint32_t crc, const char* data, const std::size_t bytes) noexcept
+		{
+			static const auto table = []
+			{
+				std::array<std::uint32_t, 256> entries;
+				for (std::uint32_t i = 0; i < 256; ++i)
+				{
+					std::uint32_t entry = i;
+					for (int bit = 0; bit < 8; ++bit)
+						entry = (entry & 1) ? 0xedb88320u ^ (entry >> 1) : entry >> 1;
+					entries[i] = entry;
+				}
+				return entries;
+			}();
+			crc = ~crc;
+			for (std::size_t i = 0; i < bytes; ++i)
+				crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xff] ^ (crc >> 8);
+			return ~crc;
+		}
+	} // End namespace detail.
+
+	//
+	// An array in a .npy file, or a .npz member, as mapped into memory. The mapping lasts as
+	// long as any array or view taken from it; views must not outlive the array.
+	//
+	class npy_array
+	{
+		std::shared_ptr<const detail::mapped_file> file;
+		const char* first = nullptr;
+		std::string descr;
+		bool fortran = false;
+		std::vector<index_t> dimensions;
+
+		template <index_t Height, index_t Width, typename T>
+		bool holds_elements() const
+		{
+			return descr == detail::npy_descr<T>() &&
+				reinterpret_cast<std::uintptr_t>(first) % alignof(T) == 0;
+		}
+
+		// The element at the given position, when the last Rank dimensions are indexed by
+		// index[0..Rank), converted to T.
+		template <typename T, std::size_t Rank>
+		T element(const detail::npy_dtype& dtype, const std::array<index_t, Rank>& index) const noexcept
+		{
+			index_t offset = 0;
+			if (fortran)
+				for (std::size_t d = Rank; d-- > 0; )
+					offset = offset * dimensions[d] + index[d];
+			else
+				for (std::size_t d = 0; d < Rank; ++d)
+					offset = offset * dimensions[d] + index[d];
+			return detail::convert_element<T>(first + offset * dtype.size, dtype);
+		}
+
+		detail::npy_dtype convertible_dtype() const
+		{
+			const auto dtype = detail::parse_descr(descr);
+			if (dtype.kind == 0)
+				throw npy_format_error("Cannot convert elements of type " + descr + ".");
+			return dtype;
+		}
+
+		public:
+		npy_array() = default;
+
+		// Parses the .npy image of size bytes at begin, which lies within file.
+		npy_array(std::shared_ptr<const detail::mapped_file> file, const char* begin, const std::size_t size)
+			: file(std::move(file))
+		{
+			if (size < detail::npy_magic_size + 4 || !std::equal(begin, begin + detail::npy_magic_size, detail::npy_magic))
+				throw npy_format_error("Not a .npy file.");
+			const int major = static_cast<unsigned char>(begin[detail::npy_magic_size]);
+			if (major < 1 || major > 3)
+				throw npy_format_error("Unknown .npy version " + std::to_string(major) + ".");
+			const std::size_t prefix = detail::npy_magic_size + 2 + (major == 1 ? 2 : 4);
+			if (size < prefix)
+				throw npy_format_error("The .npy header is truncated.");
+			const std::size_t header_size = major == 1
+				? detail::load_little_endian<std::uint16_t>(begin + detail::npy_magic_size + 2)
+				: detail::load_little_endian<std::uint32_t>(begin + detail::npy_magic_size + 2);
+			if (size < prefix + header_size)
+				throw npy_format_error("The .npy header is truncated.");
+			const std::string header(begin + prefix, header_size);
+
+			const char* value = detail::find_key(header, "descr");
+			if (*value == '\'' || *value == '"')
+			{
+				const char* end = std::strchr(value + 1, *value);
+				if (!end)
+					throw npy_format_error("The .npy header is malformed.");
+				descr.assign(value + 1, end);
+			}
+			else
+				descr = "structured";
+
+			value = detail::find_key(header, "fortran_order");
+			fortran = std::strncmp(value, "True", 4) == 0;
+
+			value = detail::find_key(header, "shape");
+			if (*value != '(')
+				throw npy_format_error("The .npy header is malformed.");
+			for (++value; *value != ')'; )
+			{
+				if (*value == '\0')
+					throw npy_format_error("The .npy header is malformed.");
+				if (*value >= '0' && *value <= '9')
+				{
+					char* end;
+					dimensions.push_back(index_t(std::strtoull(value, &end, 10)));
+					value = end;
+				}
+				else
+					++value;
+			}
+
+			// The size of the data, refusing shapes whose products overflow.
+			first = begin + prefix + header_size;
+			const auto dtype = detail::parse_descr(descr);
+			std::size_t bytes = dtype.kind != 0 ? dtype.size : 1;
+			if (std::find(dimensions.begin(), dimensions.end(), index_t(0)) != dimensions.end())
+				bytes = 0;
+			for (const auto extent : dimensions)
+			{
+				if (extent != 0 && bytes > std::numeric_limits<std::size_t>::max() / extent)
+					throw npy_format_error("The .npy shape is too large.");
+				bytes *= extent;
+			}
+			if (dtype.kind != 0 && size - prefix - header_size < bytes)
+				throw npy_format_error("The .npy data is truncated.");
+		}
+
+		// Accessors.
+		const std::string& dtype() const noexcept { return descr; }
+		bool fortran_order() const noexcept { return fortran; }
+		const std::vector<index_t>& shape() const noexcept { return dimensions; }
+		index_t element_count() const noexcept
+		{
+			index_t count = 1;
+			for (const auto extent : dimensions)
+				count *= extent;
+			return count;
+		}
+		const void* data() const noexcept { return first; }
+
+		// Whether the array can be viewed in place as a matrix<Height, Width, T>: its shape is
+		// (Height, Width) and its elements are T, in native byte order, aligned for T, and in
+		// C order (or in either, for a row or column).
+		template <index_t Height, index_t Width, typename T = default_T>
+		bool is_matrix() const
+		{
+			return dimensions == std::vector<index_t>{Height, Width} && (!fortran || Height == 1 || Width == 1) &&
+				holds_elements<Height, Width, T>();
+		}
+
+		// Whether the array can be viewed in place as a batch of matrix<Height, Width, T>: its
+		// shape is (count, Height, Width) and its elements are as for is_matrix(), in C order.
+		template <index_t Height, index_t Width, typename T = default_T>
+		bool is_batch() const
+		{
+			return dimensions.size() == 3 && dimensions[1] == Height && dimensions[2] == Width &&
+				(!fortran || dimensions[0] * Height == 1 || dimensions[0] * Width == 1) &&
+				holds_elements<Height, Width, T>();
+		}
+
+		// Views in place.
+		template <index_t Height, index_t Width, typename T = default_T>
+		auto view() const
+			-> const_matrix_view<Height, Width, T>
+		{
+			if (!is_matrix<Height, Width, T>())
+				throw npy_format_error("The array cannot be viewed as a matrix of this type; copy it with get_matrix().");
+			return {reinterpret_cast<const T*>(first)};
+		}
+		template <index_t Height, index_t Width, typename T = default_T>
+		auto batch_view() const
+			-> const_batch_view<Height, Width, T>
+		{
+			if (!is_batch<Height, Width, T>())
+				throw npy_format_error("The array cannot be viewed as a batch of this type; copy it with get_batch().");
+			return {reinterpret_cast<const T*>(first), dimensions[0]};
+		}
+
+		// Copies, converting the elements from any integer or floating point type, either byte
+		// order and either storage order.
+		template <index_t Height, index_t Width, typename T = default_T>
+		auto get_matrix() const
+			-> matrix<Height, Width, T>
+		{
+			if (dimensions != std::vector<index_t>{Height, Width})
+				throw npy_format_error("The array does not have the shape of the matrix.");
+			if (is_matrix<Height, Width, T>())
+				return view<Height, Width, T>().get_matrix();
+			const auto dtype = convertible_dtype();
+			matrix<Height, Width, T> mtx;
+			for (index_t r = 0; r < Height; ++r)
+				for (index_t c = 0; c < Width; ++c)
+					mtx[r][c] = element<T, 2>(dtype, {{r, c}});
+			return mtx;
+		}
+		template <index_t Height, index_t Width, typename T = default_T>
+		auto get_batch() const
+			-> std::vector<matrix<Height, Width, T>>
+		{
+			if (dimensions.size() != 3 || dimensions[1] != Height || dimensions[2] != Width)
+				throw npy_format_error("The array does not have the shape of a batch of the matrix.");
+			std::vector<matrix<Height, Width, T>> batch(dimensions[0]);
+			if (is_batch<Height, Width, T>())
+			{
+				std::memcpy(batch.data(), first, batch.size() * sizeof(batch[0]));
+				return batch;
+			}
+			const auto dtype = convertible_dtype();
+			for (index_t k = 0; k < batch.size(); ++k)
+				for (index_t r = 0; r < Height; ++r)
+					for (index_t c = 0; c < Width; ++c)
+						batch[k][r][c] = element<T, 3>(dtype, {{k, r, c}});
+			return batch;
+		}
+	}; // End of class npy_array.
+
+	inline npy_array load_npy(const char* path)
+	{
+		auto file = std::make_shared<const detail::mapped_file>(path);
+		const char* begin = file->data();
+		const std::size_t size = file->size();
+		return npy_array(std::move(file), begin, size);
+	}
+
+	//
+	// The arrays of a .npz file, by name (without the .npy suffix numpy.savez() gives members).
+	// Members that are not .npy files are ignored.
+	//
+	class npz_archive
+	{
+		std::map<std::string, npy_array> arrays;
+
+		public:
+		explicit npz_archive(const char* path)
+		{
+			using detail::load_little_endian;
+			const auto file = std::make_shared<const detail::mapped_file>(path);
+			const char* const begin = file->data();
+			const std::size_t size = file->size();
+			const auto in_file = [&](const std::uint64_t offset, const std::uint64_t length)
+			{
+				if (offset > size || length > size - offset)
+					throw npy_format_error("The .npz file is truncated.");
+				return begin + offset;
+			};
+
+			// The end of central directory record is last, followed only by a comment.
+			constexpr std::size_t end_record_size = 22;
+			if (size < end_record_size)
+				throw npy_format_error("Not a .npz file.");
+			std::size_t end_record = size - end_record_size;
+			while (load_little_endian<std::uint32_t>(begin + end_record) != 0x06054b50)
+			{
+				if (end_record == 0 || size - end_record > end_record_size + 0xffff)
+					throw npy_format_error("Not a .npz file.");
+				--end_record;
+			}
+			std::uint64_t entry_count = load_little_endian<std::uint16_t>(begin + end_record + 10);
+			std::uint64_t directory = load_little_endian<std::uint32_t>(begin + end_record + 16);
+
+			// Zip64: the counts and offsets are in a further record, found by a locator.
+			constexpr std::size_t locator_size = 20;
+			if (end_record >= locator_size &&
+				load_little_endian<std::uint32_t>(begin + end_record - locator_size) == 0x07064b50)
+			{
+				const char* record = in_file(load_little_endian<std::uint64_t>(begin + end_record - locator_size + 8), 56);
+				if (load_little_endian<std::uint32_t>(record) != 0x06064b50)
+					throw npy_format_error("The .npz zip64 directory is corrupt.");
+				entry_count = load_little_endian<std::uint64_t>(record + 32);
+				directory = load_little_endian<std::uint64_t>(record + 48);
+			}
+
+			for (std::uint64_t entry = 0; entry < entry_count; ++entry)
+			{
+				const char* header = in_file(directory, 46);
+				if (load_little_endian<std::uint32_t>(header) != 0x02014b50)
+					throw npy_format_error("The .npz central directory is corrupt.");
+				const auto flags = load_little_endian<std::uint16_t>(header + 8);
+				const auto method = load_little_endian<std::uint16_t>(header + 10);
+				std::uint64_t stored_size = load_little_endian<std::uint32_t>(header + 20);
+				std::uint64_t original_size = load_little_endian<std::uint32_t>(header + 24);
+				const std::size_t name_size = load_little_endian<std::uint16_t>(header + 28);
+				const std::size_t extra_size = load_little_endian<std::uint16_t>(header + 30);
+				const std::size_t comment_size = load_little_endian<std::uint16_t>(header + 32);
+				std::uint64_t local = load_little_endian<std::uint32_t>(header + 42);
+				in_file(directory, 46 + name_size + extra_size + comment_size);
+				std::string name(header + 46, name_size);
+
+				// Zip64 sizes and offset, present for those fields that are saturated. Fields must lie
+				// within the extra area, which is all that in_file() has checked.
+				const char* const extra_end = header + 46 + name_size + extra_size;
+				for (const char* extra = header + 46 + name_size; extra_end - extra >= 4; )
+				{
+					const auto id = load_little_endian<std::uint16_t>(extra);
+					const std::size_t length = load_little_endian<std::uint16_t>(extra + 2);
+					if (length > std::size_t(extra_end - extra) - 4)
+						throw npy_format_error("The .npz extra field of " + name + " is corrupt.");
+					if (id == 0x0001)
+					{
+						const char* field = extra + 4;
+						for (auto* value : {&original_size, &stored_size, &local})
+							if (*value == 0xffffffff && field + 8 <= extra + 4 + length)
+							{
+								*value = load_little_endian<std::uint64_t>(field);
+								field += 8;
+							}
+					}
+					extra += 4 + length;
+				}
+
+				directory += 46 + name_size + extra_size + comment_size;
+
+				// Other files than arrays, which numpy.load() would also pass over, are skipped.
+				if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".npy") != 0)
+					continue;
+				name.resize(name.size() - 4);
+				if (flags & 1)
+					throw npy_format_error(name + " is encrypted.");
+				if (method != 0 || stored_size != original_size)
+					throw npy_format_error(name + " is compressed; save with numpy.savez() rather than numpy.savez_compressed().");
+				const char* local_header = in_file(local, 30);
+				if (load_little_endian<std::uint32_t>(local_header) != 0x04034b50)
+					throw npy_format_error("The .npz local header of " + name + " is corrupt.");
+				const std::uint64_t data = local + 30 + load_little_endian<std::uint16_t>(local_header + 26) +
+					load_little_endian<std::uint16_t>(local_header + 28);
+
+				arrays[name] = npy_array(file, in_file(data, stored_size), std::size_t(stored_size));
+			}
+		}
+
+		// Accessors.
+		index_t size() const noexcept { return arrays.size(); }
+		bool contains(const std::string& name) const { return arrays.count(name) != 0; }
+		const npy_array& operator[] (const std::string& name) const
+		{
+			const auto found = arrays.find(name);
+			if (found == arrays.end())
+				throw npy_format_error("The .npz file has no array " + name + ".");
+			return found->second;
+		}
+		std::vector<std::string> names() const
+		{
+			std::vector<std::string> result;
+			for (const auto& entry : arrays)
+				result.push_back(entry.first);
+			return result;
+		}
+	}; // End of class npz_archive.
+
+	//
+	// Writing.
+	//
+	template <index_t Height, index_t Width, typename T>
+	void write_npy(const char* path, const matrix<Height, Width, T>* first, const index_t count)
+	{
+		static_assert(sizeof(matrix<Height, Width, T>) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+		const auto file = detail::open_file(path, O_WRONLY | O_CREAT | O_TRUNC, false);
+		const std::string header = detail::npy_header(detail::npy_descr<T>(), {count, Height, Width});
+		detail::write_fully(file.get(), header.data(), header.size(), 0);
+		detail::write_fully(file.get(), first, count * sizeof(*first), off_t(header.size()));
+	}
+	template <index_t Height, index_t Width, typename T>
+	void write_npy(const char* path, const matrix<Height, Width, T>& mtx)
+	{
+		static_assert(sizeof(matrix<Height, Width, T>) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+		const auto file = detail::open_file(path, O_WRONLY | O_CREAT | O_TRUNC, false);
+		const std::string header = detail::npy_header(detail::npy_descr<T>(), {Height, Width});
+		detail::write_fully(file.get(), header.data(), header.size(), 0);
+		detail::write_fully(file.get(), &mtx, sizeof(mtx), off_t(header.size()));
+	}
+
+	//
+	// Writes a .npz file, one array at a time. Members are stored uncompressed, with zip64
+	// records throughout so that no array is too large, and are padded so that their elements
+	// are aligned. The archive is complete once close() has been called, or the writer destroyed.
+	//
+	class npz_writer
+	{
+		struct entry
+		{
+			std::string name;
+			std::uint32_t crc;
+			std::uint64_t size;
+			std::uint64_t offset;
+		};
+
+		detail::file_descriptor file;
+		std::uint64_t position = 0;
+		std::vector<entry> entries;
+
+		void append(const std::string& bytes)
+		{
+			detail::write_fully(file.get(), bytes.data(), bytes.size(), off_t(position));
+			position += bytes.size();
+		}
+
+		void add_array(const std::string& name, const std::string& descr, const std::vector<index_t>& shape,
+			const void* elements, const std::size_t bytes)
+		{
+			using detail::store_little_endian;
+			if (file.get() < 0)
+				throw npy_format_error("The .npz file has been closed.");
+			const std::string member = name + ".npy";
+			const std::string header = detail::npy_header(descr, shape);
+			entry added{member, 0, header.size() + bytes, position};
+			added.crc = detail::crc32(detail::crc32(0, header.data(), header.size()),
+				static_cast<const char*>(elements), bytes);
+
+			// The zip64 field, then a padding field to align the array.
+			constexpr std::size_t fixed_size = 30, zip64_size = 20, padding_header_size = 4;
+			const std::size_t unpadded = std::size_t(position) + fixed_size + member.size() + zip64_size + padding_header_size;
+			const std::size_t padding = (npy_alignment - unpadded % npy_alignment) % npy_alignment;
+
+			std::string local;
+			store_little_endian(local, std::uint32_t(0x04034b50));
+			store_little_endian(local, std::uint16_t(45));
+			store_little_endian(local, std::uint16_t(0));
+			store_little_endian(local, std::uint16_t(0));
+			store_little_endian(local, std::uint16_t(0));
+			store_little_endian(local, std::uint16_t(0x21));
+			store_little_endian(local, added.crc);
+			store_little_endian(local, std::uint32_t(0xffffffff));
+			store_little_endian(local, std::uint32_t(0xffffffff));
+			store_little_endian(local, std::uint16_t(member.size()));
+			store_little_endian(local, std::uint16_t(zip64_size + padding_header_size + padding));
+			local += member;
+			store_little_endian(local, std::uint16_t(0x0001));
+			store_little_endian(local, std::uint16_t(16));
+			store_little_endian(local, added.size);
+			store_little_endian(local, added.size);
+			store_little_endian(local, std::uint16_t(0xa11e));
+			store_little_endian(local, std::uint16_t(padding));
+			local.append(padding, '\0');
+			append(local + header);
+
+			detail::write_fully(file.get(), elements, bytes, off_t(position));
+			position += bytes;
+			entries.push_back(added);
+		}
+
+		public:
+		explicit npz_writer(const char* path)
+			: file(detail::open_file(path, O_WRONLY | O_CREAT | O_TRUNC, false))
+		{ }
+		npz_writer(const npz_writer&) = delete;
+		npz_writer& operator= (const npz_writer&) = delete;
+		~npz_writer()
+		{
+			try { close(); } catch (...) { }
+		}
+
+		template <index_t Height, index_t Width, typename T>
+		void add(const std::string& name, const matrix<Height, Width, T>& mtx)
+		{
+			static_assert(sizeof(matrix<Height, Width, T>) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+			add_array(name, detail::npy_descr<T>(), {Height, Width}, &mtx, sizeof(mtx));
+		}
+		template <index_t Height, index_t Width, typename T>
+		void add(const std::string& name, const matrix<Height, Width, T>* first, const index_t count)
+		{
+			static_assert(sizeof(matrix<Height, Width, T>) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+			add_array(name, detail::npy_descr<T>(), {count, Height, Width}, first, count * sizeof(*first));
+		}
+
+		// Writes the central directory and closes the file.
+		void close()
+		{
+			using detail::store_little_endian;
+			if (file.get() < 0)
+				return;
+			const std::uint64_t directory = position;
+			std::string records;
+			for (const auto& added : entries)
+			{
+				store_little_endian(records, std::uint32_t(0x02014b50));
+				store_little_endian(records, std::uint16_t(45));
+				store_little_endian(records, std::uint16_t(45));
+				store_little_endian(records, std::uint16_t(0));
+				store_little_endian(records, std::uint16_t(0));
+				store_little_endian(records, std::uint16_t(0));
+				store_little_endian(records, std::uint16_t(0x21));
+				store_little_endian(records, added.crc);
+				store_little_endian(records, std::uint32_t(0xffffffff));
+				store_little_endian(records, std::uint32_t(0xffffffff));
+				store_little_endian(records, std::uint16_t(added.name.size()));
+				store_little_endian(records, std::uint16_t(28));
+				store_little_endian(records, std::uint16_t(0));
+				store_little_endian(records, std::uint16_t(0));
+				store_little_endian(records, std::uint16_t(0));
+				store_little_endian(records, std::uint32_t(0));
+				store_little_endian(records, std::uint32_t(0xffffffff));
+				records += added.name;
+				store_little_endian(records, std::uint16_t(0x0001));
+				store_little_endian(records, std::uint16_t(24));
+				store_little_endian(records, added.size);
+				store_little_endian(records, added.size);
+				store_little_endian(records, added.offset);
+			}
+			const std::uint64_t directory_size = records.size();
+
+			// Zip64 end of central directory record and locator, then the classic record.
+			const std::uint64_t end_record = directory + directory_size;
+			store_little_endian(records, std::uint32_t(0x06064b50));
+			store_little_endian(records, std::uint64_t(44));
+			store_little_endian(records, std::uint16_t(45));
+			store_little_endian(records, std::uint16_t(45));
+			store_little_endian(records, std::uint32_t(0));
+			store_little_endian(records, std::uint32_t(0));
+			store_little_endian(records, std::uint64_t(entries.size()));
+			store_little_endian(records, std::uint64_t(entries.size()));
+			store_little_endian(records, directory_size);
+			store_little_endian(records, directory);
+			store_little_endian(records, std::uint32_t(0x07064b50));
+			store_little_endian(records, std::uint32_t(0));
+			store_little_endian(records, end_record);
+			store_little_endian(records, std::uint32_t(1));
+			store_little_endian(records, std::uint32_t(0x06054b50));
+			store_little_endian(records, std::uint16_t(0));
+			store_little_endian(records, std::uint16_t(0));
+			store_little_endian(records, std::uint16_t(0xffff));
+			store_little_endian(records, std::uint16_t(0xffff));
+			store_little_endian(records, std::uint32_t(0xffffffff));
+			store_little_endian(records, std::uint32_t(0xffffffff));
+			store_little_endian(records, std::uint16_t(0));
+			append(records);
+			file = detail::file_descriptor{};
+		}
+	}; // End of class npz_writer.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_NPY_H.
@@ -0,0 +1,326 @@
+/*
+ * Matrix maths: orthogonal transformations.
+ *
+ * Givens rotations of pairs of rows, Householder reflectors, and the compact WY representation
+ * of a product of reflectors (Q = I - V T Vᵀ), through which a block of reflectors is applied
+ * to a matrix by matrix products rather than one reflector at a time. These are the building
+ * blocks of the QR factorization, which is provided here in unblocked and blocked forms.
+ *
+ * Reflectors are stored as LAPACK stores them: the reflector that annihilates column col below
+ * row row has v[row] = 1 implicitly, and v[row+1...] stored in that column below the diagonal.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_ORTHOGONAL_H
+#define CROWSTON_MATRIX_ORTHOGONAL_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	//
+	// Givens rotations.
+	//
+	// The rotation [c s; -s c] takes (a, b) to (r, 0).
+	//
+	template <typename T = default_T>
+	struct givens_rotation
+	{
+		T c;
+		T s;
+		T r;
+
+		// Construction. The square root is taken directly where the squares can neither overflow
+		// nor underflow, and through std::hypot otherwise.
+		static givens_rotation make(const T a, const T b) noexcept
+		{
+			if (b == T(0))
+				return {T(1), T(0), a};
+			if (a == T(0))
+				return {T(0), std::copysign(T(1), b), std::abs(b)};
+
+			const T safe_min = std::sqrt(std::numeric_limits<T>::min());
+			const T safe_max = std::sqrt(std::numeric_limits<T>::max() / 2);
+			const T abs_a = std::abs(a);
+			const T abs_b = std::abs(b);
+			const T length = (abs_a > safe_min && abs_a < safe_max && abs_b > safe_min && abs_b < safe_max)
+				? std::sqrt(a * a + b * b)
+				: std::hypot(a, b);
+			const T r = std::copysign(length, a);
+			return {a / r, b / r, r};
+		}
+
+		// Application to a pair of rows, from element first onward: x = c x + s y, y = c y - s x.
+		void apply(T* const x, T* const y, const index_t first, const index_t last) const noexcept
+		{
+			for (index_t i = first; i < last; ++i)
+			{
+				const T x_i = x[i];
+				const T y_i = y[i];
+				x[i] = c * x_i + s * y_i;
+				y[i] = c * y_i - s * x_i;
+			}
+		}
+		template <index_t Width>
+		void apply(row<Width, T>& x, row<Width, T>& y, const index_t first = 0) const noexcept
+		{
+			apply(x.data(), y.data(), first, Width);
+		}
+
+		// Application from the right, to columns i and j.
+		template <index_t Height, index_t Width>
+		void apply_to_columns(const matrix_view<Height, Width, T> a, const index_t i, const index_t j) const noexcept
+		{
+			for (index_t r = 0; r < Height; ++r)
+			{
+				const T x = a[r][i];
+				const T y = a[r][j];
+				a[r][i] = c * x + s * y;
+				a[r][j] = c * y - s * x;
+			}
+		}
+	};
+
+	//
+	// Householder reflectors.
+	//
+
+	// Generates the reflector H = I - tau v vᵀ with H x = (beta, 0, ..., 0)ᵀ, for x the part of
+	// column col of a from row row down. x is overwritten by beta and v[row+1...]. Returns tau,
+	// which is zero (H = I) if x is already zero below its first element.
+	template <index_t Height, index_t Width, typename T>
+	T make_householder(const matrix_view<Height, Width, T> a, const index_t row, const index_t col) noexcept
+	{
+		// Norm of x below its first element, scaled against overflow.
+		T scale = 0;
+		for (index_t r = row+1; r < Height; ++r)
+			scale = std::max(scale, std::abs(a[r][col]));
+		if (scale == T(0))
+			return T(0);
+		T sum = 0;
+		for (index_t r = row+1; r < Height; ++r)
+		{
+			const T x = a[r][col] / scale;
+			sum += x * x;
+		}
+		const T norm = scale * std::sqrt(sum);
+
+		const T alpha = a[row][col];
+		const T beta = -std::copysign(std::hypot(alpha, norm), alpha);
+		const T tau = (beta - alpha) / beta;
+		const T reciprocal = T(1) / (alpha - beta);
+		for (index_t r = row+1; r < Height; ++r)
+			a[r][col] *= reciprocal;
+		a[row][col] = beta;
+		return tau;
+	}
+
+	// Applies the reflector stored in column col of v below row, from the left, to rows row...
+	// and columns [first_col, last_col) of c.
+	template <index_t Height, index_t Width, index_t CWidth, typename T>
+	void apply_householder(const const_matrix_view<Height, Width, T> v, const index_t row, const index_t col,
+		const T tau, const matrix_view<Height, CWidth, T> c, const index_t first_col = 0, const index_t last_col = CWidth) noexcept
+	{
+		if (tau == T(0))
+			return;
+		// w = vᵀ C, accumulated row by row; then C -= tau v w.
+		std::array<T, CWidth> w {};
+		for (index_t j = first_col; j < last_col; ++j)
+			w[j] = c[row][j];
+		for (index_t r = row+1; r < Height; ++r)
+		{
+			const T v_r = v[r][col];
+			for (index_t j = first_col; j < last_col; ++j)
+				w[j] = multiply_add(v_r, c[r][j], w[j]);
+		}
+		for (index_t j = first_col; j < last_col; ++j)
+			c[row][j] -= tau * w[j];
+		for (index_t r = row+1; r < Height; ++r)
+		{
+			const T factor = -tau * v[r][col];
+			for (index_t j = first_col; j < last_col; ++j)
+				c[r][j] = multiply_add(factor, w[j], c[r][j]);
+		}
+	}
+
+	//
+	// Compact WY representation.
+	//
+	// For count reflectors stored in columns col... of v, starting at row col, finds the upper
+	// triangular T with H(col) H(col+1) ... H(col+count-1) = I - V T Vᵀ. Only the leading
+	// count x count part of the result is meaningful.
+	//
+	template <index_t BlockSize, index_t Height, index_t Width, typename T>
+	auto compact_wy_factor(const const_matrix_view<Height, Width, T> v, const index_t col, const index_t count,
+		const T* const tau) noexcept
+		-> matrix<BlockSize, BlockSize, T>
+	{
+		matrix<BlockSize, BlockSize, T> t {};
+		std::array<T, BlockSize> z;
+		for (index_t i = 0; i < count; ++i)
+		{
+			t[i][i] = tau[i];
+			if (tau[i] == T(0))
+				continue;
+
+			// z = V[:, 0:i]ᵀ v_i.
+			const index_t start = col + i;
+			for (index_t k = 0; k < i; ++k)
+				z[k] = v[start][col+k];
+			for (index_t r = start+1; r < Height; ++r)
+			{
+				const T v_r = v[r][start];
+				for (index_t k = 0; k < i; ++k)
+					z[k] = multiply_add(v[r][col+k], v_r, z[k]);
+			}
+			// T[0:i, i] = -tau_i T[0:i, 0:i] z.
+			for (index_t k = 0; k < i; ++k)
+			{
+				T sum = 0;
+				for (index_t m = k; m < i; ++m)
+					sum = multiply_add(t[k][m], z[m], sum);
+				t[k][i] = -tau[i] * sum;
+			}
+		}
+		return t;
+	}
+
+	// Applies I - V T Vᵀ (or, if transpose is set, its transpose) from the left to rows col... and
+	// columns [first_col, last_col) of c. The reflectors are as for compact_wy_factor(). The 
+	// columns of c are taken in tiles narrow enough that the intermediate product stays in L1.
+	template <index_t BlockSize, index_t Height, index_t Width, index_t CWidth, typename T>
+	void apply_compact_wy(const const_matrix_view<Height, Width, T> v, const index_t col, const index_t count,
+		const matrix<BlockSize, BlockSize, T>& t, const matrix_view<Height, CWidth, T> c,
+		const index_t first_col, const index_t last_col, const bool transpose) noexcept
+	{
+		constexpr index_t tile_width = 64;
+		std::array<std::array<T, tile_width>, BlockSize> w;
+
+		for (index_t tile = first_col; tile < last_col; tile += tile_width)
+		{
+			const index_t width = std::min(tile_width, last_col - tile);
+
+			// W = Vᵀ C.
+			for (index_t k = 0; k < count; ++k)
+				std::copy_n(c[col+k] + tile, width, w[k].begin());
+			for (index_t r = col+1; r < Height; ++r)
+			{
+				const T* const c_r = c[r] + tile;
+				const index_t k_end = std::min(count, r - col);
+				for (index_t k = 0; k < k_end; ++k)
+				{
+					const T v_rk = v[r][col+k];
+					for (index_t j = 0; j < width; ++j)
+						w[k][j] = multiply_add(v_rk, c_r[j], w[k][j]);
+				}
+			}
+
+			// W = Tᵀ W or T W, in place, exploiting the triangularity of T.
+			auto scale_and_add = [&w, &t, width](const index_t k, const index_t m_first, const index_t m_last, const bool by_column)
+			{
+				for (index_t j = 0; j < width; ++j)
+					w[k][j] *= t[k][k];
+				for (index_t m = m_first; m < m_last; ++m)
+				{
+					const T factor = by_column ? t[m][k] : t[k][m];
+					for (index_t j = 0; j < width; ++j)
+						w[k][j] = multiply_add(factor, w[m][j], w[k][j]);
+				}
+			};
+			if (transpose)
+				for (index_t k = count; k-- > 0; )
+					scale_and_add(k, 0, k, true);
+			else
+				for (index_t k = 0; k < count; ++k)
+					scale_and_add(k, k+1, count, false);
+
+			// C = C - V W.
+			for (index_t r = col; r < Height; ++r)
+			{
+				T* const c_r = c[r] + tile;
+				const index_t k_end = std::min(count, r - col + 1);
+				for (index_t k = 0; k < k_end; ++k)
+				{
+					const T factor = (r == col + k) ? T(-1) : -v[r][col+k];
+					for (index_t j = 0; j < width; ++j)
+						c_r[j] = multiply_add(factor, w[k][j], c_r[j]);
+				}
+			}
+		}
+	}
+
+	//
+	// QR factorization, A = Q R, for Height >= Width.
+	//
+	// On return, R is in the upper triangle of a, and the reflectors whose product is Q below it,
+	// with their scale factors in tau. The blocked form factors panels of BlockSize columns one
+	// reflector at a time, and applies each panel to the rest of the matrix in compact WY form.
+	//
+	template <index_t Height, index_t Width, typename T>
+	void householder_qr_unblocked(const matrix_view<Height, Width, T> a, std::array<T, Width>& tau,
+		const index_t first_col = 0, const index_t last_col = Width) noexcept
+	{
+		static_assert(Height >= Width, "QR factorization requires at least as many rows as columns.");
+		for (index_t j = first_col; j < last_col; ++j)
+		{
+			tau[j] = make_householder(a, j, j);
+			apply_householder<Height, Width, Width, T>(a, j, j, tau[j], a, j+1, last_col);
+		}
+	}
+
+	template <index_t BlockSize = 32, index_t Height, index_t Width, typename T>
+	void householder_qr(const matrix_view<Height, Width, T> a, std::array<T, Width>& tau) noexcept
+	{
+		static_assert(Height >= Width, "QR factorization requires at least as many rows as columns.");
+		for (index_t j = 0; j < Width; j += BlockSize)
+		{
+			const index_t count = std::min(BlockSize, Width - j);
+			householder_qr_unblocked(a, tau, j, j + count);
+			if (j + count < Width)
+			{
+				const auto t = compact_wy_factor<BlockSize, Height, Width, T>(a, j, count, &tau[j]);
+				apply_compact_wy<BlockSize, Height, Width, Width, T>(a, j, count, t, a, j + count, Width, true);
+			}
+		}
+	}
+
+	template <index_t BlockSize = 32, index_t Height, index_t Width, typename T>
+	void householder_qr(matrix<Height, Width, T>& a, std::array<T, Width>& tau) noexcept
+	{
+		householder_qr<BlockSize>(a.view(), tau);
+	}
+
+	// Applies Q (or, if transpose is set, Qᵀ) of a QR factorization to c, from the left.
+	template <index_t BlockSize = 32, index_t Height, index_t Width, index_t CWidth, typename T>
+	void apply_q(const const_matrix_view<Height, Width, T> qr, const std::array<T, Width>& tau,
+		const matrix_view<Height, CWidth, T> c, const bool transpose) noexcept
+	{
+		// Qᵀ = ... H(1) H(0) applies the blocks first to last; Q applies them last to first.
+		const index_t block_count = (Width + BlockSize - 1) / BlockSize;
+		for (index_t b = 0; b < block_count; ++b)
+		{
+			const index_t j = (transpose ? b : block_count - 1 - b) * BlockSize;
+			const index_t count = std::min(BlockSize, Width - j);
+			const auto t = compact_wy_factor<BlockSize, Height, Width, T>(qr, j, count, &tau[j]);
+			apply_compact_wy<BlockSize, Height, Width, CWidth, T>(qr, j, count, t, c, 0, CWidth, transpose);
+		}
+	}
+
+	template <index_t BlockSize = 32, index_t Height, index_t Width, index_t CWidth, typename T>
+	void apply_q(const matrix<Height, Width, T>& qr, const std::array<T, Width>& tau,
+		matrix<Height, CWidth, T>& c, const bool transpose) noexcept
+	{
+		apply_q<BlockSize>(qr.view(), tau, c.view(), transpose);
+	}
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_ORTHOGONAL_H.
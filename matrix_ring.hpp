@@ -0,0 +1,407 @@
+/*
+ * Matrix maths: shared memory rings.
+ *
+ * A matrix_ring is a ring of fixed-size matrix slots in a POSIX shared memory segment, through
+ * which processes pass matrices without copying them. Each slot goes through three stages in
+ * turn, each stage belonging to one process (or thread): a producer writes matrices into free
+ * slots and publishes them; an inverter inverts the published matrices in place, recording
+ * whether each was inverted; and a collector reads the results and releases the slots to the
+ * producer again. The producer and the collector are often the same process.
+ *
+ * The stages hand slots on by advancing three positions, each written by its own stage alone,
+ * so no locks are taken. A stage that finds nothing to do spins briefly, then sleeps on a futex
+ * until the stage before it advances (or, elsewhere than Linux, polls).
+ *
+ * The segment holds a header describing the matrices, then the slots, then a status byte for
+ * each slot. Nothing in it is specific to one process, so it can be mapped anywhere. Nothing
+ * notices the death of a process using the ring; the others wait for it indefinitely.
+ *
+ *
+ * Requires C++14 or later and POSIX. Link with -lrt where shm_open() needs it.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_RING_H
+#define CROWSTON_MATRIX_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "matrix_io.hpp"
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	//
+	// Exceptions.
+	//
+	struct matrix_ring_error : public std::runtime_error
+	{
+		explicit matrix_ring_error(const std::string& what) : std::runtime_error(what) {}
+		virtual ~matrix_ring_error() {}
+	};
+
+	static_assert(ATOMIC_INT_LOCK_FREE == 2, "Positions must be lock-free to be shared between processes.");
+
+	// The number of times a stage looks for work before it sleeps.
+	constexpr unsigned ring_spin_count = 128;
+
+	// A position in the ring, counting slots from the creation of the ring, modulo 2³². Waiters
+	// sleep on wakeups, which is incremented whenever the position advances or the ring is
+	// closed, so that no wakeup is lost between a waiter's last look and its sleep.
+	struct ring_position
+	{
+		std::atomic<std::uint32_t> position;
+		std::atomic<std::uint32_t> wakeups;
+		std::atomic<std::uint32_t> waiters;
+	};
+
+	struct ring_header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t capacity;
+		// The matrices, as a batch file describes them; its count is the capacity.
+		batch_file_header matrices;
+
+		// Each position on its own cache line, so that the stages do not contend.
+		alignas(64) ring_position produced;
+		alignas(64) ring_position inverted;
+		alignas(64) ring_position released;
+		alignas(64) std::atomic<std::uint32_t> closed;
+
+		static constexpr char expected_magic[8] = {'M', 'T', 'X', 'R', 'I', 'N', 'G', '1'};
+		static constexpr std::uint32_t current_version = 1;
+	};
+
+	constexpr char ring_header::expected_magic[8];
+	constexpr std::uint32_t ring_header::current_version;
+
+	// The slots begin on the page after the header.
+	constexpr std::size_t ring_header_size = 4096;
+	static_assert(sizeof(ring_header) <= ring_header_size, "The header must fit its space.");
+
+	namespace detail
+	{
+		inline void wake(ring_position& index) noexcept
+		{
+			index.wakeups.fetch_add(1);
+#ifdef __linux__
+			if (index.waiters.load() != 0)
+				::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&index.wakeups), FUTEX_WAKE, INT_MAX,
+					nullptr, nullptr, 0);
+#endif
+		}
+
+		// Waits until ready(position) holds, returning the position last seen.
+		template <typename Predicate>
+		std::uint32_t wait_for(ring_position& index, Predicate ready) noexcept
+		{
+			for (unsigned spin = 0; spin < ring_spin_count; ++spin)
+			{
+				const std::uint32_t position = index.position.load(std::memory_order_acquire);
+				if (ready(position))
+					return position;
+			}
+			for (;;)
+			{
+				index.waiters.fetch_add(1);
+				const std::uint32_t wakeups = index.wakeups.load();
+				const std::uint32_t position = index.position.load();
+				if (ready(position))
+				{
+					index.waiters.fetch_sub(1);
+					return position;
+				}
+#ifdef __linux__
+				::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&index.wakeups), FUTEX_WAIT, wakeups,
+					nullptr, nullptr, 0);
+#else
+				(void)wakeups;
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+#endif
+				index.waiters.fetch_sub(1);
+			}
+		}
+	} // End namespace detail.
+
+	template <index_t Height, index_t Width, typename T = default_T>
+	class matrix_ring
+	{
+		public:
+		using matrix_t = matrix<Height, Width, T>;
+		static_assert(std::is_trivially_copyable<matrix_t>::value, "Matrices are shared as bytes.");
+
+		// Consecutive slots, and their status bytes.
+		struct span
+		{
+			matrix_t* first;
+			std::uint8_t* status;
+			index_t count;
+
+			matrix_t* begin() const noexcept { return first; }
+			matrix_t* end() const noexcept { return first + count; }
+			index_t size() const noexcept { return count; }
+			bool empty() const noexcept { return count == 0; }
+		};
+
+		private:
+		void* segment = MAP_FAILED;
+		std::size_t length = 0;
+		ring_header* header = nullptr;
+		matrix_t* slots = nullptr;
+		std::uint8_t* statuses = nullptr;
+		index_t slot_count = 0;
+
+		static std::size_t segment_size(const index_t capacity) noexcept
+		{
+			return ring_header_size + capacity * sizeof(matrix_t) + capacity;
+		}
+
+		matrix_ring(const int fd, const std::size_t length) : length(length)
+		{
+			segment = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (segment == MAP_FAILED)
+				detail::throw_errno("mmap");
+			header = static_cast<ring_header*>(segment);
+		}
+
+		void attach() noexcept
+		{
+			slot_count = header->capacity;
+			slots = reinterpret_cast<matrix_t*>(static_cast<char*>(segment) + ring_header_size);
+			statuses = reinterpret_cast<std::uint8_t*>(slots + slot_count);
+		}
+
+		// The slots from position onwards, up to count of them but not past the end of the ring.
+		span slots_at(const std::uint32_t position, const index_t count) const noexcept
+		{
+			const index_t slot = position % slot_count;
+			return span{slots + slot, statuses + slot, std::min(count, slot_count - slot)};
+		}
+
+		public:
+		// Creates a ring of capacity slots in a new shared memory segment called name, which
+		// begins with a slash. The capacity must be a power of two, so that positions wrap around
+		// the ring and 2³² together.
+		static matrix_ring create(const std::string& name, const index_t capacity)
+		{
+			if (capacity == 0 || capacity > (index_t(1) << 30) || (capacity & (capacity - 1)) != 0)
+				throw matrix_ring_error("Ring capacity must be a power of two no greater than 2^30.");
+			const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fd < 0)
+				detail::throw_errno(name.c_str());
+			const detail::file_descriptor file{fd};
+			if (::ftruncate(fd, off_t(segment_size(capacity))) != 0)
+			{
+				::shm_unlink(name.c_str());
+				detail::throw_errno("ftruncate");
+			}
+
+			auto ring = [&]
+			{
+				try { return matrix_ring(fd, segment_size(capacity)); }
+				catch (...) { ::shm_unlink(name.c_str()); throw; }
+			}();
+			ring_header* const header = new (ring.segment) ring_header{};
+			std::copy_n(ring_header::expected_magic, sizeof(header->magic), header->magic);
+			header->version = ring_header::current_version;
+			header->capacity = std::uint32_t(capacity);
+			header->matrices = batch_file_header::make<Height, Width, T>(capacity);
+			ring.attach();
+			return ring;
+		}
+
+		// Maps the existing ring called name, which must hold matrices of this type.
+		static matrix_ring open(const std::string& name)
+		{
+			const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+			if (fd < 0)
+				detail::throw_errno(name.c_str());
+			const detail::file_descriptor file{fd};
+			struct stat status;
+			if (::fstat(fd, &status) != 0)
+				detail::throw_errno("fstat");
+			if (std::size_t(status.st_size) < ring_header_size)
+				throw matrix_ring_error("Shared memory segment is not a matrix ring.");
+
+			matrix_ring ring(fd, std::size_t(status.st_size));
+			const ring_header& header = *ring.header;
+			if (!std::equal(header.magic, header.magic + sizeof(header.magic), ring_header::expected_magic) ||
+				header.version != ring_header::current_version)
+				throw matrix_ring_error("Shared memory segment is not a matrix ring.");
+			if (header.capacity == 0 || header.capacity > (std::uint32_t(1) << 30) ||
+				(header.capacity & (header.capacity - 1)) != 0)
+				throw matrix_ring_error("Matrix ring capacity is not a power of two no greater than 2^30.");
+			if (!header.matrices.holds<Height, Width, T>() || header.matrices.encoding != batch_encoding::raw ||
+				segment_size(header.capacity) > ring.length)
+				throw matrix_ring_error("Matrix ring does not hold matrices of this type.");
+			ring.attach();
+			return ring;
+		}
+
+		// Removes the name of a ring. Processes that have it mapped may go on using it.
+		static void remove(const std::string& name) noexcept
+		{
+			::shm_unlink(name.c_str());
+		}
+
+		matrix_ring(matrix_ring&& other) noexcept
+			: segment(other.segment), length(other.length), header(other.header), slots(other.slots),
+			statuses(other.statuses), slot_count(other.slot_count)
+		{
+			other.segment = MAP_FAILED;
+		}
+		matrix_ring(const matrix_ring&) = delete;
+		matrix_ring& operator= (const matrix_ring&) = delete;
+		~matrix_ring()
+		{
+			if (segment != MAP_FAILED)
+				::munmap(segment, length);
+		}
+
+		index_t capacity() const noexcept { return slot_count; }
+
+		// Whether close() has been called.
+		bool closed() const noexcept { return header->closed.load(std::memory_order_acquire) != 0; }
+
+		// Ends the stream of matrices: stages waiting for more return empty spans once they have
+		// had everything before. Called by the producer.
+		void close() noexcept
+		{
+			header->closed.store(1);
+			detail::wake(header->produced);
+			detail::wake(header->inverted);
+			detail::wake(header->released);
+		}
+
+		//
+		// Producer.
+		//
+
+		// Free slots to write up to most matrices into, waiting for one if need be and wait is
+		// set. Empty if the ring is closed or, without wait, full.
+		span claim(const index_t most = std::numeric_limits<index_t>::max(), const bool wait = true) noexcept
+		{
+			const std::uint32_t produced = header->produced.position.load(std::memory_order_relaxed);
+			const auto has_room = [&](const std::uint32_t released) { return produced - released < slot_count; };
+			std::uint32_t released = header->released.position.load(std::memory_order_acquire);
+			if (!has_room(released) && wait)
+				released = detail::wait_for(header->released,
+					[&](const std::uint32_t position) { return has_room(position) || closed(); });
+			if (!has_room(released) || closed())
+				return span{nullptr, nullptr, 0};
+			return slots_at(produced, std::min<index_t>(most, slot_count - (produced - released)));
+		}
+
+		// Passes the first count claimed slots to the inverter.
+		void publish(const index_t count) noexcept
+		{
+			const std::uint32_t produced = header->produced.position.load(std::memory_order_relaxed);
+			header->produced.position.store(produced + std::uint32_t(count));
+			detail::wake(header->produced);
+		}
+
+		// Copies a matrix into the ring, waiting for a free slot. Returns false if the ring is
+		// closed.
+		bool push(const matrix_t& mtx) noexcept
+		{
+			const span free = claim(1);
+			if (free.empty())
+				return false;
+			*free.first = mtx;
+			publish(1);
+			return true;
+		}
+
+		//
+		// Inverter.
+		//
+
+		// Published matrices, up to most of them, waiting for one if need be and wait is set.
+		// Empty once the ring is closed and every matrix published has been inverted.
+		span pending(const index_t most = std::numeric_limits<index_t>::max(), const bool wait = true) noexcept
+		{
+			const std::uint32_t inverted = header->inverted.position.load(std::memory_order_relaxed);
+			const auto has_work = [&](const std::uint32_t produced) { return produced != inverted; };
+			std::uint32_t produced = header->produced.position.load(std::memory_order_acquire);
+			if (!has_work(produced) && wait)
+				produced = detail::wait_for(header->produced,
+					[&](const std::uint32_t position) { return has_work(position) || closed(); });
+			return slots_at(inverted, std::min<index_t>(most, produced - inverted));
+		}
+
+		// Passes the first count pending slots, with their status set, to the collector.
+		void complete(const index_t count) noexcept
+		{
+			const std::uint32_t inverted = header->inverted.position.load(std::memory_order_relaxed);
+			header->inverted.position.store(inverted + std::uint32_t(count));
+			detail::wake(header->inverted);
+		}
+
+		// Inverts the pending matrices in place, as invert_batch() does, sets their status to
+		// whether each was inverted, and passes them on. Returns the number of matrices passed on,
+		// which is zero only once the ring is closed and drained (or, without wait, idle).
+		index_t invert_pending(const bool wait = true, const bool screen = false) noexcept
+		{
+			const span work = pending(std::numeric_limits<index_t>::max(), wait);
+			if (work.empty())
+				return 0;
+			invert_batch(work.begin(), work.end(), work.status, screen);
+			complete(work.size());
+			return work.size();
+		}
+
+		//
+		// Collector.
+		//
+
+		// Inverted matrices, up to most of them, waiting for one if need be and wait is set.
+		// Empty once the ring is closed and every matrix has been collected.
+		span results(const index_t most = std::numeric_limits<index_t>::max(), const bool wait = true) noexcept
+		{
+			const std::uint32_t released = header->released.position.load(std::memory_order_relaxed);
+			const auto has_results = [&](const std::uint32_t inverted) { return inverted != released; };
+			std::uint32_t inverted = header->inverted.position.load(std::memory_order_acquire);
+			// Once the ring is closed, the inverter may still have matrices to finish.
+			if (!has_results(inverted) && wait)
+				inverted = detail::wait_for(header->inverted, [&](const std::uint32_t position)
+				{
+					return has_results(position) ||
+						(closed() && header->produced.position.load(std::memory_order_acquire) == position);
+				});
+			return slots_at(released, std::min<index_t>(most, inverted - released));
+		}
+
+		// Returns the first count collected slots to the producer.
+		void release(const index_t count) noexcept
+		{
+			const std::uint32_t released = header->released.position.load(std::memory_order_relaxed);
+			header->released.position.store(released + std::uint32_t(count));
+			detail::wake(header->released);
+		}
+	}; // End of class matrix_ring.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_RING_H.
@@ -0,0 +1,467 @@
+/*
+ * Matrix maths: time series of matrices.
+ *
+ * A series file records a sequence of matrices of the same dimensions and element type, such as
+ * the state of a simulation at every step, where each matrix differs from the one before in only
+ * a few elements. Most steps are stored as a delta: the elements that changed, each as the
+ * exclusive or of its old and new bit patterns, with the bytes that are zero at either end left
+ * out. Every keyframe_interval steps, and whenever a delta would be no smaller, the whole matrix
+ * is stored instead, as a keyframe.
+ *
+ * The file is a header, then one record per step, then an index of the keyframes and a trailer
+ * that locates it. A step is found by looking up the last keyframe at or before it in the index,
+ * then applying the deltas that follow, directly to the storage of the matrix being decoded. A
+ * file whose writer did not close it has no index; the reader rebuilds one by scanning the
+ * records, and ignores any record that is incomplete.
+ *
+ * Matrices are stored in the byte order of the machine that wrote them, as in batch files.
+ *
+ *
+ * Requires C++14 or later and POSIX.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_SERIES_H
+#define CROWSTON_MATRIX_SERIES_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "matrix_io.hpp"
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	//
+	// Exceptions.
+	//
+	struct series_file_error : public std::runtime_error
+	{
+		explicit series_file_error(const std::string& what) : std::runtime_error(what) {}
+		virtual ~series_file_error() {}
+	};
+
+	//
+	// Series file format.
+	//
+	constexpr std::size_t series_header_size = 64;
+
+	struct series_file_header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t element_size;
+		element_kind kind;
+		std::uint32_t reserved;
+		std::uint64_t height;
+		std::uint64_t width;
+
+		static constexpr char expected_magic[8] = {'M', 'T', 'X', 'S', 'E', 'R', 'I', 'E'};
+		static constexpr std::uint32_t current_version = 1;
+
+		template <index_t Height, index_t Width, typename T>
+		static series_file_header make() noexcept
+		{
+			const auto batch = batch_file_header::make<Height, Width, T>(0);
+			series_file_header header {};
+			std::copy_n(expected_magic, sizeof(magic), header.magic);
+			header.version = current_version;
+			header.element_size = batch.element_size;
+			header.kind = batch.kind;
+			header.height = Height;
+			header.width = Width;
+			return header;
+		}
+
+		// Whether the file holds a series of matrix<Height, Width, T>.
+		template <index_t Height, index_t Width, typename T>
+		bool holds() const noexcept
+		{
+			const auto expected = make<Height, Width, T>();
+			return std::equal(magic, magic + sizeof(magic), expected_magic) && version == current_version &&
+				element_size == expected.element_size && kind == expected.kind &&
+				height == Height && width == Width;
+		}
+	}; // End of struct series_file_header.
+
+	constexpr char series_file_header::expected_magic[8];
+	constexpr std::uint32_t series_file_header::current_version;
+
+	struct series_index_entry
+	{
+		std::uint64_t step;
+		std::uint64_t offset;
+	};
+
+	struct series_file_trailer
+	{
+		std::uint64_t step_count;
+		std::uint64_t index_offset;
+		std::uint64_t keyframe_count;
+		char magic[8];
+
+		static constexpr char expected_magic[8] = {'M', 'T', 'X', 'I', 'N', 'D', 'E', 'X'};
+	};
+
+	constexpr char series_file_trailer::expected_magic[8];
+
+	static_assert(sizeof(series_file_header) <= series_header_size, "The header must fit its space.");
+
+	namespace detail
+	{
+		// Record types.
+		constexpr char series_keyframe = 0;
+		constexpr char series_delta = 1;
+
+		// Unsigned integers of each size, for the bit patterns of elements.
+		template <std::size_t Size> struct unsigned_of_size;
+		template <> struct unsigned_of_size<1> { using type = std::uint8_t; };
+		template <> struct unsigned_of_size<2> { using type = std::uint16_t; };
+		template <> struct unsigned_of_size<4> { using type = std::uint32_t; };
+		template <> struct unsigned_of_size<8> { using type = std::uint64_t; };
+
+		inline void put_varint(std::vector<char>& out, std::uint64_t value)
+		{
+			for ( ; value >= 0x80; value >>= 7)
+				out.push_back(char(value | 0x80));
+			out.push_back(char(value));
+		}
+		inline std::uint64_t get_varint(const char*& in, const char* const end)
+		{
+			std::uint64_t value = 0;
+			for (unsigned shift = 0; shift < 64; shift += 7)
+			{
+				if (in == end)
+					throw series_file_error("Series record is truncated.");
+				const unsigned byte = static_cast<unsigned char>(*in++);
+				value |= std::uint64_t(byte & 0x7f) << shift;
+				if (!(byte & 0x80))
+					return value;
+			}
+			throw series_file_error("Series record is corrupt.");
+		}
+	} // End namespace detail.
+
+	//
+	// Writes a series file, one step at a time. The file is complete once close() has been
+	// called, or the writer destroyed; until then it can still be read, without its index.
+	//
+	template <index_t Height, index_t Width, typename T = default_T>
+	class series_writer
+	{
+		using matrix_t = matrix<Height, Width, T>;
+		using bits_t = typename detail::unsigned_of_size<sizeof(T)>::type;
+		static_assert(sizeof(matrix_t) == Height * Width * sizeof(T), "Matrices must be unpadded.");
+
+		// Records are gathered into a buffer of this size before they are written.
+		static constexpr std::size_t buffer_size = 1 << 20;
+
+		detail::file_descriptor file;
+		std::uint64_t written = series_header_size;
+		std::vector<char> buffer, delta;
+		std::vector<series_index_entry> index;
+		matrix_t previous;
+		index_t interval;
+		index_t steps = 0;
+		index_t since_keyframe = 0;
+
+		void flush()
+		{
+			detail::write_fully(file.get(), buffer.data(), buffer.size(), off_t(written));
+			written += buffer.size();
+			buffer.clear();
+		}
+
+		// Codes the changes from previous to mtx into delta, unless that would take as much
+		// space as a keyframe.
+		bool code_delta(const matrix_t& mtx)
+		{
+			delta.clear();
+			const T* before = previous[0].data();
+			const T* after = mtx[0].data();
+			index_t changed = 0;
+			for (index_t i = 0; i < Height * Width; ++i)
+				changed += std::memcmp(before + i, after + i, sizeof(T)) != 0;
+			detail::put_varint(delta, changed);
+
+			index_t last = 0;
+			for (index_t i = 0; i < Height * Width && delta.size() < sizeof(matrix_t); ++i)
+			{
+				bits_t old_bits, new_bits;
+				std::memcpy(&old_bits, before + i, sizeof(T));
+				std::memcpy(&new_bits, after + i, sizeof(T));
+				bits_t difference = bits_t(old_bits ^ new_bits);
+				if (difference == 0)
+					continue;
+				detail::put_varint(delta, i - last);
+				last = i;
+				// The low zero bytes are skipped, and then as many bytes as are not zero above.
+				unsigned low = 0;
+				while ((difference & 0xff) == 0)
+				{
+					difference = bits_t(difference >> 8);
+					++low;
+				}
+				unsigned length = 0;
+				for (bits_t rest = difference; rest != 0; rest = bits_t(rest >> 8))
+					++length;
+				delta.push_back(char(low << 4 | length));
+				for (unsigned b = 0; b < length; ++b, difference = bits_t(difference >> 8))
+					delta.push_back(char(difference & 0xff));
+			}
+			return delta.size() < sizeof(matrix_t);
+		}
+
+		public:
+		// A writer that stores a keyframe at least every keyframe_interval steps.
+		explicit series_writer(const char* path, const index_t keyframe_interval = 64)
+			: file(detail::open_file(path, O_WRONLY | O_CREAT | O_TRUNC, false)),
+			interval(std::max<index_t>(keyframe_interval, 1))
+		{
+			char header[series_header_size] = {};
+			const auto fields = series_file_header::make<Height, Width, T>();
+			std::memcpy(header, &fields, sizeof(fields));
+			detail::write_fully(file.get(), header, sizeof(header), 0);
+			buffer.reserve(buffer_size);
+		}
+		series_writer(const series_writer&) = delete;
+		series_writer& operator= (const series_writer&) = delete;
+		~series_writer()
+		{
+			try { close(); } catch (...) { }
+		}
+
+		index_t size() const noexcept { return steps; }
+
+		void append(const matrix_t& mtx)
+		{
+			if (file.get() < 0)
+				throw series_file_error("The series file has been closed.");
+			const bool keyframe = steps == 0 || since_keyframe + 1 >= interval || !code_delta(mtx);
+			if (keyframe)
+			{
+				index.push_back(series_index_entry{steps, written + buffer.size()});
+				buffer.push_back(detail::series_keyframe);
+				detail::put_varint(buffer, sizeof(matrix_t));
+				const char* bytes = reinterpret_cast<const char*>(&mtx);
+				buffer.insert(buffer.end(), bytes, bytes + sizeof(matrix_t));
+				since_keyframe = 0;
+			}
+			else
+			{
+				buffer.push_back(detail::series_delta);
+				detail::put_varint(buffer, delta.size());
+				buffer.insert(buffer.end(), delta.begin(), delta.end());
+				++since_keyframe;
+			}
+			previous = mtx;
+			++steps;
+			if (buffer.size() >= buffer_size)
+				flush();
+		}
+
+		// Writes the index and closes the file.
+		void close()
+		{
+			if (file.get() < 0)
+				return;
+			flush();
+			series_file_trailer trailer{steps, written, index.size(), {}};
+			std::copy_n(series_file_trailer::expected_magic, sizeof(trailer.magic), trailer.magic);
+			const char* entries = reinterpret_cast<const char*>(index.data());
+			buffer.assign(entries, entries + index.size() * sizeof(series_index_entry));
+			const char* fields = reinterpret_cast<const char*>(&trailer);
+			buffer.insert(buffer.end(), fields, fields + sizeof(trailer));
+			flush();
+			file = detail::file_descriptor{};
+		}
+	}; // End of class series_writer.
+
+	template <index_t Height, index_t Width, typename T>
+	constexpr std::size_t series_writer<Height, Width, T>::buffer_size;
+
+	//
+	// Reads a series file, which it maps into memory.
+	//
+	template <index_t Height, index_t Width, typename T = default_T>
+	class series_reader
+	{
+		using matrix_t = matrix<Height, Width, T>;
+		using bits_t = typename detail::unsigned_of_size<sizeof(T)>::type;
+
+		std::unique_ptr<const detail::mapped_file> file;
+		const char* records = nullptr;
+		const char* records_end = nullptr;
+		std::vector<series_index_entry> index;
+		index_t steps = 0;
+
+		// Applies the record at p to mtx, returning the record that follows.
+		const char* apply(const char* p, matrix_t& mtx) const
+		{
+			if (p == records_end)
+				throw series_file_error("Series record is truncated.");
+			const char type = *p++;
+			const std::uint64_t length = detail::get_varint(p, records_end);
+			if (length > std::uint64_t(records_end - p))
+				throw series_file_error("Series record is truncated.");
+			const char* const end = p + length;
+			if (type == detail::series_keyframe)
+			{
+				if (length != sizeof(matrix_t))
+					throw series_file_error("Series keyframe is corrupt.");
+				std::memcpy(&mtx, p, sizeof(matrix_t));
+				return end;
+			}
+			if (type != detail::series_delta)
+				throw series_file_error("Series record is corrupt.");
+
+			T* const elements = mtx[0].data();
+			const std::uint64_t changed = detail::get_varint(p, end);
+			std::uint64_t position = 0;
+			for (std::uint64_t n = 0; n < changed; ++n)
+			{
+				position += detail::get_varint(p, end);
+				if (position >= Height * Width || p == end)
+					throw series_file_error("Series delta is corrupt.");
+				const unsigned low = static_cast<unsigned char>(*p) >> 4;
+				const unsigned length = static_cast<unsigned char>(*p++) & 0xf;
+				if (low + length > sizeof(T) || length > std::size_t(end - p))
+					throw series_file_error("Series delta is corrupt.");
+				bits_t difference = 0;
+				for (unsigned b = length; b-- > 0; )
+					difference = bits_t(difference << 8 | bits_t(static_cast<unsigned char>(p[b])));
+				p += length;
+				bits_t element;
+				std::memcpy(&element, elements + position, sizeof(T));
+				element = bits_t(element ^ bits_t(difference << (8 * low)));
+				std::memcpy(elements + position, &element, sizeof(T));
+			}
+			if (p != end)
+				throw series_file_error("Series delta is corrupt.");
+			return end;
+		}
+
+		// Rebuilds the index from the records, up to the last one that is complete.
+		void scan(const char* end)
+		{
+			records_end = end;
+			matrix_t scratch;
+			const char* p = records;
+			while (p != end)
+			{
+				const char* next;
+				try
+				{
+					if (*p == detail::series_keyframe)
+						index.push_back(series_index_entry{steps, std::uint64_t(p - file->data())});
+					else if (steps == 0)
+						throw series_file_error("Series does not begin with a keyframe.");
+					next = apply(p, scratch);
+				}
+				catch (const series_file_error&)
+				{
+					if (!index.empty() && index.back().step == steps)
+						index.pop_back();
+					break;
+				}
+				p = next;
+				++steps;
+			}
+			records_end = p;
+		}
+
+		public:
+		explicit series_reader(const char* path)
+			: file(new detail::mapped_file(path))
+		{
+			const char* const first = file->data();
+			const std::size_t size = file->size();
+			series_file_header header;
+			if (size < series_header_size)
+				throw series_file_error("Not a series file.");
+			std::memcpy(&header, first, sizeof(header));
+			if (!header.holds<Height, Width, T>())
+				throw series_file_error("Series file does not hold matrices of this type.");
+			records = first + series_header_size;
+
+			series_file_trailer trailer;
+			if (size >= series_header_size + sizeof(trailer))
+				std::memcpy(&trailer, first + size - sizeof(trailer), sizeof(trailer));
+			const bool indexed = size >= series_header_size + sizeof(trailer) &&
+				std::equal(trailer.magic, trailer.magic + sizeof(trailer.magic), series_file_trailer::expected_magic) &&
+				trailer.index_offset >= series_header_size && trailer.index_offset <= size - sizeof(trailer) &&
+				trailer.keyframe_count <= (size - sizeof(trailer) - trailer.index_offset) / sizeof(series_index_entry);
+			if (!indexed)
+			{
+				scan(first + size);
+				return;
+			}
+
+			steps = trailer.step_count;
+			records_end = first + trailer.index_offset;
+			index.resize(trailer.keyframe_count);
+			std::memcpy(index.data(), records_end, index.size() * sizeof(series_index_entry));
+			// get() and for_each() search the index by step, so it must be in order.
+			for (index_t k = 0; k < index.size(); ++k)
+				if (index[k].offset < series_header_size || index[k].offset >= trailer.index_offset ||
+					index[k].step >= steps || (k > 0 && index[k].step <= index[k - 1].step))
+					throw series_file_error("Series index is corrupt.");
+			if (steps > 0 && (index.empty() || index.front().step != 0))
+				throw series_file_error("Series index is corrupt.");
+		}
+
+		// Accessors.
+		index_t size() const noexcept { return steps; }
+		index_t keyframe_count() const noexcept { return index.size(); }
+
+		// Decodes the matrix at step into mtx.
+		void get(const index_t step, matrix_t& mtx) const
+		{
+			if (step >= steps)
+				throw std::out_of_range("No such step in the series.");
+			auto keyframe = std::upper_bound(index.begin(), index.end(), step,
+				[](const index_t s, const series_index_entry& entry) { return s < entry.step; });
+			--keyframe;
+			const char* p = file->data() + keyframe->offset;
+			for (index_t s = keyframe->step; s <= step; ++s)
+				p = apply(p, mtx);
+		}
+		auto get(const index_t step) const
+			-> matrix_t
+		{
+			matrix_t mtx;
+			get(step, mtx);
+			return mtx;
+		}
+
+		// Calls fn(step, mtx) for each step in [first, last), decoding each from the one before.
+		template <typename Function>
+		void for_each(const index_t first, const index_t last, Function fn) const
+		{
+			if (first >= last)
+				return;
+			if (last > steps)
+				throw std::out_of_range("No such step in the series.");
+			matrix_t mtx;
+			auto keyframe = std::upper_bound(index.begin(), index.end(), first,
+				[](const index_t s, const series_index_entry& entry) { return s < entry.step; });
+			--keyframe;
+			const char* p = file->data() + keyframe->offset;
+			for (index_t s = keyframe->step; s < last; ++s)
+			{
+				p = apply(p, mtx);
+				if (s >= first)
+					fn(s, static_cast<const matrix_t&>(mtx));
+			}
+		}
+	}; // End of class series_reader.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_SERIES_H.
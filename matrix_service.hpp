@@ -0,0 +1,722 @@
+/*
+ * Matrix maths: local inversion service.
+ *
+ * A matrix_server listens on a Unix domain socket for requests to invert square matrices, or to
+ * solve linear systems, of one size and element type, and matrix_clients send them. The server
+ * coalesces the matrices of requests that arrive close together, from any number of clients, into
+ * one batch, so that many small processes share a single engine working on large batches. How long
+ * the server holds the first request of a batch for others to join it is its batching window: a
+ * wider window makes larger batches, at the cost of latency. The window closes early once every
+ * connected client has a request in the batch.
+ *
+ * A request is a service_request_header followed by its matrices (for solve, each matrix followed
+ * by its right-hand side). A reply is a service_reply_header, then a status byte for each matrix,
+ * padded to a multiple of eight bytes, then the inverses or solutions. Numbers are in the byte
+ * order of the host, which the server and its clients share. A request for matrices of another
+ * size or element type is answered with service_status::unsupported; one too large, or not a
+ * request at all, is answered with service_status::refused, and the connection is closed.
+ *
+ *
+ * Requires C++14 or later and Linux (for ppoll() and accept4()).
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_SERVICE_H
+#define CROWSTON_MATRIX_SERVICE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "matrix_io.hpp"
+#include "matrix_lu.hpp"
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	//
+	// Exceptions.
+	//
+	struct service_error : public std::runtime_error
+	{
+		explicit service_error(const std::string& what) : std::runtime_error(what) {}
+		virtual ~service_error() {}
+	};
+
+	//
+	// Protocol.
+	//
+	enum class service_operation : std::uint32_t
+	{
+		invert = 1,
+		solve = 2
+	};
+
+	enum class service_status : std::uint32_t
+	{
+		ok = 0,
+		unsupported = 1,
+		refused = 2
+	};
+
+	struct service_request_header
+	{
+		char magic[4];
+		std::uint32_t element_size;
+		service_operation operation;
+		std::uint32_t size;
+		std::uint64_t count;
+		std::uint64_t id;
+
+		static constexpr char expected_magic[4] = {'M', 'T', 'X', 'Q'};
+	};
+
+	struct service_reply_header
+	{
+		char magic[4];
+		service_status status;
+		std::uint64_t count;
+		std::uint64_t id;
+
+		static constexpr char expected_magic[4] = {'M', 'T', 'X', 'R'};
+	};
+
+	constexpr char service_request_header::expected_magic[4];
+	constexpr char service_reply_header::expected_magic[4];
+
+	struct service_options
+	{
+		// How long the first request of a batch may wait for others to join it. With a window of
+		// zero, a batch holds whatever arrived together.
+		std::chrono::microseconds window{100};
+		// A batch is processed as soon as it holds this many matrices, whatever the window.
+		index_t max_batch = 4096;
+		// Threads among which each batch is divided, in blocks of parallel_block matrices. The
+		// server keeps them for its lifetime.
+		unsigned thread_count = 1;
+		index_t parallel_block = 256;
+		// The most matrices one request may carry.
+		index_t max_request = index_t(1) << 20;
+	};
+
+	struct service_statistics
+	{
+		std::uint64_t requests;
+		std::uint64_t matrices;
+		std::uint64_t batches;
+	};
+
+	namespace detail
+	{
+		inline sockaddr_un socket_address(const std::string& path)
+		{
+			sockaddr_un address {};
+			if (path.size() >= sizeof(address.sun_path))
+				throw service_error("Socket path is too long.");
+			address.sun_family = AF_UNIX;
+			std::copy(path.begin(), path.end(), address.sun_path);
+			return address;
+		}
+
+		// Sends all of the given buffers, blocking.
+		inline void send_fully(const int fd, iovec* parts, int part_count)
+		{
+			while (part_count > 0)
+			{
+				msghdr message {};
+				message.msg_iov = parts;
+				message.msg_iovlen = std::size_t(part_count);
+				ssize_t sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+				if (sent < 0 && errno == EINTR)
+					continue;
+				if (sent < 0)
+					throw_errno("sendmsg");
+				while (part_count > 0 && std::size_t(sent) >= parts->iov_len)
+				{
+					sent -= ssize_t(parts->iov_len);
+					++parts;
+					--part_count;
+				}
+				if (part_count > 0)
+				{
+					parts->iov_base = static_cast<char*>(parts->iov_base) + sent;
+					parts->iov_len -= std::size_t(sent);
+				}
+			}
+		}
+
+		inline void receive_fully(const int fd, void* buffer, const std::size_t bytes)
+		{
+			for (std::size_t done = 0; done < bytes; )
+			{
+				const ssize_t received = ::recv(fd, static_cast<char*>(buffer) + done, bytes - done, 0);
+				if (received < 0 && errno == EINTR)
+					continue;
+				if (received < 0)
+					throw_errno("recv");
+				if (received == 0)
+					throw service_error("Connection to matrix server closed.");
+				done += std::size_t(received);
+			}
+		}
+
+		constexpr std::size_t padded_status_size(const std::uint64_t count) noexcept
+		{
+			return std::size_t((count + 7) / 8 * 8);
+		}
+	} // End namespace detail.
+
+	template <index_t Size, typename T = default_T>
+	class matrix_server
+	{
+		static_assert(std::is_floating_point<T>::value, "The server inverts floating point matrices.");
+
+		public:
+		using matrix_t = matrix<Size, Size, T>;
+		using vector_t = matrix<Size, 1, T>;
+
+		private:
+		struct connection
+		{
+			detail::file_descriptor socket;
+			// Bytes received and not yet parsed, from input_start on.
+			std::vector<char> input;
+			std::size_t input_start = 0;
+			// Bytes to send, from output_start on.
+			std::vector<char> output;
+			std::size_t output_start = 0;
+			// Payload bytes of a refused request still to be discarded.
+			std::uint64_t skip = 0;
+			// Whether a request from the connection is in the batch.
+			bool waiting = false;
+			// Closed once the output is sent.
+			bool closing = false;
+			bool open = true;
+		};
+
+		// A request in the batch: its matrices are [first, first + count) of those of its operation.
+		struct pending_request
+		{
+			std::shared_ptr<connection> client;
+			service_operation operation;
+			std::uint64_t id;
+			index_t first;
+			index_t count;
+		};
+
+		std::string path;
+		service_options options;
+		detail::file_descriptor listener;
+		detail::file_descriptor wake_read, wake_write;
+		std::atomic<bool> stopping{false};
+		std::vector<std::shared_ptr<connection>> connections;
+
+		std::vector<pending_request> pending;
+		std::vector<matrix_t> inversions, systems;
+		std::vector<vector_t> solutions;
+		std::vector<std::uint8_t> inversion_status, solution_status;
+		std::chrono::steady_clock::time_point batch_opened;
+
+		std::atomic<std::uint64_t> request_count{0}, matrix_count{0}, batch_count{0};
+
+		// The workers that share each batch with run()'s thread. A job is a number of blocks and
+		// what to do with each; the blocks are handed out one at a time under job_mutex.
+		std::vector<std::thread> workers;
+		std::mutex job_mutex;
+		std::condition_variable job_posted, job_finished;
+		const std::function<void(index_t)>* job = nullptr;
+		index_t job_blocks = 0, next_block = 0, unfinished_blocks = 0;
+		bool retiring = false;
+
+		static std::uint64_t item_elements(const service_operation operation, const std::uint64_t size) noexcept
+		{
+			return operation == service_operation::solve ? size * size + size : size * size;
+		}
+
+		static void reply(connection& client, const service_status status, const std::uint64_t id)
+		{
+			service_reply_header header {};
+			std::copy_n(service_reply_header::expected_magic, sizeof(header.magic), header.magic);
+			header.status = status;
+			header.id = id;
+			const char* bytes = reinterpret_cast<const char*>(&header);
+			client.output.insert(client.output.end(), bytes, bytes + sizeof(header));
+		}
+
+		// Parses the complete requests received from client, adding them to the batch until it is
+		// full. The rest stay buffered for the next batch.
+		void parse(const std::shared_ptr<connection>& client)
+		{
+			connection& c = *client;
+			while (!c.closing && batch_size() < options.max_batch)
+			{
+				const std::size_t available = c.input.size() - c.input_start;
+				if (c.skip > 0)
+				{
+					const std::size_t skipped = std::size_t(std::min<std::uint64_t>(c.skip, available));
+					c.input_start += skipped;
+					c.skip -= skipped;
+					if (c.skip > 0)
+						break;
+					continue;
+				}
+				service_request_header header;
+				if (available < sizeof(header))
+					break;
+				std::memcpy(&header, &c.input[c.input_start], sizeof(header));
+
+				const bool known = header.operation == service_operation::invert ||
+					header.operation == service_operation::solve;
+				if (!std::equal(header.magic, header.magic + sizeof(header.magic), service_request_header::expected_magic) ||
+					!known || header.count > options.max_request || header.size > 65536 || header.element_size > 64)
+				{
+					reply(c, service_status::refused, header.id);
+					c.closing = true;
+					break;
+				}
+				const std::uint64_t payload = header.count * item_elements(header.operation, header.size) * header.element_size;
+				if (header.size != Size || header.element_size != sizeof(T))
+				{
+					reply(c, service_status::unsupported, header.id);
+					c.input_start += sizeof(header);
+					c.skip = payload;
+					continue;
+				}
+				if (available - sizeof(header) < payload)
+					break;
+
+				const char* data = &c.input[c.input_start + sizeof(header)];
+				const index_t count = index_t(header.count);
+				if (pending.empty())
+					batch_opened = std::chrono::steady_clock::now();
+				c.waiting = true;
+				if (header.operation == service_operation::invert)
+				{
+					pending.push_back(pending_request{client, header.operation, header.id, inversions.size(), count});
+					inversions.resize(inversions.size() + count);
+					std::memcpy(&inversions[inversions.size() - count], data, count * sizeof(matrix_t));
+				}
+				else
+				{
+					pending.push_back(pending_request{client, header.operation, header.id, systems.size(), count});
+					systems.resize(systems.size() + count);
+					solutions.resize(solutions.size() + count);
+					for (index_t i = 0; i < count; ++i)
+					{
+						std::memcpy(&systems[systems.size() - count + i], data, sizeof(matrix_t));
+						std::memcpy(&solutions[solutions.size() - count + i], data + sizeof(matrix_t), sizeof(vector_t));
+						data += sizeof(matrix_t) + sizeof(vector_t);
+					}
+				}
+				c.input_start += sizeof(header) + std::size_t(payload);
+				++request_count;
+			}
+
+			// Parsed bytes are dropped once they make up most of the buffer.
+			if (c.input_start > c.input.size() / 2)
+			{
+				c.input.erase(c.input.begin(), c.input.begin() + std::ptrdiff_t(c.input_start));
+				c.input_start = 0;
+			}
+		}
+
+		index_t batch_size() const noexcept { return inversions.size() + systems.size(); }
+
+		// Takes blocks of the current job until none are left. Called with lock held.
+		void take_blocks(std::unique_lock<std::mutex>& lock)
+		{
+			while (next_block < job_blocks)
+			{
+				const index_t b = next_block++;
+				lock.unlock();
+				(*job)(b);
+				lock.lock();
+				if (--unfinished_blocks == 0)
+					job_finished.notify_all();
+			}
+		}
+
+		void work()
+		{
+			std::unique_lock<std::mutex> lock(job_mutex);
+			for (;;)
+			{
+				job_posted.wait(lock, [this] { return retiring || next_block < job_blocks; });
+				if (retiring)
+					return;
+				take_blocks(lock);
+			}
+		}
+
+		void retire() noexcept
+		{
+			{
+				std::lock_guard<std::mutex> lock(job_mutex);
+				retiring = true;
+			}
+			job_posted.notify_all();
+			for (auto& worker : workers)
+				worker.join();
+			workers.clear();
+		}
+
+		// Calls fn(b) for b in [0, block_count), across the workers and this thread.
+		void parallel_blocks(const index_t block_count, const std::function<void(index_t)>& fn)
+		{
+			if (workers.empty() || block_count <= 1)
+			{
+				for (index_t b = 0; b < block_count; ++b)
+					fn(b);
+				return;
+			}
+			std::unique_lock<std::mutex> lock(job_mutex);
+			job = &fn;
+			job_blocks = block_count;
+			next_block = 0;
+			unfinished_blocks = block_count;
+			job_posted.notify_all();
+			take_blocks(lock);
+			job_finished.wait(lock, [this] { return unfinished_blocks == 0; });
+			job = nullptr;
+			job_blocks = next_block = 0;
+		}
+
+		// Inverts and solves the batch, and queues the replies. Both operations factorize by LU
+		// with partial pivoting, so that a matrix is degenerate for one exactly when it is for the
+		// other, and a system is solved from the factors rather than through an inverse. A
+		// degenerate matrix is left as it was.
+		void process()
+		{
+			const index_t block = std::max<index_t>(options.parallel_block, 1);
+			const index_t inversion_blocks = (inversions.size() + block - 1) / block;
+			inversion_status.resize(inversions.size());
+			solution_status.resize(systems.size());
+			parallel_blocks(inversion_blocks + (systems.size() + block - 1) / block, [&](const index_t b)
+			{
+				row_permutation<Size> permutation;
+				if (b < inversion_blocks)
+				{
+					auto lu = std::make_unique<matrix_t>();
+					for (index_t i = b * block; i < std::min((b + 1) * block, inversions.size()); ++i)
+					{
+						*lu = inversions[i];
+						inversion_status[i] = try_lu_blocked(*lu, permutation, 1);
+						if (inversion_status[i])
+						{
+							inversions[i] = matrix_t::get_identity_matrix();
+							lu_solve(*lu, permutation, inversions[i]);
+						}
+					}
+					return;
+				}
+				const index_t first = (b - inversion_blocks) * block, last = std::min(first + block, systems.size());
+				for (index_t i = first; i < last; ++i)
+				{
+					solution_status[i] = try_lu_blocked(systems[i], permutation, 1);
+					if (solution_status[i])
+						lu_solve(systems[i], permutation, solutions[i]);
+				}
+			});
+
+			for (const auto& request : pending)
+			{
+				connection& c = *request.client;
+				c.waiting = false;
+				if (!c.open)
+					continue;
+				const bool invert = request.operation == service_operation::invert;
+				const std::uint8_t* status = (invert ? inversion_status : solution_status).data() + request.first;
+				const char* results = invert ? reinterpret_cast<const char*>(&inversions[request.first])
+					: reinterpret_cast<const char*>(&solutions[request.first]);
+				const std::size_t result_bytes = request.count * (invert ? sizeof(matrix_t) : sizeof(vector_t));
+
+				reply(c, service_status::ok, request.id);
+				std::uint64_t count = request.count;
+				std::memcpy(&c.output[c.output.size() - sizeof(service_reply_header) + offsetof(service_reply_header, count)],
+					&count, sizeof(count));
+				c.output.insert(c.output.end(), status, status + request.count);
+				c.output.resize(c.output.size() + detail::padded_status_size(request.count) - request.count);
+				c.output.insert(c.output.end(), results, results + result_bytes);
+			}
+
+			matrix_count += batch_size();
+			++batch_count;
+			pending.clear();
+			inversions.clear();
+			systems.clear();
+			solutions.clear();
+		}
+
+		// Reads what client has sent, returning false once it has hung up.
+		bool receive(const std::shared_ptr<connection>& client)
+		{
+			connection& c = *client;
+			char buffer[65536];
+			for (;;)
+			{
+				const ssize_t received = ::recv(c.socket.get(), buffer, sizeof(buffer), 0);
+				if (received < 0 && errno == EINTR)
+					continue;
+				if (received < 0)
+					return errno == EAGAIN || errno == EWOULDBLOCK;
+				if (received == 0)
+					return false;
+				if (!c.closing)
+					c.input.insert(c.input.end(), buffer, buffer + received);
+				if (std::size_t(received) < sizeof(buffer))
+					return true;
+			}
+		}
+
+		// Sends what can be sent to client without blocking, returning false on failure.
+		static bool send(connection& c)
+		{
+			while (c.output_start < c.output.size())
+			{
+				const ssize_t sent = ::send(c.socket.get(), &c.output[c.output_start], c.output.size() - c.output_start,
+					MSG_NOSIGNAL);
+				if (sent < 0 && errno == EINTR)
+					continue;
+				if (sent < 0)
+					return errno == EAGAIN || errno == EWOULDBLOCK;
+				c.output_start += std::size_t(sent);
+			}
+			c.output.clear();
+			c.output_start = 0;
+			return true;
+		}
+
+		public:
+		// Listens on a socket at path, replacing whatever is there.
+		explicit matrix_server(std::string socket_path, const service_options& options = {})
+			: path(std::move(socket_path)), options(options)
+		{
+			const sockaddr_un address = detail::socket_address(path);
+			listener = detail::file_descriptor{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)};
+			if (listener.get() < 0)
+				detail::throw_errno("socket");
+			::unlink(path.c_str());
+			if (::bind(listener.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+				detail::throw_errno(path.c_str());
+			if (::listen(listener.get(), SOMAXCONN) != 0)
+				detail::throw_errno("listen");
+
+			int wake[2];
+			if (::pipe(wake) != 0)
+				detail::throw_errno("pipe");
+			wake_read = detail::file_descriptor{wake[0]};
+			wake_write = detail::file_descriptor{wake[1]};
+			::fcntl(wake[0], F_SETFL, O_NONBLOCK);
+
+			try
+			{
+				for (unsigned t = 1; t < options.thread_count; ++t)
+					workers.emplace_back([this] { work(); });
+			}
+			catch (...)
+			{
+				retire();
+				::unlink(path.c_str());
+				throw;
+			}
+		}
+		matrix_server(const matrix_server&) = delete;
+		matrix_server& operator= (const matrix_server&) = delete;
+		~matrix_server()
+		{
+			retire();
+			::unlink(path.c_str());
+		}
+
+		// Serves clients until stop() is called.
+		void run()
+		{
+			std::vector<pollfd> polled;
+			while (!stopping.load())
+			{
+				polled.assign({pollfd{wake_read.get(), POLLIN, 0}, pollfd{listener.get(), POLLIN, 0}});
+				for (const auto& client : connections)
+					polled.push_back(pollfd{client->socket.get(),
+						short((client->closing ? 0 : POLLIN) | (client->output.empty() ? 0 : POLLOUT)), 0});
+
+				// Sleep until something arrives, or the batch's window closes.
+				timespec timeout {};
+				if (!pending.empty())
+				{
+					const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+						batch_opened + options.window - std::chrono::steady_clock::now()).count();
+					timeout.tv_sec = std::max<std::int64_t>(remaining, 0) / 1000000000;
+					timeout.tv_nsec = std::max<std::int64_t>(remaining, 0) % 1000000000;
+				}
+				if (::ppoll(polled.data(), nfds_t(polled.size()), pending.empty() ? nullptr : &timeout, nullptr) < 0 &&
+					errno != EINTR)
+					detail::throw_errno("ppoll");
+
+				if (polled[0].revents)
+				{
+					char drained[64];
+					while (::read(wake_read.get(), drained, sizeof(drained)) > 0)
+						;
+				}
+				if (polled[1].revents & POLLIN)
+					for (int fd; (fd = ::accept4(listener.get(), nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0; )
+					{
+						auto client = std::make_shared<connection>();
+						client->socket = detail::file_descriptor{fd};
+						connections.push_back(std::move(client));
+					}
+				for (std::size_t i = 2; i < polled.size(); ++i)
+				{
+					const auto& client = connections[i - 2];
+					if ((polled[i].revents & (POLLIN | POLLHUP | POLLERR)) && !receive(client))
+						client->open = false;
+					if (client->open)
+						parse(client);
+				}
+
+				// The window closes early once every client is waiting, as then no more requests can
+				// arrive until some are answered. Requests left buffered by a full batch are parsed
+				// into the next.
+				for (;;)
+				{
+					const bool window_closed = !pending.empty() && (std::chrono::steady_clock::now() - batch_opened >=
+						options.window || std::all_of(connections.begin(), connections.end(),
+							[](const std::shared_ptr<connection>& client) { return client->waiting || client->closing || !client->open; }));
+					if (batch_size() < options.max_batch && !window_closed)
+						break;
+					process();
+					for (const auto& client : connections)
+						if (client->open)
+							parse(client);
+				}
+
+				for (auto& client : connections)
+					if (client->open && (!send(*client) || (client->closing && client->output.empty())))
+						client->open = false;
+				connections.erase(std::remove_if(connections.begin(), connections.end(),
+					[](const std::shared_ptr<connection>& client) { return !client->open; }), connections.end());
+			}
+		}
+
+		// Makes run() return, from any thread.
+		void stop() noexcept
+		{
+			stopping.store(true);
+			const char signal = 0;
+			(void)!::write(wake_write.get(), &signal, 1);
+		}
+
+		// Requests and matrices served, and the batches they were coalesced into.
+		service_statistics statistics() const noexcept
+		{
+			return service_statistics{request_count.load(), matrix_count.load(), batch_count.load()};
+		}
+	}; // End of class matrix_server.
+
+	template <index_t Size, typename T = default_T>
+	class matrix_client
+	{
+		public:
+		using matrix_t = matrix<Size, Size, T>;
+		using vector_t = matrix<Size, 1, T>;
+
+		private:
+		detail::file_descriptor socket;
+		std::uint64_t next_id = 0;
+		std::vector<char> buffer;
+
+		// Sends a request, then receives the reply's status bytes into status (if given) and its
+		// results into results. Returns the number of matrices whose status is set.
+		index_t call(const service_operation operation, const index_t count, iovec* payload, const int payload_parts,
+			void* results, const std::size_t result_bytes, std::uint8_t* status)
+		{
+			service_request_header header {};
+			std::copy_n(service_request_header::expected_magic, sizeof(header.magic), header.magic);
+			header.element_size = sizeof(T);
+			header.operation = operation;
+			header.size = std::uint32_t(Size);
+			header.count = count;
+			header.id = next_id++;
+			iovec parts[3] = {{&header, sizeof(header)}};
+			std::copy_n(payload, payload_parts, parts + 1);
+			detail::send_fully(socket.get(), parts, payload_parts + 1);
+
+			service_reply_header reply;
+			detail::receive_fully(socket.get(), &reply, sizeof(reply));
+			if (!std::equal(reply.magic, reply.magic + sizeof(reply.magic), service_reply_header::expected_magic) ||
+				reply.id != header.id)
+				throw service_error("Malformed reply from matrix server.");
+			if (reply.status != service_status::ok)
+				throw service_error(reply.status == service_status::unsupported ?
+					"Matrix server does not serve matrices of this type." : "Matrix server refused the request.");
+			if (reply.count != count)
+				throw service_error("Malformed reply from matrix server.");
+
+			buffer.resize(detail::padded_status_size(count));
+			detail::receive_fully(socket.get(), buffer.data(), buffer.size());
+			detail::receive_fully(socket.get(), results, result_bytes);
+			if (status)
+				std::copy_n(buffer.begin(), count, status);
+			return index_t(std::count_if(buffer.begin(), buffer.begin() + count, [](const char s) { return s != 0; }));
+		}
+
+		public:
+		// Connects to the server listening at path.
+		explicit matrix_client(const std::string& path)
+		{
+			const sockaddr_un address = detail::socket_address(path);
+			socket = detail::file_descriptor{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+			if (socket.get() < 0)
+				detail::throw_errno("socket");
+			if (::connect(socket.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+				detail::throw_errno(path.c_str());
+		}
+
+		// Inverts count matrices from first into out, which may be first, as invert_batch() does,
+		// and sets status[i], if status is given, to whether matrix i was inverted. Returns the
+		// number of matrices inverted.
+		index_t invert(const matrix_t* first, const index_t count, matrix_t* out, std::uint8_t* status = nullptr)
+		{
+			iovec payload = {const_cast<matrix_t*>(first), count * sizeof(matrix_t)};
+			return call(service_operation::invert, count, &payload, 1, out, count * sizeof(matrix_t), status);
+		}
+
+		// Solves a[i] x[i] = b[i] for count systems, setting status[i], if status is given, to
+		// whether system i could be solved. x may be b. Returns the number of systems solved.
+		index_t solve(const matrix_t* a, const vector_t* b, const index_t count, vector_t* x,
+			std::uint8_t* status = nullptr)
+		{
+			std::vector<char> systems(count * (sizeof(matrix_t) + sizeof(vector_t)));
+			for (index_t i = 0; i < count; ++i)
+			{
+				std::memcpy(&systems[i * (sizeof(matrix_t) + sizeof(vector_t))], &a[i], sizeof(matrix_t));
+				std::memcpy(&systems[i * (sizeof(matrix_t) + sizeof(vector_t)) + sizeof(matrix_t)], &b[i], sizeof(vector_t));
+			}
+			iovec payload = {systems.data(), systems.size()};
+			return call(service_operation::solve, count, &payload, 1, x, count * sizeof(vector_t), status);
+		}
+	}; // End of class matrix_client.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_SERVICE_H.
@@ -0,0 +1,210 @@
+/*
+ * Matrix maths: immutable shared matrices.
+ *
+ * A shared_matrix is a reference-counted handle to a matrix that can no longer be modified, so
+ * any number of threads may read it concurrently without synchronization. A matrix_pool interns
+ * shared matrices, so that threads which independently produce identical matrices share a
+ * single copy.
+ *
+ *
+ * Requires C++14 or later. Huge page storage is only available on Linux; elsewhere it falls
+ * back to ordinary storage.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_SHARED_H
+#define CROWSTON_MATRIX_SHARED_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	// Where the matrix of a shared_matrix is stored. Huge pages reduce TLB misses when reading
+	// large matrices, but each matrix then occupies at least one huge page, so they are only
+	// worthwhile for matrices of a few hundred kilobytes or more.
+	enum class shared_storage
+	{
+		standard,
+		huge_pages
+	};
+
+	namespace detail
+	{
+		constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+
+		// Allocates a copy of mtx in memory mapped for it alone, backed by huge pages if the
+		// system will provide them (either reserved, or transparent), and ordinary pages
+		// otherwise.
+		template <typename Matrix>
+		std::shared_ptr<const Matrix> allocate_shared_matrix(const Matrix& mtx, const shared_storage storage)
+		{
+#ifdef __linux__
+			if (storage == shared_storage::huge_pages)
+			{
+				const std::size_t length = (sizeof(Matrix) + huge_page_size - 1) / huge_page_size * huge_page_size;
+				void* memory = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				if (memory == MAP_FAILED)
+				{
+					memory = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+					if (memory == MAP_FAILED)
+						throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+					::madvise(memory, length, MADV_HUGEPAGE);
+#endif
+				}
+				const Matrix* copy = new (memory) Matrix(mtx);
+				return std::shared_ptr<const Matrix>(copy, [length](const Matrix* p) noexcept
+				{
+					p->~Matrix();
+					::munmap(const_cast<Matrix*>(p), length);
+				});
+			}
+#else
+			(void)storage;
+#endif
+			// Allocated apart from the control block (unlike by make_shared()), so that the matrix
+			// is freed with the last handle, even while a matrix_pool's weak reference remains.
+			return std::shared_ptr<const Matrix>(new Matrix(mtx));
+		}
+
+		// FNV-1a over the object representation.
+		inline std::uint64_t hash_bytes(const void* data, const std::size_t length) noexcept
+		{
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			std::uint64_t hash = 14695981039346656037ull;
+			for (std::size_t i = 0; i < length; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	} // End namespace detail.
+
+	//
+	// Shared matrix handle.
+	//
+	template <index_t Height, index_t Width, typename T = default_T>
+	class shared_matrix
+	{
+		public:
+		using matrix_t = matrix<Height, Width, T>;
+
+		private:
+		std::shared_ptr<const matrix_t> handle;
+
+		explicit shared_matrix(std::shared_ptr<const matrix_t> handle) noexcept
+			: handle(std::move(handle))
+		{ }
+
+		template <index_t, index_t, typename> friend class matrix_pool;
+
+		public:
+		// Constructors. A default constructed handle is empty.
+		shared_matrix() noexcept = default;
+		explicit shared_matrix(const matrix_t& mtx, const shared_storage storage = shared_storage::standard)
+			: handle(detail::allocate_shared_matrix(mtx, storage))
+		{ }
+
+		// Accessors.
+		const matrix_t& operator*() const noexcept { return *handle; }
+		const matrix_t* operator->() const noexcept { return handle.get(); }
+		const matrix_t& get() const noexcept { return *handle; }
+		explicit operator bool() const noexcept { return bool(handle); }
+
+		// The number of handles sharing this matrix.
+		long use_count() const noexcept { return handle.use_count(); }
+
+		// Handles compare equal if they share the same matrix.
+		friend bool operator==(const shared_matrix& lhs, const shared_matrix& rhs) noexcept
+		{
+			return lhs.handle == rhs.handle;
+		}
+		friend bool operator!=(const shared_matrix& lhs, const shared_matrix& rhs) noexcept
+		{
+			return lhs.handle != rhs.handle;
+		}
+	}; // End of class shared_matrix.
+
+	//
+	// Interning pool.
+	//
+	// intern() returns a handle to a matrix in the pool that is bitwise identical to its argument,
+	// adding a copy of the argument if there is none. The pool holds its matrices weakly: a matrix
+	// is freed once the last handle to it outside the pool is gone. The pool is thread safe.
+	//
+	template <index_t Height, index_t Width, typename T = default_T>
+	class matrix_pool
+	{
+		public:
+		using matrix_t = matrix<Height, Width, T>;
+		using handle_t = shared_matrix<Height, Width, T>;
+
+		private:
+		std::mutex mutex;
+		std::unordered_multimap<std::uint64_t, std::weak_ptr<const matrix_t>> entries;
+		const shared_storage storage;
+
+		public:
+		explicit matrix_pool(const shared_storage storage = shared_storage::standard) noexcept
+			: storage(storage)
+		{ }
+
+		handle_t intern(const matrix_t& mtx)
+		{
+			const std::uint64_t hash = detail::hash_bytes(&mtx, sizeof(matrix_t));
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto range = entries.equal_range(hash);
+			for (auto entry = range.first; entry != range.second; )
+			{
+				auto existing = entry->second.lock();
+				if (!existing)
+				{
+					entry = entries.erase(entry);
+					continue;
+				}
+				if (std::memcmp(existing.get(), &mtx, sizeof(matrix_t)) == 0)
+					return handle_t{std::move(existing)};
+				++entry;
+			}
+
+			auto added = detail::allocate_shared_matrix(mtx, storage);
+			entries.emplace(hash, added);
+			return handle_t{std::move(added)};
+		}
+
+		// The number of entries, including any whose matrices have since been freed.
+		std::size_t size()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return entries.size();
+		}
+
+		// Removes the entries whose matrices have been freed.
+		void purge()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto entry = entries.begin(); entry != entries.end(); )
+				if (entry->second.expired())
+					entry = entries.erase(entry);
+				else
+					++entry;
+		}
+	}; // End of class matrix_pool.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_SHARED_H.
@@ -0,0 +1,382 @@
+/*
+ * Matrix maths: symmetric matrices.
+ *
+ * A symmetric_matrix stores only its lower triangle, packed row by row, so it occupies a little
+ * over half the memory of the equivalent square_matrix and is exactly symmetric by construction.
+ * Symmetric indefinite systems are solved through the Bunch--Kaufman LDLᵀ factorization.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_SYMMETRIC_H
+#define CROWSTON_MATRIX_SYMMETRIC_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <initializer_list>
+#include <ostream>
+#include <utility>
+
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	//
+	// Symmetric matrix class.
+	//
+	template <index_t Size, typename T = default_T>
+	class symmetric_matrix
+	{
+		public:
+		using type = T;
+		using self_t = symmetric_matrix<Size, T>;
+		static constexpr index_t packed_size = Size * (Size + 1) / 2;
+
+		private:
+		using storage_t = std::array<T, packed_size>;
+		storage_t storage{};
+
+		// Position of element [r][c], r >= c, in the packed lower triangle.
+		static constexpr index_t offset(const index_t r, const index_t c) noexcept
+		{
+			return r * (r + 1) / 2 + c;
+		}
+
+		public:
+		// Constructors. From a square matrix, only the lower triangle is read. From an initializer
+		// list, each row lists the lower triangle only: {{a}, {b, c}, {d, e, f}}.
+		symmetric_matrix() noexcept : storage{} { }
+		explicit symmetric_matrix(const matrix<Size, Size, T>& mtx) noexcept
+		{
+			for (index_t r = 0; r < Size; ++r)
+				for (index_t c = 0; c <= r; ++c)
+					storage[offset(r, c)] = mtx[r][c];
+		}
+		symmetric_matrix(const std::initializer_list<std::initializer_list<T>> init) noexcept
+		{
+			index_t r = 0;
+			for (const auto& row_init : init)
+			{
+				index_t c = 0;
+				for (const auto& element : row_init)
+					storage[offset(r, c++)] = element;
+				++r;
+			}
+		}
+
+		// Accessors. Element [r][c] and element [c][r] are the same element.
+		constexpr T& operator() (const index_t r, const index_t c) noexcept
+		{
+			return r >= c ? storage[offset(r, c)] : storage[offset(c, r)];
+		}
+		constexpr const T& operator() (const index_t r, const index_t c) const noexcept
+		{
+			return r >= c ? storage[offset(r, c)] : storage[offset(c, r)];
+		}
+
+		// Iteration, through the packed lower triangle.
+		constexpr auto begin() noexcept { return storage.begin(); }
+		constexpr auto end() noexcept { return storage.end(); }
+		constexpr auto begin() const noexcept { return storage.begin(); }
+		constexpr auto end() const noexcept { return storage.end(); }
+
+		// Expansion into a full square matrix.
+		auto get_matrix() const noexcept
+			-> matrix<Size, Size, T>
+		{
+			matrix<Size, Size, T> mtx {};
+			for (index_t r = 0; r < Size; ++r)
+				for (index_t c = 0; c <= r; ++c)
+					mtx[r][c] = mtx[c][r] = storage[offset(r, c)];
+			return mtx;
+		}
+
+		// Elementwise addition and multiplication by a constant.
+		self_t& operator+= (const self_t& rhs) noexcept
+		{
+			for (index_t i = 0; i < packed_size; ++i)
+				storage[i] += rhs.storage[i];
+			return *this;
+		}
+		self_t& operator*= (const T rhs) noexcept
+		{
+			for (auto& element : storage)
+				element *= rhs;
+			return *this;
+		}
+
+		// Equality, with the same tolerance as for matrices.
+		friend bool operator==(const self_t& lhs, const self_t& rhs) noexcept
+		{
+			for (index_t i = 0; i < packed_size; ++i)
+				if (std::abs(lhs.storage[i] - rhs.storage[i]) > T(equality_tolerance))
+					return false;
+			return true;
+		}
+		friend bool operator!=(const self_t& lhs, const self_t& rhs) noexcept
+		{
+			return !(lhs == rhs);
+		}
+
+		// Streaming (printing).
+		friend std::ostream& operator<<(std::ostream& stream, const self_t& mtx)
+		{
+			for (index_t r = 0; r < Size; ++r)
+			{
+				stream << '\n';
+				for (index_t c = 0; c < Size; ++c)
+					stream << '\t' << mtx(r, c);
+			}
+			return stream;
+		}
+
+		// Obtain an identity matrix.
+		static self_t get_identity_matrix() noexcept
+		{
+			self_t identity {};
+			for (index_t i = 0; i < Size; ++i)
+				identity(i, i) = T(1);
+			return identity;
+		}
+	}; // End of class symmetric_matrix.
+
+	template <index_t Size, typename T>
+	constexpr index_t symmetric_matrix<Size, T>::packed_size;
+
+	//
+	// Symmetric products.
+	//
+
+	// C = alpha A B + beta C, for symmetric A. Each packed element of A is read once. If beta is
+	// zero, C need not be initialized.
+	template <index_t Size, index_t Width, typename T>
+	void symm(const T alpha, const symmetric_matrix<Size, T>& a, const matrix<Size, Width, T>& b,
+		const T beta, matrix<Size, Width, T>& c) noexcept
+	{
+		if (beta == T(0))
+			c = matrix<Size, Width, T>{};
+		else if (beta != T(1))
+			c *= beta;
+
+		for (index_t r = 0; r < Size; ++r)
+		{
+			for (index_t k = 0; k < r; ++k)
+			{
+				const T factor = alpha * a(r, k);
+				c[r].add_scaled(b[k], factor);
+				c[k].add_scaled(b[r], factor);
+			}
+			c[r].add_scaled(b[r], alpha * a(r, r));
+		}
+	}
+
+	template <index_t Size, index_t Width, typename T>
+	auto operator* (const symmetric_matrix<Size, T>& lhs, const matrix<Size, Width, T>& rhs) noexcept
+		-> matrix<Size, Width, T>
+	{
+		matrix<Size, Width, T> product;
+		symm(T(1), lhs, rhs, T(0), product);
+		return product;
+	}
+
+	// C = alpha A Aᵀ + beta C, into packed storage.
+	template <index_t Size, index_t InnerSize, typename T>
+	void syrk(const T alpha, const matrix<Size, InnerSize, T>& a, const T beta, symmetric_matrix<Size, T>& c) noexcept
+	{
+		for (index_t r = 0; r < Size; ++r)
+			for (index_t col = 0; col <= r; ++col)
+			{
+				const T product = alpha * dot(a[r], a[col]);
+				c(r, col) = (beta == T(0)) ? product : multiply_add(beta, c(r, col), product);
+			}
+	}
+
+	//
+	// Bunch--Kaufman factorization, P A Pᵀ = L D Lᵀ, for symmetric (possibly indefinite) A.
+	//
+	// D is block diagonal with 1x1 and 2x2 blocks, and L is unit lower triangular. As in LAPACK,
+	// L is a product of interchanges and elementary transformations, so factors holds D on its
+	// diagonal (and first subdiagonal, for 2x2 blocks) and the multipliers of L below it. For a
+	// 1x1 block at k, rows k and pivots[k] were interchanged; for a 2x2 block at k and k+1, rows
+	// k+1 and pivots[k] = pivots[k+1] were interchanged.
+	//
+	template <index_t Size, typename T = default_T>
+	struct ldlt_factorization
+	{
+		symmetric_matrix<Size, T> factors;
+		std::array<index_t, Size> pivots;
+		std::array<bool, Size> in_2x2_block;
+
+		// Solve A X = B.
+		template <index_t Width>
+		auto solve(matrix<Size, Width, T> b) const noexcept
+			-> matrix<Size, Width, T>
+		{
+			const auto& a = factors;
+			// Solve L D Y = B.
+			for (index_t k = 0; k < Size; )
+			{
+				if (!in_2x2_block[k])
+				{
+					b.swap_rows(k, pivots[k]);
+					for (index_t i = k+1; i < Size; ++i)
+						b[i].add_scaled(b[k], -a(i, k));
+					b[k] *= T(1) / a(k, k);
+					k += 1;
+				}
+				else
+				{
+					b.swap_rows(k+1, pivots[k+1]);
+					for (index_t i = k+2; i < Size; ++i)
+					{
+						b[i].add_scaled(b[k], -a(i, k));
+						b[i].add_scaled(b[k+1], -a(i, k+1));
+					}
+					const T d21 = a(k+1, k);
+					const T d11 = a(k, k) / d21;
+					const T d22 = a(k+1, k+1) / d21;
+					const T denominator = d11 * d22 - T(1);
+					for (index_t c = 0; c < Width; ++c)
+					{
+						const T b1 = b[k][c] / d21;
+						const T b2 = b[k+1][c] / d21;
+						b[k][c] = (d22 * b1 - b2) / denominator;
+						b[k+1][c] = (d11 * b2 - b1) / denominator;
+					}
+					k += 2;
+				}
+			}
+			// Solve Lᵀ X = Y.
+			for (index_t k = Size; k-- > 0; )
+			{
+				const index_t block_start = (in_2x2_block[k] && k > 0 && in_2x2_block[k-1]) ? k-1 : k;
+				for (index_t j = block_start; j <= k; ++j)
+					for (index_t i = k+1; i < Size; ++i)
+						b[j].add_scaled(b[i], -a(i, j));
+				b.swap_rows(k, pivots[k]);
+				k = block_start;
+			}
+			return b;
+		}
+
+		auto solve(const row<Size, T>& b) const noexcept
+			-> row<Size, T>
+		{
+			matrix<Size, 1, T> column;
+			for (index_t i = 0; i < Size; ++i)
+				column[i][0] = b[i];
+			column = solve(column);
+			row<Size, T> x;
+			for (index_t i = 0; i < Size; ++i)
+				x[i] = column[i][0];
+			return x;
+		}
+	};
+
+	// Throws matrix_is_degenerate_error if A is singular.
+	template <index_t Size, typename T>
+	auto ldlt(const symmetric_matrix<Size, T>& mtx)
+		-> ldlt_factorization<Size, T>
+	{
+		// Bunch and Kaufman's constant, which bounds element growth.
+		const T alpha = (T(1) + std::sqrt(T(17))) / T(8);
+
+		ldlt_factorization<Size, T> result;
+		auto& a = result.factors;
+		a = mtx;
+		result.in_2x2_block.fill(false);
+
+		for (index_t k = 0; k < Size; )
+		{
+			index_t step = 1;
+			index_t pivot = k;
+
+			// Find the largest element below the diagonal of column k.
+			const T diagonal_magnitude = std::abs(a(k, k));
+			index_t imax = k;
+			T column_max = 0;
+			for (index_t i = k+1; i < Size; ++i)
+				if (std::abs(a(i, k)) > column_max)
+				{
+					column_max = std::abs(a(i, k));
+					imax = i;
+				}
+			if (std::max(diagonal_magnitude, column_max) <= equality_tolerance)
+				throw matrix_is_degenerate_error();
+
+			if (diagonal_magnitude < alpha * column_max)
+			{
+				// Find the largest off-diagonal element in row imax of the trailing submatrix.
+				T row_max = 0;
+				for (index_t j = k; j < Size; ++j)
+					if (j != imax)
+						row_max = std::max(row_max, std::abs(a(imax, j)));
+
+				if (diagonal_magnitude * row_max >= alpha * column_max * column_max)
+					pivot = k;
+				else if (std::abs(a(imax, imax)) >= alpha * row_max)
+					pivot = imax;
+				else
+				{
+					pivot = imax;
+					step = 2;
+				}
+			}
+
+			// Interchange within the trailing submatrix.
+			const index_t kk = k + step - 1;
+			if (pivot != kk)
+			{
+				using std::swap;
+				for (index_t j = k; j < Size; ++j)
+					if (j != kk && j != pivot)
+						swap(a(kk, j), a(pivot, j));
+				swap(a(kk, kk), a(pivot, pivot));
+			}
+
+			if (step == 1)
+			{
+				result.pivots[k] = pivot;
+				const T reciprocal = T(1) / a(k, k);
+				for (index_t j = k+1; j < Size; ++j)
+				{
+					const T factor = reciprocal * a(j, k);
+					for (index_t i = j; i < Size; ++i)
+						a(i, j) -= factor * a(i, k);
+				}
+				for (index_t i = k+1; i < Size; ++i)
+					a(i, k) *= reciprocal;
+			}
+			else
+			{
+				result.pivots[k] = result.pivots[k+1] = pivot;
+				result.in_2x2_block[k] = result.in_2x2_block[k+1] = true;
+				if (k+2 < Size)
+				{
+					T d21 = a(k+1, k);
+					const T d11 = a(k+1, k+1) / d21;
+					const T d22 = a(k, k) / d21;
+					const T t = T(1) / (d11 * d22 - T(1));
+					d21 = t / d21;
+					for (index_t j = k+2; j < Size; ++j)
+					{
+						const T wk = d21 * (d11 * a(j, k) - a(j, k+1));
+						const T wk1 = d21 * (d22 * a(j, k+1) - a(j, k));
+						for (index_t i = j; i < Size; ++i)
+							a(i, j) -= a(i, k) * wk + a(i, k+1) * wk1;
+						a(j, k) = wk;
+						a(j, k+1) = wk1;
+					}
+				}
+			}
+			k += step;
+		}
+		return result;
+	}
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_SYMMETRIC_H.
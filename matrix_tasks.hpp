@@ -0,0 +1,292 @@
+/*
+ * Matrix maths: task graphs.
+ *
+ * A task_graph holds tasks whose dependencies are inferred from the data each one reads and
+ * writes, in the order the tasks were added: a task runs after the last earlier task to write
+ * anything it reads or writes, and after every earlier task to read anything it writes. Running
+ * the graph schedules the tasks dynamically on a pool of threads, each of which keeps its own
+ * queue of ready tasks and steals from the others when its own is empty. The start and end of
+ * every task are recorded, and can be written out as a trace for chrome://tracing or Perfetto.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_TASKS_H
+#define CROWSTON_MATRIX_TASKS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "matrix_math.hpp"
+
+namespace matrix_math
+{
+	namespace detail
+	{
+		// Writes text as a JSON string, quoted and escaped.
+		inline void write_json_string(std::ostream& out, const std::string& text)
+		{
+			static const char digits[] = "0123456789abcdef";
+			out << '"';
+			for (const char ch : text)
+			{
+				const unsigned char code = static_cast<unsigned char>(ch);
+				if (ch == '"' || ch == '\\')
+					out << '\\' << ch;
+				else if (code < 0x20)
+					out << "\\u00" << digits[code >> 4] << digits[code & 0xf];
+				else
+					out << ch;
+			}
+			out << '"';
+		}
+	} // End namespace detail.
+
+	class task_graph
+	{
+		struct task
+		{
+			std::string name;
+			std::function<void()> body;
+			std::vector<index_t> successors;
+			unsigned predecessor_count = 0;
+			// Trace, in seconds since the graph began to run.
+			unsigned worker = 0;
+			double start = 0;
+			double end = 0;
+		};
+		// The accesses so far to one piece of data.
+		struct access_history
+		{
+			index_t last_writer = no_task;
+			std::vector<index_t> readers;
+		};
+		// A queue of ready tasks. Its owner works from the back; thieves take from the front.
+		struct worker_queue
+		{
+			std::mutex mutex;
+			std::deque<index_t> tasks;
+		};
+
+		static constexpr index_t no_task = index_t(-1);
+
+		std::vector<task> tasks;
+		std::unordered_map<const void*, access_history> history;
+		unsigned worker_count = 0;
+		double elapsed = 0;
+
+		void depend(const index_t predecessor, const index_t successor)
+		{
+			if (predecessor == no_task || predecessor == successor)
+				return;
+			tasks[predecessor].successors.push_back(successor);
+			++tasks[successor].predecessor_count;
+		}
+
+		public:
+		// Adds a task, which reads the data at the addresses in reads and reads or writes the data
+		// at the addresses in writes.
+		void add(std::string name, std::function<void()> body,
+			const std::initializer_list<const void*> reads, const std::initializer_list<const void*> writes)
+		{
+			add(std::move(name), std::move(body), reads.begin(), reads.end(), writes.begin(), writes.end());
+		}
+		template <typename ReadIt, typename WriteIt>
+		void add(std::string name, std::function<void()> body,
+			const ReadIt first_read, const ReadIt last_read, const WriteIt first_write, const WriteIt last_write)
+		{
+			const index_t id = tasks.size();
+			tasks.push_back(task{std::move(name), std::move(body), {}});
+			for (auto read = first_read; read != last_read; ++read)
+			{
+				auto& data = history[*read];
+				depend(data.last_writer, id);
+				data.readers.push_back(id);
+			}
+			for (auto write = first_write; write != last_write; ++write)
+			{
+				auto& data = history[*write];
+				depend(data.last_writer, id);
+				for (const auto reader : data.readers)
+					depend(reader, id);
+				data.last_writer = id;
+				data.readers.clear();
+			}
+		}
+
+		// The number of tasks.
+		index_t size() const noexcept { return tasks.size(); }
+
+		// Runs every task, on thread_count threads including the calling thread. If any task
+		// throws, the tasks not yet started are skipped and the first exception is rethrown.
+		void run(const unsigned thread_count = std::thread::hardware_concurrency())
+		{
+			worker_count = std::max(thread_count, 1u);
+			const index_t task_count = tasks.size();
+			std::unique_ptr<std::atomic<unsigned>[]> waiting(new std::atomic<unsigned>[task_count]);
+			std::unique_ptr<worker_queue[]> queues(new worker_queue[worker_count]);
+			unsigned next_queue = 0;
+			for (index_t id = 0; id < task_count; ++id)
+			{
+				waiting[id] = tasks[id].predecessor_count;
+				if (tasks[id].predecessor_count == 0)
+					queues[next_queue++ % worker_count].tasks.push_back(id);
+			}
+
+			// Workers with nothing to do sleep until a task is queued or the last one finishes.
+			// ready counts the queued tasks; it is raised under idle_mutex, after the task is
+			// queued, so that a worker about to sleep cannot miss it.
+			std::mutex idle_mutex;
+			std::condition_variable idle;
+			std::atomic<std::ptrdiff_t> ready{0};
+			for (unsigned q = 0; q < worker_count; ++q)
+				ready += std::ptrdiff_t(queues[q].tasks.size());
+
+			std::atomic<index_t> remaining{task_count};
+			std::atomic<bool> failed{false};
+			std::exception_ptr failure;
+			std::mutex failure_mutex;
+			const auto origin = std::chrono::steady_clock::now();
+			const auto now = [origin]
+			{
+				return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+			};
+
+			const auto work = [&](const unsigned worker)
+			{
+				while (remaining.load(std::memory_order_acquire) > 0)
+				{
+					index_t id = no_task;
+					for (unsigned attempt = 0; attempt < worker_count && id == no_task; ++attempt)
+					{
+						auto& queue = queues[(worker + attempt) % worker_count];
+						std::lock_guard<std::mutex> lock(queue.mutex);
+						if (queue.tasks.empty())
+							continue;
+						if (attempt == 0)
+						{
+							id = queue.tasks.back();
+							queue.tasks.pop_back();
+						}
+						else
+						{
+							id = queue.tasks.front();
+							queue.tasks.pop_front();
+						}
+					}
+					if (id == no_task)
+					{
+						std::unique_lock<std::mutex> lock(idle_mutex);
+						idle.wait(lock, [&]
+						{
+							return ready.load() > 0 || remaining.load(std::memory_order_acquire) == 0;
+						});
+						continue;
+					}
+					--ready;
+
+					auto& current = tasks[id];
+					current.worker = worker;
+					current.start = now();
+					if (!failed.load(std::memory_order_relaxed))
+					{
+						try
+						{
+							current.body();
+						}
+						catch (...)
+						{
+							std::lock_guard<std::mutex> lock(failure_mutex);
+							if (!failure)
+								failure = std::current_exception();
+							failed = true;
+						}
+					}
+					current.end = now();
+
+					for (const auto successor : current.successors)
+						if (--waiting[successor] == 0)
+						{
+							{
+								std::lock_guard<std::mutex> lock(queues[worker].mutex);
+								queues[worker].tasks.push_back(successor);
+							}
+							{
+								std::lock_guard<std::mutex> lock(idle_mutex);
+								++ready;
+							}
+							idle.notify_one();
+						}
+					if (remaining.fetch_sub(1, std::memory_order_release) == 1)
+					{
+						std::lock_guard<std::mutex> lock(idle_mutex);
+						idle.notify_all();
+					}
+				}
+			};
+
+			std::vector<std::thread> pool;
+			for (unsigned worker = 1; worker < worker_count; ++worker)
+				pool.emplace_back(work, worker);
+			work(0);
+			for (auto& thread : pool)
+				thread.join();
+			elapsed = now();
+
+			if (failure)
+				std::rethrow_exception(failure);
+		}
+
+		// The fraction of the time the workers spent running tasks, during the last run.
+		double utilization() const noexcept
+		{
+			double busy = 0;
+			for (const auto& t : tasks)
+				busy += t.end - t.start;
+			return elapsed > 0 ? busy / (elapsed * worker_count) : 0;
+		}
+
+		// Writes the trace of the last run in the Chrome trace event format, with one row per
+		// worker and times in microseconds.
+		void write_trace(std::ostream& out) const
+		{
+			// Microseconds to the nanosecond, so that short tasks late in a long run keep their place.
+			const auto flags = out.flags();
+			const auto precision = out.precision();
+			out.setf(std::ios::fixed, std::ios::floatfield);
+			out.precision(3);
+			out << "{\"traceEvents\":[";
+			for (index_t id = 0; id < tasks.size(); ++id)
+			{
+				const auto& t = tasks[id];
+				out << (id ? ",\n" : "\n") << "{\"name\":";
+				detail::write_json_string(out, t.name);
+				out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" <<
+					t.worker << ",\"ts\":" << t.start * 1e6 << ",\"dur\":" << (t.end - t.start) * 1e6 << "}";
+			}
+			out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+			out.flags(flags);
+			out.precision(precision);
+		}
+	}; // End of class task_graph.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_TASKS_H.
@@ -0,0 +1,668 @@
+/*
+ * Matrix maths: tile algorithms.
+ *
+ * A tiled_matrix stores a square matrix as square tiles, each contiguous in memory, so that
+ * blocks of the matrix occupy few pages whichever way they are walked. Multiplication and
+ * transposition work tile by tile. Cholesky, LU and QR factorizations are expressed as graphs
+ * of tasks, one per kernel applied to a tile or a pair of tiles, with the dependencies between
+ * them inferred from the tiles each one touches. Run on a task_graph, the work of later panels
+ * begins as soon as the tiles it needs are ready, overlapping the panels with the updates that
+ * a loop-parallel factorization runs between them.
+ *
+ * Each factorization has two forms: one that adds its tasks to a graph for the caller to run
+ * (and then trace), and one that runs them at once. With the first, the matrix and any other
+ * outputs must outlive the run, and are only complete once it has finished.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_TILED_H
+#define CROWSTON_MATRIX_TILED_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix_math.hpp"
+#include "matrix_lu.hpp"
+#include "matrix_orthogonal.hpp"
+#include "matrix_tasks.hpp"
+
+namespace matrix_math
+{
+	//
+	// Tiled storage.
+	//
+	// The tiles are stored in one of two orders: row by row, or along a Z-order (Morton) curve,
+	// in which each quadrant of tiles is stored contiguously, recursively, so that tiles near one
+	// another in the matrix are near one another in memory along either axis. Neither order is
+	// visible through the accessors, iterators and block copies, which address elements by row
+	// and column as for a matrix.
+	//
+	enum class tile_order
+	{
+		row_major,
+		morton
+	};
+
+	namespace detail
+	{
+		// Spreads the bits of x apart, so that bit b moves to bit 2b.
+		constexpr index_t spread_bits(index_t x) noexcept
+		{
+			index_t spread = 0;
+			for (index_t bit = 0; (x >> bit) != 0; ++bit)
+				spread |= ((x >> bit) & 1) << (2 * bit);
+			return spread;
+		}
+		// The inverse of spread_bits(), ignoring the odd bits.
+		constexpr index_t gather_bits(index_t x) noexcept
+		{
+			index_t gathered = 0;
+			for (index_t bit = 0; (x >> (2 * bit)) != 0; ++bit)
+				gathered |= ((x >> (2 * bit)) & 1) << bit;
+			return gathered;
+		}
+	} // End namespace detail.
+
+	template <index_t Size, index_t TileSize = 64, typename T = default_T, tile_order Order = tile_order::row_major>
+	class tiled_matrix
+	{
+		static_assert(Size % TileSize == 0, "Tiles must divide the matrix exactly.");
+		static_assert(Order != tile_order::morton || ((Size / TileSize) & (Size / TileSize - 1)) == 0,
+			"Z-order requires a power of two tiles on a side.");
+
+		public:
+		using type = T;
+		using self_t = tiled_matrix<Size, TileSize, T, Order>;
+		using tile_t = matrix<TileSize, TileSize, T>;
+		static constexpr index_t tile_count = Size / TileSize;
+
+		// The position in storage of the tile at [tile_row][tile_col], and the reverse.
+		static constexpr index_t storage_index(const index_t tile_row, const index_t tile_col) noexcept
+		{
+			return Order == tile_order::morton
+				? (detail::spread_bits(tile_row) << 1) | detail::spread_bits(tile_col)
+				: tile_row * tile_count + tile_col;
+		}
+		static constexpr std::pair<index_t, index_t> tile_position(const index_t index) noexcept
+		{
+			return Order == tile_order::morton
+				? std::make_pair(detail::gather_bits(index >> 1), detail::gather_bits(index))
+				: std::make_pair(index / tile_count, index % tile_count);
+		}
+
+		private:
+		std::unique_ptr<tile_t[]> tiles;
+
+		// Iteration over the elements, row by row, whatever the order of the tiles.
+		template <typename Parent, typename Value>
+		class element_iterator
+		{
+			Parent* parent;
+			index_t index;
+
+			public:
+			using iterator_category = std::random_access_iterator_tag;
+			using value_type = std::remove_const_t<Value>;
+			using difference_type = std::ptrdiff_t;
+			using pointer = Value*;
+			using reference = Value&;
+
+			element_iterator() noexcept : parent(nullptr), index(0) { }
+			element_iterator(Parent& parent, const index_t index) noexcept
+				: parent(&parent), index(index)
+			{ }
+
+			// Dereference.
+			reference operator*() const noexcept { return (*parent)(index / Size, index % Size); }
+			pointer operator->() const noexcept { return &**this; }
+			reference operator[](const difference_type n) const noexcept { return *(*this + n); }
+
+			// Increment and decrement.
+			element_iterator& operator++() noexcept { ++index; return *this; }
+			element_iterator operator++(int) noexcept
+			{
+				element_iterator unincremented{*this};
+				++index;
+				return unincremented;
+			}
+			element_iterator& operator--() noexcept { --index; return *this; }
+			element_iterator operator--(int) noexcept
+			{
+				element_iterator undecremented{*this};
+				--index;
+				return undecremented;
+			}
+
+			// Random access.
+			element_iterator& operator+=(const difference_type n) noexcept { index += n; return *this; }
+			element_iterator& operator-=(const difference_type n) noexcept { index -= n; return *this; }
+			friend element_iterator operator+(element_iterator it, const difference_type n) noexcept
+			{
+				return it += n;
+			}
+			friend element_iterator operator+(const difference_type n, element_iterator it) noexcept
+			{
+				return it += n;
+			}
+			friend element_iterator operator-(element_iterator it, const difference_type n) noexcept
+			{
+				return it -= n;
+			}
+			friend difference_type operator-(const element_iterator& lhs, const element_iterator& rhs) noexcept
+			{
+				return difference_type(lhs.index) - difference_type(rhs.index);
+			}
+
+			// Comparison. Only iterators over the same matrix are comparable.
+			friend bool operator==(const element_iterator& lhs, const element_iterator& rhs) noexcept
+			{
+				return lhs.index == rhs.index;
+			}
+			friend bool operator!=(const element_iterator& lhs, const element_iterator& rhs) noexcept
+			{
+				return lhs.index != rhs.index;
+			}
+			friend bool operator<(const element_iterator& lhs, const element_iterator& rhs) noexcept
+			{
+				return lhs.index < rhs.index;
+			}
+			friend bool operator>(const element_iterator& lhs, const element_iterator& rhs) noexcept
+			{
+				return lhs.index > rhs.index;
+			}
+			friend bool operator<=(const element_iterator& lhs, const element_iterator& rhs) noexcept
+			{
+				return lhs.index <= rhs.index;
+			}
+			friend bool operator>=(const element_iterator& lhs, const element_iterator& rhs) noexcept
+			{
+				return lhs.index >= rhs.index;
+			}
+		}; // End of class element_iterator.
+
+		public:
+		using iterator = element_iterator<self_t, T>;
+		using const_iterator = element_iterator<const self_t, const T>;
+
+		// Constructors. The default is the zero matrix.
+		tiled_matrix() : tiles(new tile_t[tile_count * tile_count]()) { }
+		explicit tiled_matrix(const matrix<Size, Size, T>& mtx) : tiled_matrix()
+		{
+			assign(mtx);
+		}
+		tiled_matrix(const tiled_matrix& other) : tiled_matrix()
+		{
+			std::copy_n(other.tiles.get(), tile_count * tile_count, tiles.get());
+		}
+		tiled_matrix(tiled_matrix&&) noexcept = default;
+		tiled_matrix& operator= (const tiled_matrix& other)
+		{
+			std::copy_n(other.tiles.get(), tile_count * tile_count, tiles.get());
+			return *this;
+		}
+		tiled_matrix& operator= (tiled_matrix&&) noexcept = default;
+
+		// Accessors, by tile and by element.
+		tile_t& tile(const index_t tile_row, const index_t tile_col) noexcept
+		{
+			return tiles[storage_index(tile_row, tile_col)];
+		}
+		const tile_t& tile(const index_t tile_row, const index_t tile_col) const noexcept
+		{
+			return tiles[storage_index(tile_row, tile_col)];
+		}
+		T& operator() (const index_t r, const index_t c) noexcept
+		{
+			return tile(r / TileSize, c / TileSize)[r % TileSize][c % TileSize];
+		}
+		const T& operator() (const index_t r, const index_t c) const noexcept
+		{
+			return tile(r / TileSize, c / TileSize)[r % TileSize][c % TileSize];
+		}
+
+		// Tiles in the order they are stored.
+		tile_t* tile_data() noexcept { return tiles.get(); }
+		const tile_t* tile_data() const noexcept { return tiles.get(); }
+
+		// Iteration over the elements, row by row.
+		iterator begin() noexcept { return iterator(*this, 0); }
+		iterator end() noexcept { return iterator(*this, Size * Size); }
+		const_iterator begin() const noexcept { return const_iterator(*this, 0); }
+		const_iterator end() const noexcept { return const_iterator(*this, Size * Size); }
+		const_iterator cbegin() const noexcept { return const_iterator(*this, 0); }
+		const_iterator cend() const noexcept { return const_iterator(*this, Size * Size); }
+
+		// Copying in and out of row-major storage.
+		void assign(const matrix<Size, Size, T>& mtx) noexcept
+		{
+			set_block(0, 0, mtx);
+		}
+		void get_matrix(matrix<Size, Size, T>& mtx) const noexcept
+		{
+			get_block(0, 0, mtx);
+		}
+
+		// Copying of blocks, which need not be aligned to tiles, as for matrix. The block's top
+		// left element is at (row, col) in this matrix.
+		template <index_t BlockHeight, index_t BlockWidth>
+		void get_block(const index_t row, const index_t col, matrix<BlockHeight, BlockWidth, T>& block) const noexcept
+		{
+			for (index_t r = 0; r < BlockHeight; ++r)
+				for (index_t c = 0; c < BlockWidth; )
+				{
+					// The rest of this row of the block within one tile.
+					const index_t x = col + c;
+					const index_t count = std::min(BlockWidth - c, TileSize - x % TileSize);
+					std::copy_n(&(*this)(row + r, x), count, block[r].begin() + c);
+					c += count;
+				}
+		}
+		template <index_t BlockHeight, index_t BlockWidth>
+		void set_block(const index_t row, const index_t col, const matrix<BlockHeight, BlockWidth, T>& block) noexcept
+		{
+			for (index_t r = 0; r < BlockHeight; ++r)
+				for (index_t c = 0; c < BlockWidth; )
+				{
+					const index_t x = col + c;
+					const index_t count = std::min(BlockWidth - c, TileSize - x % TileSize);
+					std::copy_n(block[r].begin() + c, count, &(*this)(row + r, x));
+					c += count;
+				}
+		}
+
+		// Transposition, tile by tile.
+		auto get_transpose() const
+			-> self_t
+		{
+			self_t transpose;
+			for (index_t i = 0; i < tile_count; ++i)
+				for (index_t j = 0; j < tile_count; ++j)
+				{
+					const auto& source = tile(i, j);
+					auto& target = transpose.tile(j, i);
+					for (index_t r = 0; r < TileSize; ++r)
+						for (index_t c = 0; c < TileSize; ++c)
+							target[c][r] = source[r][c];
+				}
+			return transpose;
+		}
+
+		// Comparison, elementwise, to within equality_tolerance.
+		friend bool operator== (const self_t& lhs, const self_t& rhs) noexcept
+		{
+			for (index_t t = 0; t < tile_count * tile_count; ++t)
+				if (lhs.tiles[t] != rhs.tiles[t])
+					return false;
+			return true;
+		}
+		friend bool operator!= (const self_t& lhs, const self_t& rhs) noexcept
+		{
+			return !(lhs == rhs);
+		}
+	}; // End of class tiled_matrix.
+
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	constexpr index_t tiled_matrix<Size, TileSize, T, Order>::tile_count;
+
+	// General matrix multiplication, C = alpha A B + beta C, tile by tile. The tiles of C are
+	// shared among thread_count threads in the order they are stored, so that with Z-order
+	// storage each thread works through neighbouring tiles of A and B.
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	void gemm(const T alpha, const tiled_matrix<Size, TileSize, T, Order>& a,
+		const tiled_matrix<Size, TileSize, T, Order>& b, const T beta, tiled_matrix<Size, TileSize, T, Order>& c,
+		const unsigned thread_count = std::thread::hardware_concurrency())
+	{
+		using tiled_t = tiled_matrix<Size, TileSize, T, Order>;
+		constexpr index_t tiles = tiled_t::tile_count;
+		detail::parallel_for(tiles * tiles, thread_count, [&](const index_t index)
+		{
+			const auto position = tiled_t::tile_position(index);
+			auto& target = c.tile_data()[index];
+			gemm(alpha, a.tile(position.first, 0), b.tile(0, position.second), beta, target);
+			for (index_t k = 1; k < tiles; ++k)
+				gemm(alpha, a.tile(position.first, k), b.tile(k, position.second), T(1), target);
+		});
+	}
+
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	auto operator* (const tiled_matrix<Size, TileSize, T, Order>& lhs, const tiled_matrix<Size, TileSize, T, Order>& rhs)
+		-> tiled_matrix<Size, TileSize, T, Order>
+	{
+		tiled_matrix<Size, TileSize, T, Order> product;
+		gemm(T(1), lhs, rhs, T(0), product);
+		return product;
+	}
+
+	namespace detail
+	{
+		inline std::string task_name(const char* kernel, const index_t i)
+		{
+			return std::string(kernel) + "(" + std::to_string(i) + ")";
+		}
+		inline std::string task_name(const char* kernel, const index_t i, const index_t j)
+		{
+			return std::string(kernel) + "(" + std::to_string(i) + "," + std::to_string(j) + ")";
+		}
+		inline std::string task_name(const char* kernel, const index_t i, const index_t j, const index_t k)
+		{
+			return std::string(kernel) + "(" + std::to_string(i) + "," + std::to_string(j) + "," +
+				std::to_string(k) + ")";
+		}
+
+		// B = B L⁻ᵀ, for L lower triangular.
+		template <index_t TileSize, typename T>
+		void solve_lower_transpose_right(const matrix<TileSize, TileSize, T>& l, matrix<TileSize, TileSize, T>& b) noexcept
+		{
+			for (auto& r : b)
+				for (index_t j = 0; j < TileSize; ++j)
+				{
+					T element = r[j];
+					for (index_t k = 0; k < j; ++k)
+						element -= l[j][k] * r[k];
+					r[j] = element / l[j][j];
+				}
+		}
+
+		// B = L⁻¹ B, for L unit lower triangular.
+		template <index_t TileSize, typename T>
+		void solve_unit_lower_left(const matrix<TileSize, TileSize, T>& l, matrix<TileSize, TileSize, T>& b) noexcept
+		{
+			for (index_t k = 0; k < TileSize; ++k)
+				for (index_t i = k+1; i < TileSize; ++i)
+					if (l[i][k] != T(0))
+						b[i].add_scaled(b[k], -l[i][k]);
+		}
+
+		// C = C - A Bᵀ.
+		template <index_t TileSize, typename T>
+		void subtract_product_transpose(const matrix<TileSize, TileSize, T>& a, const matrix<TileSize, TileSize, T>& b,
+			matrix<TileSize, TileSize, T>& c) noexcept
+		{
+			for (index_t r = 0; r < TileSize; ++r)
+				for (index_t col = 0; col < TileSize; ++col)
+					c[r][col] -= dot(a[r], b[col]);
+		}
+
+		// QR factorization of R stacked on A, for R upper triangular: R is replaced by the R
+		// factor of the whole and A by the reflectors. The reflector for column j is e_j in the
+		// upper part and column j of A in the lower, and is scaled as make_householder() does.
+		template <index_t TileSize, typename T>
+		void triangle_on_square_qr(matrix<TileSize, TileSize, T>& r, matrix<TileSize, TileSize, T>& a,
+			std::array<T, TileSize>& tau) noexcept
+		{
+			for (index_t j = 0; j < TileSize; ++j)
+			{
+				T scale = 0;
+				for (index_t i = 0; i < TileSize; ++i)
+					scale = std::max(scale, std::abs(a[i][j]));
+				if (scale == T(0))
+				{
+					tau[j] = T(0);
+					continue;
+				}
+				T sum = 0;
+				for (index_t i = 0; i < TileSize; ++i)
+				{
+					const T x = a[i][j] / scale;
+					sum += x * x;
+				}
+				const T alpha = r[j][j];
+				const T beta = -std::copysign(std::hypot(alpha, scale * std::sqrt(sum)), alpha);
+				tau[j] = (beta - alpha) / beta;
+				const T reciprocal = T(1) / (alpha - beta);
+				for (index_t i = 0; i < TileSize; ++i)
+					a[i][j] *= reciprocal;
+				r[j][j] = beta;
+
+				// The remaining columns: w = R[j] + vᵀ A, then R[j] -= tau w and A -= tau v w.
+				for (index_t c = j+1; c < TileSize; ++c)
+				{
+					T w = r[j][c];
+					for (index_t i = 0; i < TileSize; ++i)
+						w += a[i][j] * a[i][c];
+					w *= tau[j];
+					r[j][c] -= w;
+					for (index_t i = 0; i < TileSize; ++i)
+						a[i][c] -= a[i][j] * w;
+				}
+			}
+		}
+
+		// Applies the transpose of the Q of triangle_on_square_qr(), with reflectors v, to B
+		// stacked on C.
+		template <index_t TileSize, typename T>
+		void apply_triangle_on_square_qt(const matrix<TileSize, TileSize, T>& v, const std::array<T, TileSize>& tau,
+			matrix<TileSize, TileSize, T>& b, matrix<TileSize, TileSize, T>& c) noexcept
+		{
+			for (index_t j = 0; j < TileSize; ++j)
+			{
+				if (tau[j] == T(0))
+					continue;
+				row<TileSize, T> w = b[j];
+				for (index_t i = 0; i < TileSize; ++i)
+					if (v[i][j] != T(0))
+						w.add_scaled(c[i], v[i][j]);
+				b[j].add_scaled(w, -tau[j]);
+				for (index_t i = 0; i < TileSize; ++i)
+					if (v[i][j] != T(0))
+						c[i].add_scaled(w, -tau[j] * v[i][j]);
+			}
+		}
+	} // End namespace detail.
+
+	//
+	// Cholesky factorization, A = L Lᵀ.
+	//
+	// The lower tiles are replaced by L; the tiles above the diagonal are left alone. A task
+	// throws matrix_not_positive_definite_error if A is not positive definite.
+	//
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	void tiled_cholesky(tiled_matrix<Size, TileSize, T, Order>& a, task_graph& graph)
+	{
+		constexpr index_t tiles = Size / TileSize;
+		for (index_t k = 0; k < tiles; ++k)
+		{
+			auto& diagonal = a.tile(k, k);
+			graph.add(detail::task_name("potrf", k), [&diagonal] { diagonal = cholesky(diagonal); },
+				{}, {&diagonal});
+			for (index_t i = k+1; i < tiles; ++i)
+			{
+				auto& target = a.tile(i, k);
+				graph.add(detail::task_name("trsm", i, k), [&diagonal, &target]
+					{ detail::solve_lower_transpose_right(diagonal, target); },
+					{&diagonal}, {&target});
+			}
+			for (index_t i = k+1; i < tiles; ++i)
+			{
+				const auto& left = a.tile(i, k);
+				for (index_t j = k+1; j < i; ++j)
+				{
+					const auto& right = a.tile(j, k);
+					auto& target = a.tile(i, j);
+					graph.add(detail::task_name("gemm", i, j, k), [&left, &right, &target]
+						{ detail::subtract_product_transpose(left, right, target); },
+						{&left, &right}, {&target});
+				}
+				auto& target = a.tile(i, i);
+				graph.add(detail::task_name("syrk", i, k), [&left, &target]
+					{ syrk(T(-1), left, T(1), target); },
+					{&left}, {&target});
+			}
+		}
+	}
+
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	void tiled_cholesky(tiled_matrix<Size, TileSize, T, Order>& a,
+		const unsigned thread_count = std::thread::hardware_concurrency())
+	{
+		task_graph graph;
+		tiled_cholesky(a, graph);
+		graph.run(thread_count);
+	}
+
+	//
+	// LU factorization with partial pivoting, P A = L U, as by lu_blocked() with panels one tile
+	// wide. Each panel is factorized by one task over the column of tiles below the diagonal; its
+	// row interchanges are then applied to every other column of tiles by tasks of their own.
+	// A task throws matrix_is_degenerate_error if A is degenerate.
+	//
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	void tiled_lu(tiled_matrix<Size, TileSize, T, Order>& a, row_permutation<Size>& permutation, task_graph& graph)
+	{
+		constexpr index_t tiles = Size / TileSize;
+		std::iota(permutation.begin(), permutation.end(), index_t(0));
+		// The row interchanged with each row of the panel, as it was factorized.
+		const auto interchanges = std::make_shared<std::array<index_t, Size>>();
+
+		for (index_t k = 0; k < tiles; ++k)
+		{
+			std::vector<const void*> column;
+			for (index_t i = k; i < tiles; ++i)
+				column.push_back(&a.tile(i, k));
+			column.push_back(&permutation);
+			const std::array<const void*, 0> nothing{};
+			graph.add(detail::task_name("getrf", k), [&a, &permutation, interchanges, k]
+			{
+				for (index_t j = 0; j < TileSize; ++j)
+				{
+					const index_t pivot_row = k * TileSize + j;
+					index_t p = pivot_row;
+					for (index_t i = pivot_row + 1; i < Size; ++i)
+						if (std::abs(a(i, pivot_row)) > std::abs(a(p, pivot_row)))
+							p = i;
+					if (std::abs(a(p, pivot_row)) <= equality_tolerance)
+						throw matrix_is_degenerate_error();
+					(*interchanges)[pivot_row] = p;
+					if (p != pivot_row)
+					{
+						std::swap_ranges(a.tile(k, k)[j].begin(), a.tile(k, k)[j].end(),
+							a.tile(p / TileSize, k)[p % TileSize].begin());
+						std::swap(permutation[pivot_row], permutation[p]);
+					}
+
+					const auto& pivot = a.tile(k, k)[j];
+					const T reciprocal = T(1) / pivot[j];
+					for (index_t i = k; i < tiles; ++i)
+						for (index_t r = (i == k ? j+1 : 0); r < TileSize; ++r)
+						{
+							auto& target = a.tile(i, k)[r];
+							const T factor = target[j] *= reciprocal;
+							if (factor != T(0))
+								target.add_scaled(pivot, -factor, j+1);
+						}
+				}
+			}, nothing.begin(), nothing.end(), column.begin(), column.end());
+
+			for (index_t j = 0; j < tiles; ++j)
+			{
+				if (j == k)
+					continue;
+				std::vector<const void*> targets;
+				for (index_t i = k; i < tiles; ++i)
+					targets.push_back(&a.tile(i, j));
+				const std::array<const void*, 1> diagonal{ {&a.tile(k, k)} };
+				graph.add(detail::task_name(j < k ? "laswp" : "trsm", k, j), [&a, interchanges, k, j]
+				{
+					for (index_t r = 0; r < TileSize; ++r)
+					{
+						const index_t p = (*interchanges)[k * TileSize + r];
+						if (p != k * TileSize + r)
+							std::swap(a.tile(k, j)[r], a.tile(p / TileSize, j)[p % TileSize]);
+					}
+					if (j > k)
+						detail::solve_unit_lower_left(a.tile(k, k), a.tile(k, j));
+				}, diagonal.begin(), diagonal.end(), targets.begin(), targets.end());
+			}
+
+			for (index_t i = k+1; i < tiles; ++i)
+				for (index_t j = k+1; j < tiles; ++j)
+				{
+					const auto& left = a.tile(i, k);
+					const auto& right = a.tile(k, j);
+					auto& target = a.tile(i, j);
+					graph.add(detail::task_name("gemm", i, j, k), [&left, &right, &target]
+						{ gemm(T(-1), left, right, T(1), target); },
+						{&left, &right}, {&target});
+				}
+		}
+	}
+
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	void tiled_lu(tiled_matrix<Size, TileSize, T, Order>& a, row_permutation<Size>& permutation,
+		const unsigned thread_count = std::thread::hardware_concurrency())
+	{
+		task_graph graph;
+		tiled_lu(a, permutation, graph);
+		graph.run(thread_count);
+	}
+
+	//
+	// QR factorization, A = Q R, by Householder reflectors. The upper triangles of the diagonal
+	// tiles and the tiles above them are replaced by R. Q is kept as reflectors: those of the
+	// diagonal tiles as by householder_qr(), and those that eliminate each tile below the
+	// diagonal in that tile, with the factors of each tile's reflectors in tau at the tile's
+	// index (row * tile_count + column).
+	//
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	void tiled_qr(tiled_matrix<Size, TileSize, T, Order>& a, std::vector<std::array<T, TileSize>>& tau,
+		task_graph& graph)
+	{
+		constexpr index_t tiles = Size / TileSize;
+		tau.assign(tiles * tiles, std::array<T, TileSize>{});
+		for (index_t k = 0; k < tiles; ++k)
+		{
+			auto& diagonal = a.tile(k, k);
+			auto& diagonal_tau = tau[k * tiles + k];
+			graph.add(detail::task_name("geqrt", k), [&diagonal, &diagonal_tau]
+				{ householder_qr_unblocked(diagonal.view(), diagonal_tau); },
+				{}, {&diagonal, &diagonal_tau});
+			for (index_t j = k+1; j < tiles; ++j)
+			{
+				auto& target = a.tile(k, j);
+				graph.add(detail::task_name("unmqr", k, j), [&diagonal, &diagonal_tau, &target]
+					{ apply_q(diagonal, diagonal_tau, target, true); },
+					{&diagonal, &diagonal_tau}, {&target});
+			}
+			for (index_t i = k+1; i < tiles; ++i)
+			{
+				auto& below = a.tile(i, k);
+				auto& below_tau = tau[i * tiles + k];
+				graph.add(detail::task_name("tsqrt", i, k), [&diagonal, &below, &below_tau]
+					{ detail::triangle_on_square_qr(diagonal, below, below_tau); },
+					{}, {&diagonal, &below, &below_tau});
+				for (index_t j = k+1; j < tiles; ++j)
+				{
+					auto& upper = a.tile(k, j);
+					auto& lower = a.tile(i, j);
+					graph.add(detail::task_name("tsmqr", i, j, k), [&below, &below_tau, &upper, &lower]
+						{ detail::apply_triangle_on_square_qt(below, below_tau, upper, lower); },
+						{&below, &below_tau}, {&upper, &lower});
+				}
+			}
+		}
+	}
+
+	template <index_t Size, index_t TileSize, typename T, tile_order Order>
+	void tiled_qr(tiled_matrix<Size, TileSize, T, Order>& a, std::vector<std::array<T, TileSize>>& tau,
+		const unsigned thread_count = std::thread::hardware_concurrency())
+	{
+		task_graph graph;
+		tiled_qr(a, tau, graph);
+		graph.run(thread_count);
+	}
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_TILED_H.
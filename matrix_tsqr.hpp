@@ -0,0 +1,183 @@
+/*
+ * Matrix maths: tall-skinny QR factorization (TSQR).
+ *
+ * For a matrix with very many rows and few columns, given as rows of memory rather than as a
+ * matrix object. The rows are divided into panels of PanelHeight rows, each panel is factorized
+ * independently (in parallel), and the R factors of the panels are then combined pairwise, level
+ * by level, in a reduction tree whose root gives the R factor of the whole. Q is kept implicitly,
+ * as the reflectors of every panel and every tree node. The data is read once.
+ *
+ *
+ * Requires C++14 or later.
+ *
+ */
+
+#ifndef CROWSTON_MATRIX_TSQR_H
+#define CROWSTON_MATRIX_TSQR_H
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "matrix_math.hpp"
+#include "matrix_orthogonal.hpp"
+
+namespace matrix_math
+{
+	namespace detail
+	{
+		// The R factor held in the upper triangle of a QR factorization.
+		template <index_t Height, index_t Width, typename T>
+		auto upper_triangle(const matrix<Height, Width, T>& qr) noexcept
+			-> matrix<Width, Width, T>
+		{
+			matrix<Width, Width, T> r {};
+			for (index_t i = 0; i < Width; ++i)
+				for (index_t j = i; j < Width; ++j)
+					r[i][j] = qr[i][j];
+			return r;
+		}
+	} // End namespace detail.
+
+	template <index_t Width, index_t PanelHeight = 1024, typename T = default_T>
+	class tsqr_factorization
+	{
+		static_assert(PanelHeight >= Width, "Panels must have at least as many rows as columns.");
+
+		public:
+		using r_t = matrix<Width, Width, T>;
+
+		private:
+		// A factorized panel.
+		struct leaf
+		{
+			std::unique_ptr<matrix<PanelHeight, Width, T>> qr;
+			std::array<T, Width> tau;
+		};
+		// A factorized pair of R factors, stacked.
+		struct node
+		{
+			matrix<2*Width, Width, T> qr;
+			std::array<T, Width> tau;
+		};
+
+		index_t row_count;
+		std::vector<leaf> leaves;
+		// levels[l] combines the outputs of level l-1 (or of the leaves) in pairs. An output left
+		// unpaired at the end of a level passes up unchanged.
+		std::vector<std::vector<node>> levels;
+		r_t r_factor;
+		unsigned thread_count;
+
+		public:
+		// Factorizes the rows x Width matrix whose rows begin every stride elements from data.
+		tsqr_factorization(const T* const data, const index_t rows, const index_t stride = Width,
+			const unsigned thread_count = std::thread::hardware_concurrency())
+			: row_count(rows), leaves((rows + PanelHeight - 1) / PanelHeight), thread_count(thread_count)
+		{
+			std::vector<r_t> r_factors(leaves.size());
+
+			// Factorize each panel. Rows past the end of the data are zero, which leaves R alone.
+			detail::parallel_for(leaves.size(), thread_count, [&](const index_t p)
+			{
+				auto& panel = leaves[p];
+				panel.qr = std::make_unique<matrix<PanelHeight, Width, T>>();
+				const index_t first = p * PanelHeight;
+				const index_t panel_rows = std::min(PanelHeight, rows - first);
+				for (index_t r = 0; r < panel_rows; ++r)
+					std::copy_n(data + (first + r) * stride, Width, (*panel.qr)[r].begin());
+				householder_qr(*panel.qr, panel.tau);
+				r_factors[p] = detail::upper_triangle(*panel.qr);
+			});
+
+			// Combine the R factors pairwise until one remains.
+			while (r_factors.size() > 1)
+			{
+				std::vector<node> level(r_factors.size() / 2);
+				std::vector<r_t> combined((r_factors.size() + 1) / 2);
+				detail::parallel_for(level.size(), thread_count, [&](const index_t n)
+				{
+					auto& pair = level[n];
+					pair.qr.set_block(0, 0, r_factors[2*n]);
+					pair.qr.set_block(Width, 0, r_factors[2*n+1]);
+					householder_qr(pair.qr, pair.tau);
+					combined[n] = detail::upper_triangle(pair.qr);
+				});
+				if (r_factors.size() % 2 == 1)
+					combined.back() = r_factors.back();
+				levels.push_back(std::move(level));
+				r_factors = std::move(combined);
+			}
+			if (!r_factors.empty())
+				r_factor = r_factors.front();
+		}
+
+		// The R factor.
+		const r_t& r() const noexcept { return r_factor; }
+
+		// The number of rows factorized.
+		index_t rows() const noexcept { return row_count; }
+
+		// The leading Width elements of Qᵀ b, for b a vector of rows() elements (stride elements
+		// apart). The rest of Qᵀ b only contributes to the residual of a least squares problem.
+		auto apply_transpose(const T* const b, const index_t stride = 1) const
+			-> row<Width, T>
+		{
+			std::vector<matrix<Width, 1, T>> parts(leaves.size());
+			detail::parallel_for(leaves.size(), thread_count, [&](const index_t p)
+			{
+				auto c = std::make_unique<matrix<PanelHeight, 1, T>>();
+				const index_t first = p * PanelHeight;
+				const index_t panel_rows = std::min(PanelHeight, row_count - first);
+				for (index_t r = 0; r < panel_rows; ++r)
+					(*c)[r][0] = b[(first + r) * stride];
+				apply_q(*leaves[p].qr, leaves[p].tau, *c, true);
+				(*c).get_block(0, 0, parts[p]);
+			});
+
+			for (const auto& level : levels)
+			{
+				std::vector<matrix<Width, 1, T>> combined((parts.size() + 1) / 2);
+				for (index_t n = 0; n < level.size(); ++n)
+				{
+					matrix<2*Width, 1, T> c;
+					c.set_block(0, 0, parts[2*n]);
+					c.set_block(Width, 0, parts[2*n+1]);
+					apply_q(level[n].qr, level[n].tau, c, true);
+					c.get_block(0, 0, combined[n]);
+				}
+				if (parts.size() % 2 == 1)
+					combined.back() = parts.back();
+				parts = std::move(combined);
+			}
+
+			row<Width, T> result;
+			if (!parts.empty())
+				for (index_t i = 0; i < Width; ++i)
+					result[i] = parts.front()[i][0];
+			return result;
+		}
+
+		// The least squares solution x of A x = b, by back substitution in R x = (Qᵀ b)[0:Width).
+		// Throws matrix_is_degenerate_error if A is rank deficient.
+		auto solve(const T* const b, const index_t stride = 1) const
+			-> row<Width, T>
+		{
+			auto x = apply_transpose(b, stride);
+			for (index_t i = Width; i-- > 0; )
+			{
+				if (std::abs(r_factor[i][i]) <= equality_tolerance)
+					throw matrix_is_degenerate_error();
+				for (index_t k = i+1; k < Width; ++k)
+					x[i] -= r_factor[i][k] * x[k];
+				x[i] /= r_factor[i][i];
+			}
+			return x;
+		}
+	}; // End of class tsqr_factorization.
+
+} // End namespace matrix_math.
+
+#endif // End ifndef CROWSTON_MATRIX_TSQR_H.
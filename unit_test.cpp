@@ -7,17 +7,86 @@
  * Author: Robert H. Crowston, 2017.
  *
  *
- * Invoke with c++ -std=c++14 -O3
+ * Invoke with c++ -std=c++14 -O3 unit_test.cpp matrix_capi.cpp
  *
  */
 
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#include <sys/wait.h>
+
 #include "matrix_math.hpp"
+#include "matrix_capi.h"
+#include "matrix_codec.hpp"
+#include "matrix_eigen.hpp"
+#include "matrix_io.hpp"
+#include "matrix_lu.hpp"
+#include "matrix_npy.hpp"
+#include "matrix_orthogonal.hpp"
+#include "matrix_ring.hpp"
+#include "matrix_series.hpp"
+#include "matrix_service.hpp"
+#include "matrix_shared.hpp"
+#include "matrix_symmetric.hpp"
+#include "matrix_tasks.hpp"
+#include "matrix_tiled.hpp"
+#include "matrix_tsqr.hpp"
 
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
 using namespace matrix_math;
 
+// Reference product, by the definition.
+template <index_t Height, index_t InnerSize, index_t Width>
+matrix<Height, Width> naive_product(const matrix<Height, InnerSize>& lhs, const matrix<InnerSize, Width>& rhs)
+{
+	matrix<Height, Width> product;
+	for (index_t r = 0; r < Height; ++r)
+		for (index_t c = 0; c < Width; ++c)
+			for (index_t k = 0; k < InnerSize; ++k)
+				product[r][c] += lhs[r][k] * rhs[k][c];
+	return product;
+}
+
+// Fills a matrix with small integers in a pattern determined by seed.
+template <index_t Height, index_t Width>
+matrix<Height, Width> patterned_matrix(unsigned seed)
+{
+	matrix<Height, Width> mtx;
+	for (index_t r = 0; r < Height; ++r)
+		for (index_t c = 0; c < Width; ++c)
+			mtx[r][c] = double((r * 7 + c * 3 + seed) % 11) - 5;
+	return mtx;
+}
+
+template <index_t Size>
+square_matrix<Size> add_to_diagonal(square_matrix<Size> mtx, const double value)
+{
+	for (index_t d = 0; d < Size; ++d)
+		mtx[d][d] += value;
+	return mtx;
+}
+
+// Patterned matrices made diagonally dominant, one for each seed in [0, count). Where
+// degenerate_every is given, every degenerate_every-th from degenerate_first is made degenerate
+// by repeating its first row.
+template <index_t Size>
+std::vector<square_matrix<Size>> dominant_batch(const unsigned count, const unsigned degenerate_every = 0,
+	const unsigned degenerate_first = 0)
+{
+	std::vector<square_matrix<Size>> batch;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		batch.push_back(add_to_diagonal(patterned_matrix<Size, Size>(i), 10));
+		if (degenerate_every != 0 && i % degenerate_every == degenerate_first)
+			batch.back()[1] = batch.back()[0];
+	}
+	return batch;
+}
+
 TEST_CASE( "1x1 matrices.", "[1x1]" ) 
 {
 
@@ -66,13 +135,13 @@ TEST_CASE( "2x2 matrices.", "[2x2]" )
 
 		square_matrix<2> mtx_3{ {0.7, 1.99}, {24.1, 9999} };
 		REQUIRE( mtx_3.get_inverse() * mtx_3 == identity );
+
+		square_matrix<2> mtx_4{ {0, 1}, {1, 0} };
+		REQUIRE( mtx_4.get_inverse() == mtx_4 );
 	}
 	
 	SECTION( "Degenerate matrices." )
 	{
-		square_matrix<2> mtx_4{ {0, 1}, {1, 0} };
-		CHECK_THROWS(mtx_4.invert());
-		
 		square_matrix<2> mtx_5{ {2, 6}, {1, 3} };
 		CHECK_THROWS(mtx_5.invert());
 		
@@ -184,3 +253,1822 @@ TEST_CASE( "7x7 matrices.", "[7x7]" )
 	}
 }
 
+
+TEST_CASE( "Column iteration.", "[columns]" )
+{
+	const matrix<3, 2> mtx{
+		{ 1,  4},
+		{ 2,  5},
+		{ 3,  6}
+	};
+
+	SECTION( "Random access." )
+	{
+		auto first = mtx.column_cbegin(1);
+		auto last = mtx.column_cend(1);
+		REQUIRE( last - first == 3 );
+		REQUIRE( std::distance(first, last) == 3 );
+		REQUIRE( first[2] == 6 );
+		REQUIRE( *(first + 1) == 5 );
+		REQUIRE( *(last - 1) == 6 );
+		REQUIRE( first < last );
+		REQUIRE( std::accumulate(first, last, 0.0) == 15 );
+		REQUIRE( *std::max_element(mtx.column_cbegin(0), mtx.column_cend(0)) == 3 );
+	}
+	SECTION( "Packing." )
+	{
+		const auto column = mtx.get_column(0);
+		REQUIRE( column[0] == 1 );
+		REQUIRE( column[2] == 3 );
+
+		const matrix<2, 3> transpose{
+			{ 1,  2,  3},
+			{ 4,  5,  6}
+		};
+		REQUIRE( mtx.get_transpose() == transpose );
+	}
+}
+
+TEST_CASE( "Fused multiply-add kernels.", "[fma]" )
+{
+	SECTION( "Multiply-add." )
+	{
+		REQUIRE( multiply_add<true>(2.0, 3.0, 1.0) == 7.0 );
+		REQUIRE( multiply_add<false>(2.0, 3.0, 1.0) == 7.0 );
+		REQUIRE( multiply_add<true>(2, 3, 1) == 7 );
+
+		// 1 + 2^-30 squared is 1 + 2^-29 + 2^-60; only the fused form retains the final term.
+		const double a = 1.0 + std::ldexp(1.0, -30);
+		const double c = -(1.0 + std::ldexp(1.0, -29));
+		REQUIRE( multiply_add<true>(a, a, c) == std::ldexp(1.0, -60) );
+	}
+	SECTION( "Row kernels." )
+	{
+		const row<3> lhs{1, 2, 3};
+		row<3> rhs{4, 5, 6};
+		REQUIRE( dot<true>(lhs, rhs) == 32 );
+		REQUIRE( dot<false>(lhs, rhs) == 32 );
+
+		rhs.add_scaled(lhs, -2);
+		REQUIRE( rhs[0] == 2 );
+		REQUIRE( rhs[1] == 1 );
+		REQUIRE( rhs[2] == 0 );
+	}
+}
+
+TEST_CASE( "Blocked inversion.", "[blocked]" )
+{
+	SECTION( "Small leaf sizes." )
+	{
+		square_matrix<7> mtx{
+			{ 1,  2,  3,  4,  0, -1,  0},
+			{ 0,  1,  1,  0,  1,  0,  0},
+			{ 1,  0,  0,  0,  0,  1,  0},
+			{ 0,  2,  2,  2, -2,  1,  3},
+			{ 1,  3,  5,  7,  0, -1,  1},
+			{ 0,  0,  1,  0,  1,  0,  0},
+			{ 9, -2,  0,  0,  0,  2,  0}
+		};
+		auto inverse = mtx;
+		inverse.invert_blocked<1>();
+		REQUIRE( inverse == mtx.get_inverse() );
+		inverse = mtx;
+		inverse.invert_blocked<3>();
+		REQUIRE( inverse == mtx.get_inverse() );
+	}
+	SECTION( "Degenerate leading block." )
+	{
+		// The leading 2x2 block is singular, so this inverts by the Gauss--Jordan fallback.
+		square_matrix<4> mtx{
+			{ 4,  0,  0,  0},
+			{ 0,  0,  2,  0},
+			{ 0,  1,  2,  0},
+			{ 1,  0,  0,  1}
+		};
+		auto inverse = mtx;
+		inverse.invert_blocked<2>();
+		REQUIRE( mtx * inverse == square_matrix<4>::get_identity_matrix() );
+
+		square_matrix<4> degenerate{
+			{ 1,  2,  3,  4},
+			{ 2,  4,  6,  8},
+			{ 0,  1,  0,  1},
+			{ 1,  0,  1,  0}
+		};
+		CHECK_THROWS( degenerate.invert_blocked<2>() );
+	}
+	SECTION( "Above the default leaf size." )
+	{
+		constexpr index_t size = inversion_leaf_size + 9;
+		square_matrix<size> mtx;
+		for (index_t r = 0; r < size; ++r)
+			for (index_t c = 0; c < size; ++c)
+				mtx[r][c] = (r == c) ? double(size) : double((r * 7 + c * 3) % 5) - 2;
+		auto inverse = mtx;
+		inverse.invert_blocked();
+		REQUIRE( mtx * inverse == square_matrix<size>::get_identity_matrix() );
+		REQUIRE( inverse == mtx.get_inverse() );
+	}
+}
+
+TEST_CASE( "Eigenvalues of nonsymmetric matrices.", "[eigen]" )
+{
+	auto sorted = [](auto values)
+	{
+		std::sort(values.begin(), values.end(), [](auto lhs, auto rhs)
+		{
+			return lhs.real() < rhs.real() || (lhs.real() == rhs.real() && lhs.imag() < rhs.imag());
+		});
+		return values;
+	};
+
+	SECTION( "Real eigenvalues." )
+	{
+		square_matrix<2> companion{ {0, 1}, {-2, -3} };
+		const auto values = sorted(eigenvalues(companion));
+		REQUIRE( values[0].real() == Approx(-2) );
+		REQUIRE( values[1].real() == Approx(-1) );
+		REQUIRE( values[0].imag() == 0 );
+
+		square_matrix<4> triangular{
+			{ 4,  1,  2,  3},
+			{ 0,  3,  1,  2},
+			{ 0,  0,  2,  1},
+			{ 0,  0,  0,  1}
+		};
+		const auto triangular_values = sorted(eigenvalues(triangular));
+		for (index_t i = 0; i < 4; ++i)
+			REQUIRE( triangular_values[i].real() == Approx(i + 1) );
+	}
+	SECTION( "Complex eigenvalues." )
+	{
+		square_matrix<3> rotation{
+			{ 0, -1,  0},
+			{ 1,  0,  0},
+			{ 0,  0,  2}
+		};
+		const auto values = sorted(eigenvalues(rotation));
+		REQUIRE( values[0].real() == Approx(0).margin(1e-12) );
+		REQUIRE( values[0].imag() == Approx(-1) );
+		REQUIRE( values[1].imag() == Approx(1) );
+		REQUIRE( values[2].real() == Approx(2) );
+	}
+	SECTION( "Eigenvectors." )
+	{
+		square_matrix<4> mtx{
+			{ 1,  2,  3,  4},
+			{-1,  0,  2,  1},
+			{ 3,  1, -2,  0},
+			{ 0,  5,  1,  1}
+		};
+		const auto decomposition = eigen_decompose(mtx);
+		for (index_t v = 0; v < 4; ++v)
+			for (index_t r = 0; r < 4; ++r)
+			{
+				std::complex<double> product = 0;
+				for (index_t c = 0; c < 4; ++c)
+					product += mtx[r][c] * decomposition.vectors[c][v];
+				const auto expected = decomposition.values[v] * decomposition.vectors[r][v];
+				REQUIRE( std::abs(product - expected) < 1e-9 );
+			}
+	}
+	SECTION( "Batches." )
+	{
+		std::array<square_matrix<2>, 3> batch{ {
+			{ {1, 0}, {0, 2} },
+			{ {2, 0}, {0, 3} },
+			{ {0, 1}, {-1, 0} }
+		} };
+		std::array<std::array<std::complex<double>, 2>, 3> values;
+		eigenvalues(batch.begin(), batch.end(), values.begin());
+		REQUIRE( sorted(values[1])[1].real() == Approx(3) );
+		REQUIRE( std::abs(sorted(values[2])[1].imag()) == Approx(1) );
+	}
+}
+
+TEST_CASE( "Eigenvalues of symmetric matrices.", "[eigen]" )
+{
+	SECTION( "Standard problem." )
+	{
+		square_matrix<3> mtx{
+			{ 2, -1,  0},
+			{-1,  2, -1},
+			{ 0, -1,  2}
+		};
+		const auto decomposition = symmetric_eigen_decompose(mtx);
+		REQUIRE( decomposition.values[0] == Approx(2 - std::sqrt(2.0)) );
+		REQUIRE( decomposition.values[1] == Approx(2) );
+		REQUIRE( decomposition.values[2] == Approx(2 + std::sqrt(2.0)) );
+
+		square_matrix<3> diagonal{};
+		for (index_t i = 0; i < 3; ++i)
+			diagonal[i][i] = decomposition.values[i];
+		const auto& vectors = decomposition.vectors;
+		REQUIRE( vectors * diagonal * vectors.get_transpose() == mtx );
+	}
+	SECTION( "Generalized problem." )
+	{
+		square_matrix<3> a{
+			{ 4,  1,  0},
+			{ 1,  3,  1},
+			{ 0,  1,  2}
+		};
+		square_matrix<3> b{
+			{ 2,  1,  0},
+			{ 1,  2,  0},
+			{ 0,  0,  1}
+		};
+		const auto decomposition = generalized_symmetric_eigen_decompose(a, b);
+		for (index_t v = 0; v < 3; ++v)
+		{
+			row<3> x;
+			for (index_t r = 0; r < 3; ++r)
+				x[r] = decomposition.vectors[r][v];
+			for (index_t r = 0; r < 3; ++r)
+				REQUIRE( dot(a[r], x) == Approx(decomposition.values[v] * dot(b[r], x)) );
+		}
+
+		square_matrix<2> indefinite{ {1, 2}, {2, 1} };
+		CHECK_THROWS_AS( generalized_symmetric_eigen_decompose(indefinite, indefinite), const matrix_not_positive_definite_error& );
+	}
+}
+
+TEST_CASE( "Shared matrices.", "[shared]" )
+{
+	const square_matrix<3> mtx{
+		{ 1,  2,  3},
+		{ 0,  1,  4},
+		{ 5,  6,  0}
+	};
+
+	SECTION( "Handles." )
+	{
+		const shared_matrix<3, 3> standard{mtx};
+		const shared_matrix<3, 3> huge{mtx, shared_storage::huge_pages};
+		REQUIRE( *standard == mtx );
+		REQUIRE( *huge == mtx );
+		REQUIRE( standard != huge );
+		REQUIRE( standard->get_inverse() == mtx.get_inverse() );
+
+		const auto copy = huge;
+		REQUIRE( copy == huge );
+		REQUIRE( huge.use_count() == 2 );
+	}
+	SECTION( "Interning." )
+	{
+		matrix_pool<3, 3> pool;
+		auto first = pool.intern(mtx);
+		auto second = pool.intern(mtx);
+		REQUIRE( first == second );
+		REQUIRE( pool.size() == 1 );
+
+		auto different = mtx;
+		different[2][2] = 1;
+		auto third = pool.intern(different);
+		REQUIRE( third != first );
+		REQUIRE( *third == different );
+		REQUIRE( pool.size() == 2 );
+
+		third = first;
+		pool.purge();
+		REQUIRE( pool.size() == 1 );
+	}
+}
+
+TEST_CASE( "Rectangular multiplication.", "[multiplication]" )
+{
+	SECTION( "Tall-skinny." )
+	{
+		const auto lhs = patterned_matrix<1000, 6>(1);
+		const auto rhs = patterned_matrix<6, 6>(2);
+		REQUIRE( lhs * rhs == naive_product(lhs, rhs) );
+	}
+	SECTION( "Short-wide." )
+	{
+		const auto lhs = patterned_matrix<2, 20>(3);
+		const auto rhs = patterned_matrix<20, 50>(4);
+		REQUIRE( lhs * rhs == naive_product(lhs, rhs) );
+	}
+	SECTION( "Outer product." )
+	{
+		const auto lhs = patterned_matrix<5, 1>(5);
+		const auto rhs = patterned_matrix<1, 4>(6);
+		REQUIRE( lhs * rhs == naive_product(lhs, rhs) );
+	}
+	SECTION( "General." )
+	{
+		const auto lhs = patterned_matrix<12, 15>(7);
+		const auto rhs = patterned_matrix<15, 10>(8);
+		REQUIRE( lhs * rhs == naive_product(lhs, rhs) );
+	}
+	SECTION( "Mixed types." )
+	{
+		const matrix<2, 2, int> lhs{ {1, 2}, {3, 4} };
+		const matrix<2, 3> rhs{ {0.5, 1, 0}, {0, 1, 0.25} };
+		const matrix<2, 3> product{ {0.5, 3, 0.5}, {1.5, 7, 1} };
+		REQUIRE( lhs * rhs == product );
+	}
+}
+
+TEST_CASE( "In place accumulation.", "[accumulation]" )
+{
+	SECTION( "gemm." )
+	{
+		const auto a = patterned_matrix<9, 70>(1);
+		const auto b = patterned_matrix<70, 5>(2);
+		auto c = patterned_matrix<9, 5>(3);
+		auto expected = naive_product(a, b);
+		expected *= 2;
+		auto scaled_c = c;
+		scaled_c *= -3;
+		expected += scaled_c;
+		gemm(2.0, a, b, -3.0, c);
+		REQUIRE( c == expected );
+
+		// With beta zero, the prior content of C is ignored, even if not a number.
+		c[0][0] = std::nan("");
+		gemm(1.0, a, b, 0.0, c);
+		REQUIRE( c == naive_product(a, b) );
+	}
+	SECTION( "ger." )
+	{
+		const row<3> x{1, 2, 3};
+		const row<2> y{4, 5};
+		matrix<3, 2> a{ {1, 1}, {1, 1}, {1, 1} };
+		ger(2.0, x, y, a);
+		const matrix<3, 2> expected{ {9, 11}, {17, 21}, {25, 31} };
+		REQUIRE( a == expected );
+	}
+	SECTION( "syrk." )
+	{
+		const auto a = patterned_matrix<6, 4>(4);
+		auto c = square_matrix<6>::get_identity_matrix();
+		auto expected = naive_product(a, a.get_transpose());
+		expected *= 0.5;
+		expected += square_matrix<6>::get_identity_matrix();
+		syrk(0.5, a, 1.0, c);
+		REQUIRE( c == expected );
+		REQUIRE( c == c.get_transpose() );
+	}
+}
+
+TEST_CASE( "Symmetric matrices.", "[symmetric]" )
+{
+	const symmetric_matrix<4> mtx{
+		{ 4},
+		{ 1,  0},
+		{-2,  3,  1},
+		{ 0,  5, -1,  2}
+	};
+	const auto full = mtx.get_matrix();
+
+	SECTION( "Storage." )
+	{
+		REQUIRE( symmetric_matrix<4>::packed_size == 10 );
+		REQUIRE( sizeof(mtx) == 10 * sizeof(double) );
+		REQUIRE( mtx(1, 3) == 5 );
+		REQUIRE( mtx(3, 1) == 5 );
+		REQUIRE( full == full.get_transpose() );
+		REQUIRE( symmetric_matrix<4>{full} == mtx );
+	}
+	SECTION( "Products." )
+	{
+		const auto b = patterned_matrix<4, 3>(1);
+		REQUIRE( mtx * b == naive_product(full, b) );
+
+		auto c = patterned_matrix<4, 3>(2);
+		auto expected = naive_product(full, b);
+		expected *= 2;
+		expected += c;
+		symm(2.0, mtx, b, 1.0, c);
+		REQUIRE( c == expected );
+
+		const auto a = patterned_matrix<4, 6>(3);
+		symmetric_matrix<4> product;
+		syrk(1.0, a, 0.0, product);
+		REQUIRE( product.get_matrix() == naive_product(a, a.get_transpose()) );
+	}
+	SECTION( "Bunch--Kaufman factorization." )
+	{
+		// Indefinite, with a zero on the diagonal, so a 2x2 pivot is needed.
+		const auto factorization = ldlt(mtx);
+		const auto b = patterned_matrix<4, 2>(4);
+		REQUIRE( naive_product(full, factorization.solve(b)) == b );
+
+		const row<4> rhs{1, 2, 3, 4};
+		const auto x = factorization.solve(rhs);
+		for (index_t r = 0; r < 4; ++r)
+			REQUIRE( dot(full[r], x) == Approx(rhs[r]) );
+
+		const symmetric_matrix<2> swap{ {0}, {1, 0} };
+		const auto swap_factorization = ldlt(swap);
+		REQUIRE( swap_factorization.in_2x2_block[0] );
+		REQUIRE( swap_factorization.solve(row<2>{3, 7})[0] == Approx(7) );
+
+		symmetric_matrix<6> larger;
+		for (index_t r = 0; r < 6; ++r)
+			for (index_t c = 0; c <= r; ++c)
+				larger(r, c) = double((r * 5 + c * 3) % 7) - 3;
+		const auto larger_b = patterned_matrix<6, 3>(5);
+		REQUIRE( naive_product(larger.get_matrix(), ldlt(larger).solve(larger_b)) == larger_b );
+
+		const symmetric_matrix<2> singular{ {1}, {1, 1} };
+		CHECK_THROWS_AS( ldlt(singular), const matrix_is_degenerate_error& );
+	}
+}
+
+TEST_CASE( "Degeneracy without exceptions.", "[degenerate]" )
+{
+	SECTION( "Screening." )
+	{
+		square_matrix<3> zero_row{ {1, 2, 3}, {0, 0, 0}, {4, 5, 6} };
+		square_matrix<3> zero_column{ {1, 0, 3}, {2, 0, 3}, {4, 0, 6} };
+		square_matrix<3> equal_rows{ {1, 2, 3}, {4, 5, 6}, {1, 2, 3} };
+		square_matrix<3> equal_columns{ {1, 2, 1}, {4, 5, 4}, {7, 8, 7} };
+		square_matrix<3> proportional_rows{ {1, 2, 3}, {2, 4, 6}, {4, 5, 7} };
+		REQUIRE( zero_row.has_degenerate_structure() );
+		REQUIRE( zero_column.has_degenerate_structure() );
+		REQUIRE( equal_rows.has_degenerate_structure() );
+		REQUIRE( equal_columns.has_degenerate_structure() );
+		// Not caught by the screen; found by elimination.
+		REQUIRE_FALSE( proportional_rows.has_degenerate_structure() );
+		REQUIRE_FALSE( proportional_rows.try_invert() );
+		REQUIRE_FALSE( square_matrix<3>::get_identity_matrix().has_degenerate_structure() );
+
+		// Equal rows and columns far apart, found through sorting.
+		square_matrix<8> spread;
+		for (index_t r = 0; r < 8; ++r)
+			for (index_t c = 0; c < 8; ++c)
+				spread[r][c] = double((r * 5 + c * 3) % 8) - double(r == c);
+		REQUIRE_FALSE( spread.has_degenerate_structure() );
+		auto repeated_row = spread;
+		repeated_row[6] = repeated_row[1];
+		REQUIRE( repeated_row.has_degenerate_structure() );
+		auto repeated_column = spread;
+		for (index_t r = 0; r < 8; ++r)
+			repeated_column[r][7] = repeated_column[r][0];
+		REQUIRE( repeated_column.has_degenerate_structure() );
+		auto not_a_number = spread;
+		not_a_number[2][3] = not_a_number[5][3] = std::numeric_limits<double>::quiet_NaN();
+		REQUIRE_FALSE( not_a_number.has_degenerate_structure() );
+	}
+	SECTION( "Inversion." )
+	{
+		square_matrix<2> invertible{ {2, 7}, {4, 6} };
+		const auto inverse = invertible.get_inverse();
+		REQUIRE( invertible.try_invert() );
+		REQUIRE( invertible == inverse );
+
+		square_matrix<2> degenerate{ {2, 6}, {1, 3} };
+		const auto original = degenerate;
+		REQUIRE_FALSE( degenerate.try_invert() );
+		REQUIRE( degenerate == original );
+	}
+	SECTION( "Row reduction with interchanges." )
+	{
+		// Column r is searched for a pivot, not the diagonal of the rows below.
+		square_matrix<2> swap{ {0, 1}, {1, 0} };
+		auto augmented = horizontal_concat(swap, square_matrix<2>::get_identity_matrix());
+		REQUIRE( augmented.try_row_reduce() );
+		REQUIRE( augmented.get_right_slice() == swap );
+
+		square_matrix<3> cycle{ {0, 1, 0}, {0, 1, 1}, {1, 0, 1} };
+		square_matrix<3> cycle_inverse{ {1, -1, 1}, {1, 0, 0}, {-1, 1, 0} };
+		auto augmented_cycle = horizontal_concat(cycle, square_matrix<3>::get_identity_matrix());
+		REQUIRE( augmented_cycle.try_row_reduce() );
+		REQUIRE( augmented_cycle.get_right_slice() == cycle_inverse );
+
+		square_matrix<2> singular{ {0, 1}, {0, 2} };
+		auto augmented_singular = horizontal_concat(singular, square_matrix<2>::get_identity_matrix());
+		REQUIRE_FALSE( augmented_singular.try_row_reduce() );
+	}
+	SECTION( "Batches." )
+	{
+		std::array<square_matrix<2>, 4> batch{ {
+			{ {2, 7}, {4, 6} },
+			{ {10, 10}, {10, 10} },
+			{ {0.7, 1.99}, {24.1, 9999} },
+			{ {2, 6}, {1, 3} }
+		} };
+		const auto originals = batch;
+		std::array<bool, 4> status;
+		REQUIRE( invert_batch(batch.begin(), batch.end(), status.begin(), true) == 2 );
+		REQUIRE( status[0] );
+		REQUIRE_FALSE( status[1] );
+		REQUIRE( status[2] );
+		REQUIRE_FALSE( status[3] );
+		REQUIRE( batch[0] == originals[0].get_inverse() );
+		REQUIRE( batch[3] == originals[3] );
+	}
+}
+
+TEST_CASE( "Pivoting.", "[pivoting]" )
+{
+	SECTION( "Permutation matrices." )
+	{
+		// Every permutation of four rows, each the inverse of its transpose.
+		std::array<index_t, 4> order{ {0, 1, 2, 3} };
+		do
+		{
+			square_matrix<4> permutation {};
+			for (index_t r = 0; r < 4; ++r)
+				permutation[r][order[r]] = 1;
+			auto inverse = permutation;
+			REQUIRE( inverse.try_invert() );
+			REQUIRE( inverse == permutation.get_transpose() );
+			auto thrown = permutation;
+			thrown.invert_gauss_jordan();
+			REQUIRE( thrown == inverse );
+		} while (std::next_permutation(order.begin(), order.end()));
+
+		square_matrix<8> reversal {};
+		for (index_t r = 0; r < 8; ++r)
+			reversal[r][7 - r] = 1;
+		auto inverse = reversal;
+		REQUIRE( inverse.try_invert() );
+		REQUIRE( inverse == reversal );
+	}
+	SECTION( "Zeros on the diagonal." )
+	{
+		square_matrix<3> hollow{ {0, 2, 1}, {3, 0, 4}, {5, 6, 0} };
+		auto inverse = hollow;
+		REQUIRE( inverse.try_invert() );
+		REQUIRE( (hollow * inverse) == square_matrix<3>::get_identity_matrix() );
+
+		square_matrix<3> cycle{ {0, 1, 0}, {0, 1, 1}, {1, 0, 1} };
+		square_matrix<3> cycle_inverse{ {1, -1, 1}, {1, 0, 0}, {-1, 1, 0} };
+		REQUIRE( cycle.try_invert() );
+		REQUIRE( cycle == cycle_inverse );
+	}
+	SECTION( "Row interchanges." )
+	{
+		// A small leading pivot is passed over for the larger one below it.
+		square_matrix<2> small_pivot{ {1e-3, 1}, {1, 1} };
+		auto inverse = small_pivot;
+		REQUIRE( inverse.try_invert() );
+		REQUIRE( (small_pivot * inverse) == square_matrix<2>::get_identity_matrix() );
+
+		// Each column's pivot is in a different row from the last.
+		square_matrix<4> staggered{ {0, 0, 1, 2}, {0, 3, 0, 1}, {4, 0, 2, 0}, {1, 1, 0, 0} };
+		auto reference = staggered;
+		REQUIRE( reference.try_invert() );
+		REQUIRE( (staggered * reference) == square_matrix<4>::get_identity_matrix() );
+
+		// A column of zeros at or below the diagonal, once earlier columns are eliminated.
+		square_matrix<3> singular{ {1, 2, 3}, {0, 0, 4}, {0, 0, 5} };
+		const auto original = singular;
+		REQUIRE_FALSE( singular.try_invert() );
+		REQUIRE( singular == original );
+		CHECK_THROWS_AS( singular.invert_gauss_jordan(), const matrix_is_degenerate_error& );
+	}
+}
+
+TEST_CASE( "Views.", "[views]" )
+{
+	auto mtx = patterned_matrix<4, 5>(1);
+	matrix_view<2, 3> block{mtx, 1, 2};
+	REQUIRE( block[0][0] == mtx[1][2] );
+	REQUIRE( block[1][2] == mtx[2][4] );
+	block[1][1] = 100;
+	REQUIRE( mtx[2][3] == 100 );
+
+	const matrix<2, 3> replacement{ {1, 2, 3}, {4, 5, 6} };
+	block.assign(replacement);
+	REQUIRE( (const_matrix_view<2, 3>{mtx, 1, 2}.get_matrix() == replacement) );
+	REQUIRE( mtx.view()[3][4] == mtx[3][4] );
+}
+
+TEST_CASE( "Orthogonal transformations.", "[orthogonal]" )
+{
+	SECTION( "Givens rotations." )
+	{
+		const auto rotation = givens_rotation<>::make(3, 4);
+		REQUIRE( rotation.r == Approx(5) );
+		row<3> x{3, 1, 2};
+		row<3> y{4, 5, 6};
+		rotation.apply(x, y);
+		REQUIRE( x[0] == Approx(5) );
+		REQUIRE( y[0] == Approx(0).margin(1e-15) );
+		REQUIRE( x[1] * x[1] + y[1] * y[1] == Approx(26) );
+
+		// No overflow, where the squares would.
+		const auto large = givens_rotation<>::make(1e200, -1e200);
+		REQUIRE( large.r == Approx(std::sqrt(2.0) * 1e200) );
+		REQUIRE( large.s == Approx(-1 / std::sqrt(2.0)) );
+	}
+	SECTION( "Householder reflectors." )
+	{
+		auto a = patterned_matrix<5, 3>(2);
+		const auto original = a;
+		const double tau = make_householder(a.view(), 0, 0);
+		double norm = 0;
+		for (index_t r = 0; r < 5; ++r)
+			norm += original[r][0] * original[r][0];
+		REQUIRE( std::abs(a[0][0]) == Approx(std::sqrt(norm)) );
+
+		// Applying the reflector to its own column reproduces beta e1.
+		auto column = original;
+		apply_householder<5, 3, 3, double>(a.view(), 0, 0, tau, column.view(), 0, 1);
+		REQUIRE( column[0][0] == Approx(a[0][0]) );
+		for (index_t r = 1; r < 5; ++r)
+			REQUIRE( column[r][0] == Approx(0).margin(1e-12) );
+	}
+	SECTION( "QR factorization." )
+	{
+		const auto a = patterned_matrix<9, 7>(3);
+		auto blocked = a;
+		auto unblocked = a;
+		std::array<double, 7> tau, unblocked_tau;
+		householder_qr<3>(blocked, tau);
+		householder_qr_unblocked(unblocked.view(), unblocked_tau);
+		REQUIRE( blocked == unblocked );
+
+		// Q R = A.
+		matrix<9, 7> r;
+		for (index_t i = 0; i < 7; ++i)
+			for (index_t j = i; j < 7; ++j)
+				r[i][j] = blocked[i][j];
+		auto product = r;
+		apply_q<3>(blocked, tau, product, false);
+		REQUIRE( product == a );
+
+		// Qᵀ A = R.
+		product = a;
+		apply_q<3>(blocked, tau, product, true);
+		REQUIRE( product == r );
+	}
+}
+
+TEST_CASE( "Tall-skinny QR.", "[tsqr]" )
+{
+	// 1000 rows in 16 panels (the last partly filled), with 4 columns, exactly fitted by the
+	// coefficients (1, -2, 3, 0.5).
+	constexpr index_t rows = 1000;
+	std::vector<double> a(rows * 4), b(rows);
+	for (index_t r = 0; r < rows; ++r)
+	{
+		a[r*4 + 0] = 1;
+		a[r*4 + 1] = double(r % 17) - 8;
+		a[r*4 + 2] = double((r * 7) % 13) / 4;
+		a[r*4 + 3] = double((r * r) % 11) - 5;
+		b[r] = a[r*4] - 2 * a[r*4 + 1] + 3 * a[r*4 + 2] + 0.5 * a[r*4 + 3];
+	}
+
+	const tsqr_factorization<4, 64> factorization{a.data(), rows, 4, 3};
+
+	// Rᵀ R = Aᵀ A.
+	const auto& r = factorization.r();
+	for (index_t i = 0; i < 4; ++i)
+		for (index_t j = 0; j < 4; ++j)
+		{
+			double ata = 0, rtr = 0;
+			for (index_t k = 0; k < rows; ++k)
+				ata += a[k*4 + i] * a[k*4 + j];
+			for (index_t k = 0; k < 4; ++k)
+				rtr += r[k][i] * r[k][j];
+			REQUIRE( rtr == Approx(ata) );
+		}
+
+	const auto x = factorization.solve(b.data());
+	REQUIRE( x[0] == Approx(1) );
+	REQUIRE( x[1] == Approx(-2) );
+	REQUIRE( x[2] == Approx(3) );
+	REQUIRE( x[3] == Approx(0.5) );
+
+	// The same, on one thread and in a single panel.
+	const tsqr_factorization<4, 1024> single{a.data(), rows, 4, 1};
+	REQUIRE( single.solve(b.data())[1] == Approx(-2) );
+}
+
+TEST_CASE( "Blocked LU factorization.", "[lu]" )
+{
+	// Pseudo-random, so that pivoting is needed throughout.
+	square_matrix<40> a;
+	std::uint32_t state = 12345;
+	for (auto& row : a)
+		for (auto& element : row)
+		{
+			state = state * 1664525u + 1013904223u;
+			element = double(state >> 8) / double(1u << 24) - 0.5;
+		}
+
+	// P A = L U, for standard blocked LU and CALU with panels of 8 columns, on 3 threads.
+	const auto check = [&a](const square_matrix<40>& lu, const row_permutation<40>& permutation)
+	{
+		square_matrix<40> l, u;
+		for (index_t i = 0; i < 40; ++i)
+		{
+			l[i][i] = 1;
+			for (index_t j = 0; j < 40; ++j)
+				(j < i ? l[i][j] : u[i][j]) = lu[i][j];
+		}
+		const auto product = naive_product(l, u);
+		for (index_t i = 0; i < 40; ++i)
+			for (index_t j = 0; j < 40; ++j)
+				REQUIRE( product[i][j] == Approx(a[permutation[i]][j]).margin(1e-12) );
+	};
+	row_permutation<40> permutation;
+	auto blocked = a;
+	lu_blocked<8>(blocked, permutation, 3);
+	check(blocked, permutation);
+	auto tournament = a;
+	calu<8>(tournament, permutation, 3);
+	check(tournament, permutation);
+
+	// With one thread there is a single block in the tournament, which then reproduces partial
+	// pivoting.
+	const auto b = patterned_matrix<40, 2>(1);
+	auto x = b;
+	lu_solve(tournament, permutation, x);
+	const auto ax = naive_product(a, x);
+	for (index_t i = 0; i < 40; ++i)
+		REQUIRE( ax[i][1] == Approx(b[i][1]).margin(1e-10) );
+
+	auto serial = a;
+	calu<8>(serial, permutation, 1);
+	REQUIRE( serial == blocked );
+
+	// Two equal rows.
+	auto degenerate = a;
+	degenerate[31] = degenerate[5];
+	auto copy = degenerate;
+	REQUIRE_FALSE( try_lu_blocked<8>(copy, permutation, 3) );
+	CHECK_THROWS_AS( calu<8>(degenerate, permutation, 3), const matrix_is_degenerate_error& );
+}
+
+TEST_CASE( "Task graphs.", "[tasks]" )
+{
+	// A diamond, and an independent task.
+	int a = 0, b = 0, c = 0, d = 0;
+	task_graph graph;
+	graph.add("first", [&] { a = 1; }, {}, {&a});
+	graph.add("left", [&] { b = a + 1; }, {&a}, {&b});
+	graph.add("right", [&] { c = a + 2; }, {&a}, {&c});
+	graph.add("last", [&] { a = b * c; }, {&b, &c}, {&a});
+	graph.add("alone", [&] { d = 7; }, {}, {&d});
+	REQUIRE( graph.size() == 5 );
+	graph.run(3);
+	REQUIRE( a == 6 );
+	REQUIRE( d == 7 );
+	REQUIRE( graph.utilization() >= 0 );
+	REQUIRE( graph.utilization() <= 1 );
+
+	// Times are in fixed point, to the nanosecond, and the stream's format is left as it was.
+	std::ostringstream trace;
+	trace.precision(2);
+	graph.write_trace(trace);
+	REQUIRE( trace.str().find("\"traceEvents\"") != std::string::npos );
+	REQUIRE( trace.str().find("\"name\":\"last\"") != std::string::npos );
+	for (const std::string field : {"\"ts\":", "\"dur\":"})
+		for (auto found = trace.str().find(field); found != std::string::npos; found = trace.str().find(field, found + 1))
+		{
+			const auto value = trace.str().substr(found + field.size());
+			const auto end = value.find_first_of(",}");
+			REQUIRE( value.find('.') + 4 == end );
+			REQUIRE( value.substr(0, end).find('e') == std::string::npos );
+		}
+	REQUIRE( trace.precision() == 2 );
+	REQUIRE( (trace.flags() & std::ios::floatfield) == 0 );
+
+	// Names are escaped, so that the trace remains valid JSON.
+	task_graph quoted;
+	quoted.add("say \"hi\" \\ bye\n", [] {}, {}, {});
+	quoted.run(1);
+	std::ostringstream quoted_trace;
+	quoted.write_trace(quoted_trace);
+	REQUIRE( quoted_trace.str().find("\"name\":\"say \\\"hi\\\" \\\\ bye\\u000a\"") != std::string::npos );
+
+	// Workers wait, rather than spin, through a long serial chain.
+	task_graph chain;
+	int links = 0;
+	for (int i = 0; i < 200; ++i)
+		chain.add("link", [&links] { ++links; }, {}, {&links});
+	chain.run(4);
+	REQUIRE( links == 200 );
+
+	// The first exception is rethrown, and later tasks are skipped.
+	task_graph failing;
+	failing.add("throws", [] { throw matrix_is_degenerate_error(); }, {}, {&a});
+	failing.add("skipped", [&] { a = 0; }, {&a}, {});
+	CHECK_THROWS_AS( failing.run(2), const matrix_is_degenerate_error& );
+	REQUIRE( a == 6 );
+}
+
+TEST_CASE( "Tile algorithms.", "[tiled]" )
+{
+	// Pseudo-random, in tiles of 4.
+	square_matrix<12> a;
+	std::uint32_t state = 54321;
+	for (auto& row : a)
+		for (auto& element : row)
+		{
+			state = state * 1664525u + 1013904223u;
+			element = double(state >> 8) / double(1u << 24) - 0.5;
+		}
+	const tiled_matrix<12, 4> tiled{a};
+	REQUIRE( tiled(5, 9) == a[5][9] );
+	square_matrix<12> copy;
+	tiled.get_matrix(copy);
+	REQUIRE( copy == a );
+
+	SECTION( "Cholesky." )
+	{
+		auto spd = naive_product(a, a.get_transpose());
+		spd += square_matrix<12>::get_identity_matrix();
+		tiled_matrix<12, 4> factor{spd};
+		task_graph graph;
+		tiled_cholesky(factor, graph);
+		REQUIRE( graph.size() == 10 );
+		graph.run(3);
+		const auto expected = cholesky(spd);
+		for (index_t r = 0; r < 12; ++r)
+			for (index_t c = 0; c <= r; ++c)
+				REQUIRE( factor(r, c) == Approx(expected[r][c]) );
+
+		tiled_matrix<12, 4> indefinite{a};
+		CHECK_THROWS_AS( tiled_cholesky(indefinite, 3), const matrix_not_positive_definite_error& );
+	}
+	SECTION( "LU." )
+	{
+		auto factor = tiled;
+		row_permutation<12> permutation;
+		tiled_lu(factor, permutation, 3);
+		auto expected = a;
+		row_permutation<12> expected_permutation;
+		lu_blocked<4>(expected, expected_permutation, 1);
+		REQUIRE( permutation == expected_permutation );
+		factor.get_matrix(copy);
+		REQUIRE( copy == expected );
+
+		auto degenerate = a;
+		degenerate[10] = degenerate[2];
+		tiled_matrix<12, 4> degenerate_tiled{degenerate};
+		CHECK_THROWS_AS( tiled_lu(degenerate_tiled, permutation, 3), const matrix_is_degenerate_error& );
+	}
+	SECTION( "QR." )
+	{
+		auto factor = tiled;
+		std::vector<std::array<double, 4>> tau;
+		tiled_qr(factor, tau, 3);
+
+		// Rᵀ R = Aᵀ A.
+		square_matrix<12> r;
+		for (index_t i = 0; i < 12; ++i)
+			for (index_t j = i; j < 12; ++j)
+				r[i][j] = factor(i, j);
+		const auto rtr = naive_product(r.get_transpose(), r);
+		const auto ata = naive_product(a.get_transpose(), a);
+		for (index_t i = 0; i < 12; ++i)
+			for (index_t j = 0; j < 12; ++j)
+				REQUIRE( rtr[i][j] == Approx(ata[i][j]).margin(1e-12) );
+	}
+}
+
+TEST_CASE( "Tiled storage orders.", "[tiled]" )
+{
+	const auto a = patterned_matrix<16, 16>(1);
+	const auto b = patterned_matrix<16, 16>(2);
+	const tiled_matrix<16, 4, double, tile_order::morton> z{a};
+	const tiled_matrix<16, 4> rows{a};
+
+	// Tiles along the Z-order curve: (0,0) (0,1) (1,0) (1,1) (0,2) ...
+	REQUIRE( &z.tile(0, 1) == z.tile_data() + 1 );
+	REQUIRE( &z.tile(1, 0) == z.tile_data() + 2 );
+	REQUIRE( &z.tile(0, 2) == z.tile_data() + 4 );
+	REQUIRE( &z.tile(3, 3) == z.tile_data() + 15 );
+	REQUIRE( (z.tile_position(9) == std::make_pair<index_t, index_t>(2, 1)) );
+
+	// Neither order is visible by element, by iterator or by block.
+	REQUIRE( z(6, 13) == a[6][13] );
+	REQUIRE( std::equal(z.begin(), z.end(), rows.begin()) );
+	REQUIRE( z.end() - z.begin() == 256 );
+	REQUIRE( z.begin()[16 * 3 + 5] == a[3][5] );
+	matrix<5, 7> block;
+	z.get_block(3, 2, block);
+	matrix<5, 7> expected_block;
+	a.get_block(3, 2, expected_block);
+	REQUIRE( block == expected_block );
+
+	square_matrix<16> result;
+	z.get_transpose().get_matrix(result);
+	REQUIRE( result == a.get_transpose() );
+
+	const tiled_matrix<16, 4, double, tile_order::morton> z_b{b};
+	(z * z_b).get_matrix(result);
+	REQUIRE( result == naive_product(a, b) );
+	auto c = z;
+	gemm(2.0, z, z_b, -1.0, c, 3);
+	c.get_matrix(result);
+	auto expected = naive_product(a, b);
+	expected *= 2;
+	expected -= a;
+	REQUIRE( result == expected );
+
+	// The factorizations are indifferent to the order.
+	square_matrix<16> invertible = a;
+	for (index_t i = 0; i < 16; ++i)
+		invertible[i][i] += 20;
+	tiled_matrix<16, 4, double, tile_order::morton> z_lu{invertible};
+	tiled_matrix<16, 4> rows_lu{invertible};
+	row_permutation<16> z_permutation, rows_permutation;
+	tiled_lu(z_lu, z_permutation, 2);
+	tiled_lu(rows_lu, rows_permutation, 2);
+	REQUIRE( z_permutation == rows_permutation );
+	REQUIRE( std::equal(z_lu.begin(), z_lu.end(), rows_lu.begin()) );
+}
+
+TEST_CASE( "Streaming stores.", "[streaming]" )
+{
+	// Odd widths, so that rows begin both aligned and unaligned.
+	const auto lhs = patterned_matrix<5, 3>(1);
+	const auto rhs = patterned_matrix<5, 4>(2);
+	const auto expected = horizontal_concat(lhs, rhs);
+	for (const auto policy : {store_policy::automatic, store_policy::cached, store_policy::streaming})
+	{
+		matrix<5, 7> concatenation;
+		horizontal_concat(lhs, rhs, concatenation, policy);
+		REQUIRE( concatenation == expected );
+
+		auto augmented = patterned_matrix<5, 14>(3);
+		matrix<5, 7> slice;
+		augmented.get_right_slice(slice, policy);
+		REQUIRE( slice == augmented.get_right_slice() );
+
+		const auto tall = patterned_matrix<11, 3>(4);
+		matrix<3, 11> transpose;
+		tall.get_transpose(transpose, policy);
+		REQUIRE( transpose == tall.get_transpose() );
+
+		matrix<5, 7> copy;
+		copy_matrix(expected, copy, policy);
+		REQUIRE( copy == expected );
+		fill_matrix(copy, 2.5, policy);
+		for (const auto& row : copy)
+			for (const auto element : row)
+				REQUIRE( element == 2.5 );
+	}
+
+	matrix<3, 5, float> single;
+	fill_matrix(single, 1.5f, store_policy::streaming);
+	REQUIRE( single[2][4] == 1.5f );
+}
+
+TEST_CASE( "Batch files.", "[io]" )
+{
+	// Ten matrices, the fourth degenerate, in chunks of four.
+	auto batch = dominant_batch<3>(10);
+	batch[3] = square_matrix<3>{ {1, 2, 3}, {2, 4, 6}, {0, 0, 1} };
+	const char* input = "unit_test_batch_in.bin";
+	const char* output = "unit_test_batch_out.bin";
+	write_batch_file(input, batch.data(), batch.size());
+
+	const auto header = read_batch_file_header(input);
+	REQUIRE( header.count == 10 );
+	REQUIRE( (header.holds<3, 3, double>()) );
+	REQUIRE_FALSE( (header.holds<3, 3, float>()) );
+	REQUIRE( (read_batch_file<3, 3, double>(input)[7] == batch[7]) );
+	CHECK_THROWS_AS( (read_batch_file<2, 2, double>(input)), const batch_file_error& );
+
+	for (const bool asynchronous : {true, false})
+		for (const bool direct : {false, true})
+		{
+			batch_io_options options;
+			options.chunk_size = 4;
+			options.asynchronous = asynchronous;
+			options.direct = direct;
+			std::vector<bool> status;
+			try
+			{
+				REQUIRE( invert_batch_file<3>(input, output, &status, options) == 9 );
+			}
+			catch (const std::system_error& error)
+			{
+				// Not every file system supports O_DIRECT.
+				REQUIRE( direct );
+				REQUIRE( error.code().value() == EINVAL );
+				continue;
+			}
+			REQUIRE( status.size() == 10 );
+			REQUIRE_FALSE( status[3] );
+			const auto inverses = read_batch_file<3, 3, double>(output);
+			REQUIRE( inverses.size() == 10 );
+			REQUIRE( inverses[3] == batch[3] );
+			REQUIRE( inverses[9] == batch[9].get_inverse() );
+		}
+
+	// Chunks are limited to the batch, and to what the ring can transfer at once.
+	batch_io_options options;
+	options.chunk_size = index_t(1) << 40;
+	REQUIRE( invert_batch_file<3>(input, output, nullptr, options) == 9 );
+	REQUIRE( (read_batch_file<3, 3, double>(output)[9] == batch[9].get_inverse()) );
+	{
+		io_ring ring;
+		char byte = 0;
+		CHECK_THROWS_AS( ring.read(0, &byte, io_ring::max_transfer + 1, 0, 0), const std::length_error& );
+	}
+
+	std::remove(input);
+	std::remove(output);
+}
+
+TEST_CASE( "Checkpoints.", "[io]" )
+{
+	const auto batch = dominant_batch<3>(3000, 97, 5);
+	const char* input = "unit_test_checkpoint_input.bin";
+	const char* output = "unit_test_checkpoint_output.bin";
+	const char* log = "unit_test_checkpoint.log";
+	write_batch_file(input, batch.data(), batch.size());
+	std::vector<bool> expected_status;
+	const index_t expected_inverted = invert_batch_file<3>(input, output, &expected_status);
+	const auto expected = read_batch_file<3, 3, double>(output);
+
+	for (const auto encoding : {batch_encoding::raw, batch_encoding::shuffled_lz})
+	{
+		std::remove(output);
+		std::remove(log);
+		batch_io_options options;
+		options.chunk_size = 100;
+		options.checkpoint_interval = 4;
+		options.encoding = encoding;
+
+		// The first run is interrupted in its 13th chunk, after the checkpoint of the 12th was
+		// begun; it may or may not have been committed.
+		index_t calls = 0;
+		const auto invert = [&](square_matrix<3>* first, square_matrix<3>* last)
+		{
+			if (++calls == 13)
+				throw std::runtime_error("Interrupted.");
+			std::vector<bool> status(last - first);
+			invert_batch(first, last, status.begin());
+			options.checkpoint->value += last - first;
+			options.checkpoint->save(first, sizeof(*first));
+		};
+		{
+			batch_checkpoint checkpoint(log);
+			options.checkpoint = &checkpoint;
+			CHECK_THROWS_AS( (transform_batch_file<3, 3, double>(input, output, invert, options)), const std::runtime_error& );
+		}
+		{
+			batch_checkpoint checkpoint(log);
+			options.checkpoint = &checkpoint;
+			calls = 100;
+			REQUIRE( (transform_batch_file<3, 3, double>(input, output, invert, options)) == 3000 );
+			const index_t resumed_chunks = checkpoint.resumed() / 100;
+			REQUIRE( (resumed_chunks == 8 || resumed_chunks == 12) );
+			REQUIRE( checkpoint.resumed() == resumed_chunks * 100 );
+			REQUIRE( checkpoint.restored_bytes().size() == resumed_chunks * sizeof(batch[0]) );
+			REQUIRE( checkpoint.value == 3000 );
+			REQUIRE( calls == 100 + 30 - resumed_chunks );
+			REQUIRE( (read_batch_file<3, 3, double>(output) == expected) );
+		}
+
+		// A run torn part way through a checkpoint resumes from the one before.
+		std::remove(log);
+		std::vector<bool> status;
+		{
+			batch_checkpoint checkpoint(log);
+			options.checkpoint = &checkpoint;
+			REQUIRE( invert_batch_file<3>(input, output, &status, options) == expected_inverted );
+			REQUIRE( status == expected_status );
+		}
+		struct stat log_status;
+		REQUIRE( ::stat(log, &log_status) == 0 );
+		REQUIRE( ::truncate(log, log_status.st_size / 2 + 7) == 0 );
+		{
+			batch_checkpoint checkpoint(log);
+			options.checkpoint = &checkpoint;
+			status.clear();
+			REQUIRE( invert_batch_file<3>(input, output, &status, options) == expected_inverted );
+			REQUIRE( checkpoint.resumed() > 0 );
+			REQUIRE( checkpoint.resumed() < 3000 );
+			REQUIRE( status == expected_status );
+			REQUIRE( (read_batch_file<3, 3, double>(output) == expected) );
+		}
+		{
+			batch_checkpoint checkpoint(log);
+			options.checkpoint = &checkpoint;
+			status.clear();
+			REQUIRE( invert_batch_file<3>(input, output, &status, options) == expected_inverted );
+			REQUIRE( checkpoint.resumed() == 3000 );
+			REQUIRE( status == expected_status );
+		}
+
+		// A run with another chunk size starts afresh.
+		options.chunk_size = 300;
+		{
+			batch_checkpoint checkpoint(log);
+			options.checkpoint = &checkpoint;
+			REQUIRE( invert_batch_file<3>(input, output, nullptr, options) == expected_inverted );
+			REQUIRE( checkpoint.resumed() == 0 );
+			REQUIRE( (read_batch_file<3, 3, double>(output) == expected) );
+		}
+	}
+
+	// Repeating a finished run, of a count that is not a multiple of the chunk size, leaves its
+	// output as it is.
+	write_batch_file(input, batch.data(), 1000);
+	const index_t prefix_inverted = std::count(expected_status.begin(), expected_status.begin() + 1000, true);
+	for (const auto encoding : {batch_encoding::raw, batch_encoding::shuffled_lz})
+	{
+		std::remove(output);
+		std::remove(log);
+		batch_io_options options;
+		options.chunk_size = 300;
+		options.encoding = encoding;
+		struct stat first_status, second_status;
+		for (const index_t expected_resumed : {index_t(0), index_t(1000)})
+		{
+			batch_checkpoint checkpoint(log);
+			options.checkpoint = &checkpoint;
+			REQUIRE( invert_batch_file<3>(input, output, nullptr, options) == prefix_inverted );
+			REQUIRE( checkpoint.resumed() == expected_resumed );
+			REQUIRE( ::stat(output, expected_resumed ? &second_status : &first_status) == 0 );
+		}
+		REQUIRE( second_status.st_size == first_status.st_size );
+		REQUIRE( (read_batch_file<3, 3, double>(output) == std::vector<square_matrix<3>>(expected.begin(), expected.begin() + 1000)) );
+		if (encoding == batch_encoding::raw)
+		{
+			REQUIRE( first_status.st_size == off_t(batch_header_size + 1000 * sizeof(batch[0])) );
+			index_batch_file<3, 3, double>(output, 300);
+			batch_checkpoint checkpoint(log);
+			options.checkpoint = &checkpoint;
+			REQUIRE( invert_batch_file<3>(input, output, nullptr, options) == prefix_inverted );
+			REQUIRE( (indexed_batch_reader<3, 3, double>(output).chunk_count() == 4) );
+		}
+	}
+
+	std::remove(input);
+	std::remove(output);
+	std::remove(log);
+}
+
+TEST_CASE( "Indexed batch files.", "[io]" )
+{
+	// Ten chunks of a hundred matrices, each chunk larger than the one before, with a singular
+	// matrix in every third chunk.
+	auto batch = dominant_batch<3>(1000);
+	for (unsigned i = 0; i < 1000; ++i)
+		batch[i] *= double(i / 100 + 1);
+	for (unsigned i = 50; i < 1000; i += 300)
+		batch[i] = square_matrix<3>{ {1, 2, 3}, {2, 4, 6}, {0, 0, 1} };
+	// A permutation, which is not singular though every diagonal element is zero.
+	batch[450] = square_matrix<3>{ {0, 1, 0}, {0, 0, 1}, {1, 0, 0} };
+	const char* path = "unit_test_indexed.bin";
+
+	for (const auto encoding : {batch_encoding::raw, batch_encoding::shuffled_lz})
+		for (const bool afterwards : {false, true})
+		{
+			if (afterwards)
+			{
+				write_batch_file(path, batch.data(), batch.size(), encoding);
+				CHECK_THROWS_AS( (indexed_batch_reader<3, 3>(path)), const batch_file_error& );
+				index_batch_file<3, 3, double>(path, 100);
+			}
+			else
+				write_indexed_batch_file(path, batch.data(), batch.size(), encoding, 100);
+			REQUIRE( (read_batch_file<3, 3, double>(path) == batch) );
+
+			const indexed_batch_reader<3, 3> reader(path);
+			REQUIRE( reader.size() == 1000 );
+			// Coded files written whole have a single frame, and so a single chunk.
+			const index_t chunk_size = afterwards && encoding != batch_encoding::raw ? 1000 : 100;
+			REQUIRE( reader.chunk_size() == chunk_size );
+			REQUIRE( reader[537].get_matrix() == batch[537] );
+			REQUIRE( reader[999].get_matrix() == batch[999] );
+			REQUIRE( reader[0].get_matrix() == batch[0] );
+			CHECK_THROWS_AS( reader[1000], const std::out_of_range& );
+			if (chunk_size != 100)
+				continue;
+
+			REQUIRE( reader.chunk_count() == 10 );
+			const auto& statistics = reader.chunk(3).statistics;
+			REQUIRE( statistics.singular_count == 1 );
+			REQUIRE( statistics.min == Approx(-20) );
+			REQUIRE( statistics.max == Approx(60) );
+			REQUIRE( statistics.min_norm <= statistics.max_norm );
+			REQUIRE( reader.chunk(4).statistics.singular_count == 0 );
+
+			// Only the chunks with large matrices are read.
+			index_t matrices = 0;
+			const double threshold = reader.chunk(4).statistics.max_norm;
+			const index_t visited = reader.for_each_chunk(
+				[=](const batch_chunk_statistics& chunk) { return chunk.max_norm > threshold; },
+				[&](const index_t first, const const_batch_view<3, 3> chunk)
+				{
+					REQUIRE( first >= 500 );
+					REQUIRE( chunk[chunk.size() - 1].get_matrix() == batch[first + chunk.size() - 1] );
+					matrices += chunk.size();
+				});
+			REQUIRE( visited * 100 == matrices );
+			REQUIRE( visited == 5 );
+			REQUIRE( reader.for_each_chunk(
+				[](const batch_chunk_statistics& chunk) { return chunk.singular_count > 0; },
+				[](index_t, const_batch_view<3, 3>) { }) == 4 );
+		}
+
+	std::remove(path);
+}
+
+TEST_CASE( "Shared memory rings.", "[ring]" )
+{
+	const std::string name = "/unit_test_ring_" + std::to_string(::getpid());
+	auto ring = matrix_ring<3, 3>::create(name, 64);
+	REQUIRE( ring.capacity() == 64 );
+	CHECK_THROWS_AS( (matrix_ring<3, 3>::create(name, 64)), const std::system_error& );
+	CHECK_THROWS_AS( (matrix_ring<4, 4>::open(name)), const matrix_ring_error& );
+	CHECK_THROWS_AS( (matrix_ring<3, 3>::create(name + "_other", 48)), const matrix_ring_error& );
+
+	// A ring whose header gives a capacity create() would refuse cannot be opened.
+	{
+		const std::string corrupt = name + "_corrupt";
+		matrix_ring<3, 3>::create(corrupt, 64);
+		const int fd = ::shm_open(corrupt.c_str(), O_RDWR, 0);
+		REQUIRE( fd >= 0 );
+		void* const segment = ::mmap(nullptr, ring_header_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		REQUIRE( segment != MAP_FAILED );
+		for (const std::uint32_t capacity : {0u, 48u})
+		{
+			static_cast<ring_header*>(segment)->capacity = capacity;
+			CHECK_THROWS_AS( (matrix_ring<3, 3>::open(corrupt)), const matrix_ring_error& );
+		}
+		::munmap(segment, ring_header_size);
+		matrix_ring<3, 3>::remove(corrupt);
+	}
+
+	// The inverter is another process, which maps the ring for itself.
+	const pid_t inverter = ::fork();
+	if (inverter == 0)
+	{
+		auto shared = matrix_ring<3, 3>::open(name);
+		index_t total = 0, done;
+		while ((done = shared.invert_pending()) > 0)
+			total += done;
+		::_exit(total == 1000 ? 0 : 1);
+	}
+	REQUIRE( inverter > 0 );
+
+	const auto batch = dominant_batch<3>(1000, 37, 3);
+
+	// This process produces and collects, so that the ring fills and wraps around many times.
+	index_t produced = 0, collected = 0;
+	while (collected < batch.size())
+	{
+		auto free = ring.claim(batch.size() - produced, false);
+		std::copy_n(batch.begin() + produced, free.size(), free.begin());
+		ring.publish(free.size());
+		produced += free.size();
+		if (produced == batch.size() && !ring.closed())
+			ring.close();
+
+		const auto done = ring.results(std::numeric_limits<index_t>::max(), free.empty() || ring.closed());
+		for (index_t i = 0; i < done.size(); ++i, ++collected)
+		{
+			auto expected = batch[collected];
+			REQUIRE( done.status[i] == expected.try_invert() );
+			REQUIRE( done.first[i] == expected );
+		}
+		ring.release(done.size());
+	}
+	REQUIRE( produced == batch.size() );
+	REQUIRE( ring.results().empty() );
+	REQUIRE_FALSE( ring.push(batch[0]) );
+
+	int status = 0;
+	REQUIRE( ::waitpid(inverter, &status, 0) == inverter );
+	REQUIRE( WIFEXITED(status) );
+	REQUIRE( WEXITSTATUS(status) == 0 );
+	matrix_ring<3, 3>::remove(name);
+}
+
+TEST_CASE( "Inversion service.", "[service]" )
+{
+	const std::string path = "unit_test_service_" + std::to_string(::getpid()) + ".sock";
+	service_options options;
+	options.window = std::chrono::milliseconds(2);
+	options.max_batch = 64;
+	options.thread_count = 2;
+	options.parallel_block = 16;
+	options.max_request = 1000;
+	matrix_server<3> server(path, options);
+	std::thread serving([&server] { server.run(); });
+
+	auto batch = dominant_batch<3>(200, 23, 5);
+
+	// Several clients at once, each in requests of a few matrices, so that requests are coalesced.
+	constexpr unsigned client_count = 4;
+	std::vector<std::vector<square_matrix<3>>> inverses(client_count, std::vector<square_matrix<3>>(batch.size()));
+	std::vector<std::vector<std::uint8_t>> statuses(client_count, std::vector<std::uint8_t>(batch.size()));
+	std::vector<index_t> inverted(client_count);
+	std::vector<std::thread> clients;
+	for (unsigned c = 0; c < client_count; ++c)
+		clients.emplace_back([&, c]
+		{
+			matrix_client<3> client(path);
+			for (index_t first = 0; first < batch.size(); first += 1 + c)
+			{
+				const index_t count = std::min<index_t>(1 + c, batch.size() - first);
+				inverted[c] += client.invert(&batch[first], count, &inverses[c][first], &statuses[c][first]);
+			}
+		});
+	for (auto& client : clients)
+		client.join();
+	index_t expected_inverted = 0;
+	for (index_t i = 0; i < batch.size(); ++i)
+	{
+		auto expected = batch[i];
+		const bool invertible = expected.try_invert();
+		expected_inverted += invertible;
+		for (unsigned c = 0; c < client_count; ++c)
+		{
+			REQUIRE( statuses[c][i] == invertible );
+			REQUIRE( inverses[c][i] == expected );
+		}
+	}
+	for (unsigned c = 0; c < client_count; ++c)
+		REQUIRE( inverted[c] == expected_inverted );
+	auto statistics = server.statistics();
+	REQUIRE( statistics.matrices == client_count * batch.size() );
+	REQUIRE( statistics.batches < statistics.requests );
+
+	// Linear systems, solved in place.
+	matrix_client<3> client(path);
+	std::vector<matrix<3, 1>> rhs(batch.size());
+	for (index_t i = 0; i < batch.size(); ++i)
+		for (index_t r = 0; r < 3; ++r)
+			rhs[i][r][0] = double(i % 7) - double(r);
+	auto solutions = rhs;
+	std::vector<std::uint8_t> solved(batch.size());
+	REQUIRE( client.solve(batch.data(), rhs.data(), batch.size(), solutions.data(), solved.data()) == expected_inverted );
+	for (index_t i = 0; i < batch.size(); ++i)
+	{
+		auto inverse = batch[i];
+		REQUIRE( solved[i] == inverse.try_invert() );
+		if (solved[i])
+			REQUIRE( (batch[i] * solutions[i]) == rhs[i] );
+	}
+
+	// Matrices of another size are refused, without disturbing the connection; so is a request
+	// too large, which closes it.
+	std::vector<square_matrix<4>> other(3);
+	matrix_client<4> mismatched(path);
+	for (int attempt = 0; attempt < 2; ++attempt)
+		CHECK_THROWS_AS( mismatched.invert(other.data(), other.size(), other.data()), const service_error& );
+	std::vector<square_matrix<3>> large(options.max_request + 1, batch[0]);
+	CHECK_THROWS_AS( client.invert(large.data(), large.size(), large.data()), const service_error& );
+	matrix_client<3> fresh(path);
+	REQUIRE( fresh.invert(batch.data(), 1, inverses[0].data()) == 1 );
+	REQUIRE( server.statistics().matrices == (client_count + 1) * batch.size() + 1 );
+
+	// Requests sent together that overfill a batch are split between batches, and all answered.
+	{
+		constexpr unsigned request_count = 3;
+		constexpr index_t count = 40;
+		detail::file_descriptor raw{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+		const sockaddr_un address = detail::socket_address(path);
+		REQUIRE( ::connect(raw.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0 );
+		std::vector<service_request_header> headers(request_count);
+		std::vector<iovec> parts;
+		for (unsigned r = 0; r < request_count; ++r)
+		{
+			std::copy_n(service_request_header::expected_magic, 4, headers[r].magic);
+			headers[r].element_size = sizeof(double);
+			headers[r].operation = service_operation::invert;
+			headers[r].size = 3;
+			headers[r].count = count;
+			headers[r].id = r;
+			parts.push_back({&headers[r], sizeof(headers[r])});
+			parts.push_back({&batch[r * count], count * sizeof(batch[0])});
+		}
+		const auto before = server.statistics();
+		detail::send_fully(raw.get(), parts.data(), int(parts.size()));
+		for (unsigned r = 0; r < request_count; ++r)
+		{
+			service_reply_header reply;
+			detail::receive_fully(raw.get(), &reply, sizeof(reply));
+			REQUIRE( reply.status == service_status::ok );
+			REQUIRE( reply.id == r );
+			REQUIRE( reply.count == count );
+			std::vector<std::uint8_t> status(detail::padded_status_size(count));
+			std::vector<square_matrix<3>> results(count);
+			detail::receive_fully(raw.get(), status.data(), status.size());
+			detail::receive_fully(raw.get(), results.data(), count * sizeof(results[0]));
+			for (index_t i = 0; i < count; ++i)
+			{
+				auto expected = batch[r * count + i];
+				REQUIRE( status[i] == expected.try_invert() );
+				REQUIRE( results[i] == expected );
+			}
+		}
+		const auto after = server.statistics();
+		REQUIRE( after.matrices - before.matrices == request_count * count );
+		REQUIRE( after.batches - before.batches >= 2 );
+	}
+
+	server.stop();
+	serving.join();
+}
+
+TEST_CASE( "Compression.", "[codec]" )
+{
+	shuffle_codec codec;
+	std::vector<char> coded, decoded;
+	std::uint32_t state = 12345;
+	const auto next = [&state] { return state = state * 1664525u + 1013904223u; };
+
+	// Every element size, with and without leftover bytes, for random and repetitive data.
+	for (const std::size_t element_size : {1, 3, 4, 8})
+		for (const std::size_t bytes : {0, 1, 7, 64, 1000, 70001})
+			for (const bool repetitive : {false, true})
+			{
+				std::vector<char> data(bytes);
+				for (std::size_t i = 0; i < bytes; ++i)
+					data[i] = repetitive ? char(i % element_size == 0 ? i / 64 % 3 : 0) : char(next() >> 24);
+				codec.encode(data.data(), bytes, element_size, coded);
+				REQUIRE( coded.size() <= shuffle_codec::bound(bytes, element_size) );
+				if (repetitive && bytes >= 1000)
+					REQUIRE( coded.size() < bytes / 2 );
+				decoded.assign(bytes, 1);
+				codec.decode(coded.data(), coded.size(), element_size, decoded.data(), bytes);
+				REQUIRE( decoded == data );
+			}
+
+	// Damage is detected rather than read past.
+	std::vector<char> zeros(4096);
+	codec.encode(zeros.data(), zeros.size(), 8, coded);
+	CHECK_THROWS_AS( codec.decode(coded.data(), coded.size() - 1, 8, decoded.data(), zeros.size()), const codec_error& );
+	coded[0] = char(0x0f);
+	CHECK_THROWS_AS( codec.decode(coded.data(), coded.size(), 8, decoded.data(), zeros.size()), const codec_error& );
+
+	// Coded batch files, transformed from and to either encoding.
+	const auto patterns = dominant_batch<4>(17);
+	std::vector<square_matrix<4>> batch;
+	for (unsigned i = 0; i < 3000; ++i)
+		batch.push_back(patterns[i % 17]);
+	const char* raw = "unit_test_codec_raw.bin";
+	const char* coded_file = "unit_test_codec_coded.bin";
+	const char* output = "unit_test_codec_out.bin";
+	write_batch_file(raw, batch.data(), batch.size());
+	write_batch_file(coded_file, batch.data(), batch.size(), batch_encoding::shuffled_lz);
+	REQUIRE( read_batch_file_header(coded_file).encoding == batch_encoding::shuffled_lz );
+	REQUIRE( (read_batch_file<4, 4, double>(coded_file) == batch) );
+	struct stat raw_status, coded_status;
+	REQUIRE( ::stat(raw, &raw_status) == 0 );
+	REQUIRE( ::stat(coded_file, &coded_status) == 0 );
+	REQUIRE( coded_status.st_size * 10 < raw_status.st_size );
+
+	for (const char* input : {raw, coded_file})
+		for (const auto encoding : {batch_encoding::raw, batch_encoding::shuffled_lz})
+		{
+			batch_io_options options;
+			options.chunk_size = 1000;
+			options.encoding = encoding;
+			REQUIRE( invert_batch_file<4>(input, output, nullptr, options) == batch.size() );
+			REQUIRE( read_batch_file_header(output).encoding == encoding );
+			const auto inverses = read_batch_file<4, 4, double>(output);
+			REQUIRE( inverses.size() == batch.size() );
+			REQUIRE( inverses[2999] == batch[2999].get_inverse() );
+		}
+
+	std::remove(raw);
+	std::remove(coded_file);
+	std::remove(output);
+}
+
+TEST_CASE( "NumPy files.", "[npy]" )
+{
+	const char* npy = "unit_test_array.npy";
+	const char* npz = "unit_test_arrays.npz";
+	std::vector<matrix<2, 3>> batch;
+	for (unsigned i = 0; i < 5; ++i)
+		batch.push_back(patterned_matrix<2, 3>(i));
+
+	// Matrices and batches read back in place.
+	write_npy(npy, batch[1]);
+	{
+		const auto array = load_npy(npy);
+		REQUIRE( array.dtype() == "<f8" );
+		REQUIRE( (array.shape() == std::vector<index_t>{2, 3}) );
+		REQUIRE( (array.is_matrix<2, 3, double>()) );
+		REQUIRE_FALSE( (array.is_matrix<3, 2, double>()) );
+		REQUIRE_FALSE( (array.is_matrix<2, 3, float>()) );
+		REQUIRE( reinterpret_cast<std::uintptr_t>(array.data()) % npy_alignment == 0 );
+		REQUIRE( (array.view<2, 3>().get_matrix() == batch[1]) );
+		REQUIRE( (array.get_matrix<2, 3, float>()[1][2] == float(batch[1][1][2])) );
+		CHECK_THROWS_AS( (array.view<2, 3, float>()), const npy_format_error& );
+		CHECK_THROWS_AS( (array.get_batch<2, 3>()), const npy_format_error& );
+	}
+	write_npy(npy, batch.data(), batch.size());
+	{
+		const auto array = load_npy(npy);
+		REQUIRE( (array.is_batch<2, 3, double>()) );
+		const auto view = array.batch_view<2, 3>();
+		REQUIRE( view.size() == 5 );
+		REQUIRE( view[4].get_matrix() == batch[4] );
+		REQUIRE( (array.get_batch<2, 3>() == batch) );
+	}
+
+	// A big-endian integer array in Fortran order, as numpy.save() would write it, is converted.
+	{
+		std::string dict = "{'descr': '>i4', 'fortran_order': True, 'shape': (2, 3), }";
+		dict.append(128 - 10 - dict.size() - 1, ' ');
+		dict.push_back('\n');
+		std::string file = std::string("\x93NUMPY\x01\x00", 8) + char(dict.size()) + '\0' + dict;
+		for (const int element : {1, 4, 2, 5, 3, 6})
+			file += std::string{'\0', '\0', '\0', char(element)};
+		std::ofstream(npy, std::ios::binary) << file;
+		const auto array = load_npy(npy);
+		REQUIRE( array.fortran_order() );
+		REQUIRE_FALSE( (array.is_matrix<2, 3, std::int32_t>()) );
+		REQUIRE( (array.get_matrix<2, 3>() == matrix<2, 3>{ {1, 2, 3}, {4, 5, 6} }) );
+	}
+	std::ofstream(npy, std::ios::binary) << "not an array";
+	CHECK_THROWS_AS( load_npy(npy), const npy_format_error& );
+
+	// A shape whose element count wraps around to nothing is refused, not taken as empty.
+	{
+		std::string dict = "{'descr': '<f8', 'fortran_order': False, 'shape': (4611686018427387904, 4), }";
+		dict.append(128 - 10 - dict.size() - 1, ' ');
+		dict.push_back('\n');
+		std::ofstream(npy, std::ios::binary) << std::string("\x93NUMPY\x01\x00", 8) + char(dict.size()) + '\0' + dict;
+		CHECK_THROWS_AS( load_npy(npy), const npy_format_error& );
+	}
+
+	// Archives.
+	{
+		npz_writer writer(npz);
+		writer.add("first", batch[0]);
+		writer.add("batch", batch.data(), batch.size());
+		writer.add("single", matrix<1, 3, float>{ {1, 2, 3} });
+	}
+	{
+		const npz_archive archive(npz);
+		REQUIRE( archive.size() == 3 );
+		REQUIRE( archive.contains("batch") );
+		REQUIRE( (archive["first"].view<2, 3>().get_matrix() == batch[0]) );
+		REQUIRE( (archive["batch"].batch_view<2, 3>()[2].get_matrix() == batch[2]) );
+		REQUIRE( (archive["single"].view<1, 3, float>()[0][2] == 3.0f) );
+		for (const auto& name : archive.names())
+			REQUIRE( reinterpret_cast<std::uintptr_t>(archive[name].data()) % npy_alignment == 0 );
+		CHECK_THROWS_AS( archive["missing"], const npy_format_error& );
+	}
+
+	// Members that are not arrays are skipped.
+	{
+		npz_writer writer(npz);
+		writer.add("first", batch[0]);
+		writer.add("notes", batch[1]);
+	}
+	{
+		std::ifstream in(npz, std::ios::binary);
+		std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		for (auto found = file.find("notes.npy"); found != std::string::npos; found = file.find("notes.npy", found))
+			file.replace(found, 9, "notes.txt");
+		std::ofstream(npz, std::ios::binary) << file;
+		const npz_archive archive(npz);
+		REQUIRE( archive.size() == 1 );
+		REQUIRE( archive.contains("first") );
+		REQUIRE_FALSE( archive.contains("notes") );
+	}
+
+	// An extra field that runs past the extra area of its directory entry is refused.
+	{
+		npz_writer writer(npz);
+		writer.add("first", batch[0]);
+	}
+	{
+		std::ifstream in(npz, std::ios::binary);
+		std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		const auto entry = file.find(std::string("PK\x01\x02", 4));
+		REQUIRE( entry != std::string::npos );
+		file[entry + 30] = 4;
+		file[entry + 31] = 0;
+		std::ofstream(npz, std::ios::binary) << file;
+		CHECK_THROWS_AS( npz_archive(npz), const npy_format_error& );
+	}
+
+	std::remove(npy);
+	std::remove(npz);
+}
+
+TEST_CASE( "Matrix series.", "[series]" )
+{
+	// A matrix that changes in an element or two each step, and entirely at step 120.
+	std::vector<square_matrix<6>> steps;
+	auto mtx = patterned_matrix<6, 6>(0);
+	for (unsigned step = 0; step < 300; ++step)
+	{
+		mtx[step % 6][step * 7 % 6] += 0.125 * step;
+		if (step % 3 == 0)
+			mtx[5][step % 6] = -1.0 / (step + 1);
+		if (step == 120)
+			for (index_t r = 0; r < 6; ++r)
+				for (index_t c = 0; c < 6; ++c)
+					mtx[r][c] = 1.0 / (r * 6 + c + 3);
+		steps.push_back(mtx);
+	}
+	const char* path = "unit_test_series.bin";
+	{
+		series_writer<6, 6> writer(path, 50);
+		for (const auto& step : steps)
+			writer.append(step);
+		REQUIRE( writer.size() == 300 );
+	}
+
+	struct stat status;
+	REQUIRE( ::stat(path, &status) == 0 );
+	REQUIRE( std::size_t(status.st_size) * 4 < steps.size() * sizeof(steps[0]) );
+	{
+		const series_reader<6, 6> reader(path);
+		REQUIRE( reader.size() == 300 );
+		// Keyframes every 50 steps, and one where everything changed.
+		REQUIRE( reader.keyframe_count() == 7 );
+		for (const index_t step : {0, 1, 49, 50, 119, 120, 121, 170, 299})
+			REQUIRE( reader.get(step) == steps[step] );
+		index_t visited = 0;
+		reader.for_each(95, 130, [&](const index_t step, const square_matrix<6>& decoded)
+		{
+			REQUIRE( decoded == steps[step] );
+			++visited;
+		});
+		REQUIRE( visited == 35 );
+		CHECK_THROWS_AS( reader.get(300), const std::out_of_range& );
+		CHECK_THROWS_AS( (series_reader<6, 6, float>(path)), const series_file_error& );
+	}
+
+	// A file cut short, as if the writer had not finished, is read up to its last whole step.
+	const series_reader<6, 6> whole(path);
+	REQUIRE( ::truncate(path, status.st_size - 7 * 16 - 32 - 3) == 0 );
+	{
+		const series_reader<6, 6> reader(path);
+		REQUIRE( reader.size() == 299 );
+		REQUIRE( reader.keyframe_count() == 7 );
+		REQUIRE( reader.get(298) == steps[298] );
+	}
+
+	// Other element types.
+	{
+		series_writer<2, 2, float> writer(path);
+		writer.append(matrix<2, 2, float>{ {1, 2}, {3, 4} });
+		writer.append(matrix<2, 2, float>{ {1, -2}, {3, 4.5f} });
+	}
+	REQUIRE( (series_reader<2, 2, float>(path).get(1) == matrix<2, 2, float>{ {1, -2}, {3, 4.5f} }) );
+
+	// A trailer whose index lies past the end of the file is ignored, and the steps scanned; an
+	// index out of order is refused.
+	const auto rewrite = [path](const auto& edit)
+	{
+		std::ifstream in(path, std::ios::binary);
+		std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		in.close();
+		edit(file);
+		std::ofstream(path, std::ios::binary) << file;
+	};
+	{
+		series_writer<2, 2, float> writer(path);
+		writer.append(matrix<2, 2, float>{ {1, 2}, {3, 4} });
+	}
+	rewrite([](std::string& file)
+	{
+		const series_file_trailer trailer{1, std::uint64_t(1) << 40, 1, {'M', 'T', 'X', 'I', 'N', 'D', 'E', 'X'}};
+		std::memcpy(&file[file.size() - sizeof(trailer)], &trailer, sizeof(trailer));
+	});
+	{
+		const series_reader<2, 2, float> reader(path);
+		REQUIRE( reader.size() == 1 );
+		REQUIRE( (reader.get(0) == matrix<2, 2, float>{ {1, 2}, {3, 4} }) );
+	}
+	{
+		series_writer<2, 2, float> writer(path, 1);
+		for (int step = 0; step < 3; ++step)
+			writer.append(matrix<2, 2, float>{ {float(step), 2}, {3, 4} });
+	}
+	REQUIRE( (series_reader<2, 2, float>(path).keyframe_count() == 3) );
+	rewrite([](std::string& file)
+	{
+		series_file_trailer trailer;
+		std::memcpy(&trailer, &file[file.size() - sizeof(trailer)], sizeof(trailer));
+		std::swap_ranges(&file[trailer.index_offset + sizeof(series_index_entry)],
+			&file[trailer.index_offset + 2 * sizeof(series_index_entry)], &file[trailer.index_offset + 2 * sizeof(series_index_entry)]);
+	});
+	CHECK_THROWS_AS( (series_reader<2, 2, float>(path)), const series_file_error& );
+
+	std::remove(path);
+}
+
+// Inverts a batch of matrices, one of them singular and each followed by some padding, through
+// the C interface, and checks the result against get_inverse().
+template <index_t Size>
+void check_capi_inversion()
+{
+	constexpr std::size_t count = 5;
+	constexpr std::size_t stride = Size * Size + 3;
+	std::vector<double> in(count * stride, -1), out(count * stride, -1);
+	std::vector<square_matrix<Size>> batch;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		auto mtx = add_to_diagonal(patterned_matrix<Size, Size>(i), 10.0 * Size);
+		if (i == 2)
+			mtx[1] = mtx[0];
+		// A permutation, which has zeros on the diagonal and needs an interchange at every step.
+		if (i == 3)
+		{
+			mtx = square_matrix<Size>{};
+			for (index_t r = 0; r < Size; ++r)
+				mtx[r][Size - 1 - r] = 1;
+		}
+		batch.push_back(mtx);
+		for (index_t r = 0; r < Size; ++r)
+			std::copy(mtx[r].begin(), mtx[r].end(), &in[i * stride + r * Size]);
+	}
+
+	unsigned char status[count];
+	REQUIRE( mm_invert_batch_f64(Size, count, in.data(), stride, out.data(), status) == count - 1 );
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const auto result = const_matrix_view<Size, Size>(&out[i * stride]).get_matrix();
+		REQUIRE( status[i] == (i != 2) );
+		REQUIRE( result == (i == 2 ? batch[i] : batch[i].get_inverse()) );
+		if (i == 3)
+			REQUIRE( result == batch[i].get_transpose() );
+		REQUIRE( out[i * stride + Size * Size] == -1 );
+	}
+	REQUIRE( mm_invert_batch_f64(Size, count, in.data(), stride, in.data(), nullptr) == count - 1 );
+	REQUIRE( in == out );
+}
+
+TEST_CASE( "C interface.", "[capi]" )
+{
+	REQUIRE( mm_abi_version() == MM_ABI_VERSION );
+
+	SECTION( "Inversion." )
+	{
+		// Compiled and run time kernels.
+		check_capi_inversion<3>();
+		check_capi_inversion<8>();
+		check_capi_inversion<10>();
+		check_capi_inversion<64>();
+
+		// Singular only if elimination with partial pivoting finds no pivot, whatever the size.
+		const double cycle[] = {0, 1, 0, 0, 1, 1, 1, 0, 1};
+		const double cycle_inverse[] = {1, -1, 1, 1, 0, 0, -1, 1, 0};
+		double out[9];
+		unsigned char status;
+		REQUIRE( mm_invert_batch_f64(3, 1, cycle, 9, out, &status) == 1 );
+		REQUIRE( status == 1 );
+		REQUIRE( (const_matrix_view<3, 3>(out).get_matrix() == const_matrix_view<3, 3>(cycle_inverse).get_matrix()) );
+	}
+	SECTION( "Solution." )
+	{
+		const auto compiled = add_to_diagonal(patterned_matrix<4, 4>(1), 40);
+		const auto run_time = add_to_diagonal(patterned_matrix<9, 9>(2), 90);
+		std::vector<double> b(3 * 8), x(b.size());
+		for (std::size_t i = 0; i < b.size(); ++i)
+			b[i] = double(i % 5) - 2;
+		x = b;
+		unsigned char status[3];
+		// One A for every B.
+		REQUIRE( mm_solve_batch_f64(4, 2, 3, compiled[0].data(), 0, x.data(), 8, status) == 3 );
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			const auto rhs = const_matrix_view<4, 2>(&b[i * 8]).get_matrix();
+			const auto solution = const_matrix_view<4, 2>(&x[i * 8]).get_matrix();
+			REQUIRE( status[i] == 1 );
+			REQUIRE( compiled * solution == rhs );
+		}
+
+		matrix<9, 3> rhs = patterned_matrix<9, 3>(4), solution = rhs;
+		REQUIRE( mm_solve_batch_f64(9, 3, 1, run_time[0].data(), 81, solution[0].data(), 27, nullptr) == 1 );
+		REQUIRE( run_time * solution == rhs );
+
+		const square_matrix<4> singular{ {1, 2, 3, 4}, {2, 4, 6, 8}, {0, 1, 0, 1}, {1, 0, 1, 0} };
+		solution = rhs;
+		REQUIRE( mm_solve_batch_f64(4, 3, 1, singular[0].data(), 16, solution[0].data(), 12, status) == 0 );
+		REQUIRE( status[0] == 0 );
+		REQUIRE( solution == rhs );
+	}
+	SECTION( "Multiplication." )
+	{
+		const std::array<square_matrix<4>, 2> lhs{ {patterned_matrix<4, 4>(1), patterned_matrix<4, 4>(2)} };
+		const auto rhs = patterned_matrix<4, 4>(3);
+		std::array<square_matrix<4>, 2> product;
+		REQUIRE( mm_multiply_batch_f64(4, 4, 4, 2, lhs[0][0].data(), 16, rhs[0].data(), 0, product[0][0].data(), 16) == 2 );
+		REQUIRE( product[0] == lhs[0] * rhs );
+		REQUIRE( product[1] == lhs[1] * rhs );
+
+		const auto tall = patterned_matrix<5, 3>(4);
+		const auto wide = patterned_matrix<3, 7>(5);
+		matrix<5, 7> general;
+		REQUIRE( mm_multiply_batch_f64(5, 3, 7, 1, tall[0].data(), 15, wide[0].data(), 21, general[0].data(), 35) == 1 );
+		REQUIRE( general == tall * wide );
+	}
+	SECTION( "Invalid arguments." )
+	{
+		double mtx[4] = {1, 0, 0, 1};
+		REQUIRE( mm_invert_batch_f64(2, 0, nullptr, 0, nullptr, nullptr) == 0 );
+		REQUIRE( mm_invert_batch_f64(2, 1, mtx, 3, mtx, nullptr) == MM_ERROR );
+		REQUIRE( mm_invert_batch_f64(0, 1, mtx, 4, mtx, nullptr) == MM_ERROR );
+		REQUIRE( mm_solve_batch_f64(2, 1, 1, mtx, 4, nullptr, 2, nullptr) == MM_ERROR );
+		REQUIRE( mm_multiply_batch_f64(2, 2, 2, 1, mtx, 4, mtx, 4, mtx, 0) == MM_ERROR );
+	}
+}